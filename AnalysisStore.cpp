@@ -0,0 +1,345 @@
+#include "AnalysisStore.h"
+#include <algorithm>
+#include <cstring>
+
+// version of the entry files
+static constexpr int entryVersion = 1;
+
+// bytes hashed at each place of a file
+static constexpr int sampleSize = 65536;
+
+// larger results get a file of their own
+static constexpr size_t maxSharedSize = 65536;
+
+AnalysisStore::AnalysisStore(const juce::File& _directory, juce::int64 _maxSize)
+    : directory(_directory),
+    maxSize(_maxSize)
+{
+}
+
+AnalysisStore::~AnalysisStore()
+{
+}
+
+juce::String AnalysisStore::hashFile(const juce::File& file)
+{
+    juce::FileInputStream in{ file };
+    if (in.failedToOpen())
+    {
+        return {};
+    }
+
+    juce::int64 size{ in.getTotalLength() };
+    juce::MemoryOutputStream content;
+    content.writeInt64(size);
+
+    juce::HeapBlock<char> buffer{ (size_t) sampleSize };
+    for (juce::int64 position : { (juce::int64) 0, size / 2 - sampleSize / 2, size - sampleSize })
+    {
+        if (!in.setPosition(juce::jmax((juce::int64) 0, position)))
+        {
+            return {};
+        }
+        int numRead{ in.read(buffer.get(), sampleSize) };
+        content.write(buffer.get(), (size_t) juce::jmax(0, numRead));
+    }
+
+    return juce::SHA256{ content.getData(), content.getDataSize() }.toHexString().substring(0, 16);
+}
+
+juce::String AnalysisStore::hashToString(juce::int64 hashCode)
+{
+    return juce::String::toHexString(hashCode).paddedLeft('0', 16);
+}
+
+juce::File AnalysisStore::getEntryFile(const juce::String& hash)
+{
+    return directory.getChildFile(hash.substring(0, 2)).getChildFile(hash + ".analysis");
+}
+
+juce::File AnalysisStore::getSeparateFile(const juce::String& hash, const juce::String& analyzer)
+{
+    return getEntryFile(hash).getSiblingFile(hash + "." + analyzer + ".blob");
+}
+
+bool AnalysisStore::get(const juce::String& hash, const juce::String& analyzer, int version, juce::MemoryBlock& data)
+{
+    juce::File separateFile;
+    {
+        const juce::ScopedLock scopedLock(lock);
+
+        std::vector<Record> records;
+        if (hash.isEmpty() || !readEntry(getEntryFile(hash), records))
+        {
+            return false;
+        }
+
+        auto record = std::find_if(records.begin(), records.end(), [&](const Record& item)
+        {
+            return item.analyzer == analyzer && item.version == version;
+        });
+        if (record == records.end())
+        {
+            return false;
+        }
+
+        // the modification time of an entry is its last use, so it survives a restart
+        juce::Time now{ juce::Time::getCurrentTime() };
+        getEntryFile(hash).setLastModificationTime(now);
+        auto entry = entries.find(hash);
+        if (entry != entries.end())
+        {
+            entry->second.lastUsed = now.toMilliseconds();
+        }
+
+        if (!record->separate)
+        {
+            data = std::move(record->data);
+            return true;
+        }
+        separateFile = getSeparateFile(hash, analyzer);
+    }
+
+    return readSeparate(separateFile, version, data);
+}
+
+bool AnalysisStore::put(const juce::String& hash, const juce::String& analyzer, int version, const juce::MemoryBlock& data)
+{
+    if (hash.isEmpty())
+    {
+        return false;
+    }
+
+    // a large result is written before taking the lock, only its record is written under it
+    bool separate{ data.getSize() > maxSharedSize };
+    juce::File separateFile{ getSeparateFile(hash, analyzer) };
+    if (separate && !writeSeparate(separateFile, version, data))
+    {
+        return false;
+    }
+
+    const juce::ScopedLock scopedLock(lock);
+
+    juce::File file{ getEntryFile(hash) };
+    std::vector<Record> records;
+    readEntry(file, records);
+
+    records.erase(std::remove_if(records.begin(), records.end(), [&analyzer](const Record& record)
+    {
+        return record.analyzer == analyzer;
+    }), records.end());
+    if (separate)
+    {
+        records.push_back({ analyzer, version, {}, true, separateFile.getSize() });
+    }
+    else
+    {
+        records.push_back({ analyzer, version, data });
+        separateFile.deleteFile();
+    }
+
+    if (!writeEntry(file, records))
+    {
+        return false;
+    }
+
+    // an entry counts with its large results
+    juce::int64 size{ file.getSize() };
+    for (const Record& record : records)
+    {
+        size += record.separateSize;
+    }
+
+    listEntries();
+    Entry& entry{ entries[hash] };
+    totalSize += size - entry.size;
+    entry.size = size;
+    entry.lastUsed = juce::Time::currentTimeMillis();
+
+    if (totalSize > maxSize)
+    {
+        evict(hash);
+    }
+    return true;
+}
+
+void AnalysisStore::listEntries()
+{
+    if (entriesListed)
+    {
+        return;
+    }
+    entriesListed = true;
+
+    // large results are named after their hash too and count with its entry
+    for (const juce::DirectoryEntry& item : juce::RangedDirectoryIterator{ directory, true, "*.analysis;*.blob", juce::File::findFiles })
+    {
+        juce::String hash{ item.getFile().getFileName().upToFirstOccurrenceOf(".", false, false) };
+        Entry& entry{ entries[hash] };
+        entry.size += item.getFileSize();
+        entry.lastUsed = juce::jmax(entry.lastUsed, item.getModificationTime().toMilliseconds());
+        totalSize += item.getFileSize();
+    }
+}
+
+void AnalysisStore::evict(const juce::String& keep)
+{
+    std::vector<std::pair<juce::int64, juce::String>> byLastUse;
+    byLastUse.reserve(entries.size());
+    for (const auto& item : entries)
+    {
+        byLastUse.push_back({ item.second.lastUsed, item.first });
+    }
+    std::sort(byLastUse.begin(), byLastUse.end());
+
+    // going a tenth below the cap keeps every write from evicting
+    juce::int64 target{ maxSize - maxSize / 10 };
+    int evicted{ 0 };
+    for (const auto& item : byLastUse)
+    {
+        if (totalSize <= target)
+        {
+            break;
+        }
+        if (item.second == keep)
+        {
+            continue;
+        }
+
+        juce::File entryFile{ getEntryFile(item.second) };
+        entryFile.deleteFile();
+        for (const juce::File& separateFile : entryFile.getParentDirectory().findChildFiles(juce::File::findFiles, false, item.second + ".*.blob"))
+        {
+            separateFile.deleteFile();
+        }
+        totalSize -= entries[item.second].size;
+        entries.erase(item.second);
+        ++evicted;
+    }
+
+    DBG("AnalysisStore: evicted " << evicted << " entries, " << totalSize / (1024 * 1024) << " MiB left");
+}
+
+bool AnalysisStore::readEntry(const juce::File& file, std::vector<Record>& records)
+{
+    juce::FileInputStream in{ file };
+    if (in.failedToOpen())
+    {
+        return false;
+    }
+
+    char magic[4] = {};
+    if (in.read(magic, 4) != 4 || std::memcmp(magic, "OTAN", 4) != 0 || in.readInt() != entryVersion)
+    {
+        std::cerr << "AnalysisStore: ignoring " << file.getFullPathName() << ", unknown format" << std::endl;
+        return false;
+    }
+
+    int count{ in.readInt() };
+    for (int i = 0; i < count && !in.isExhausted(); ++i)
+    {
+        Record record;
+        record.analyzer = in.readString();
+        record.version = in.readInt();
+        record.separate = in.readBool();
+        if (record.separate)
+        {
+            record.separateSize = in.readInt64();
+            records.push_back(std::move(record));
+            continue;
+        }
+
+        int size{ in.readInt() };
+        if (size < 0 || size > in.getNumBytesRemaining())
+        {
+            std::cerr << "AnalysisStore: " << file.getFullPathName() << " is truncated" << std::endl;
+            return false;
+        }
+        record.data.setSize((size_t) size);
+        in.read(record.data.getData(), size);
+        records.push_back(std::move(record));
+    }
+    return true;
+}
+
+bool AnalysisStore::writeEntry(const juce::File& file, const std::vector<Record>& records)
+{
+    if (!file.getParentDirectory().createDirectory())
+    {
+        std::cerr << "AnalysisStore: can't create " << file.getParentDirectory().getFullPathName() << std::endl;
+        return false;
+    }
+
+    juce::TemporaryFile temp{ file };
+    {
+        juce::FileOutputStream out{ temp.getFile() };
+        if (out.failedToOpen())
+        {
+            std::cerr << "AnalysisStore: can't write " << file.getFullPathName() << std::endl;
+            return false;
+        }
+
+        out.write("OTAN", 4);
+        out.writeInt(entryVersion);
+        out.writeInt((int) records.size());
+        for (const Record& record : records)
+        {
+            out.writeString(record.analyzer);
+            out.writeInt(record.version);
+            out.writeBool(record.separate);
+            if (record.separate)
+            {
+                out.writeInt64(record.separateSize);
+                continue;
+            }
+            out.writeInt((int) record.data.getSize());
+            out.write(record.data.getData(), record.data.getSize());
+        }
+    }
+
+    return temp.overwriteTargetFileWithTemporary();
+}
+
+bool AnalysisStore::readSeparate(const juce::File& file, int version, juce::MemoryBlock& data)
+{
+    juce::FileInputStream in{ file };
+    if (in.failedToOpen())
+    {
+        return false;
+    }
+
+    // the record was read before, a newer version may have replaced the file since
+    char magic[4] = {};
+    if (in.read(magic, 4) != 4 || std::memcmp(magic, "OTAB", 4) != 0 || in.readInt() != version)
+    {
+        return false;
+    }
+
+    data.setSize((size_t) in.getNumBytesRemaining());
+    return in.read(data.getData(), (int) data.getSize()) == (int) data.getSize();
+}
+
+bool AnalysisStore::writeSeparate(const juce::File& file, int version, const juce::MemoryBlock& data)
+{
+    if (!file.getParentDirectory().createDirectory())
+    {
+        std::cerr << "AnalysisStore: can't create " << file.getParentDirectory().getFullPathName() << std::endl;
+        return false;
+    }
+
+    juce::TemporaryFile temp{ file };
+    {
+        juce::FileOutputStream out{ temp.getFile() };
+        if (out.failedToOpen())
+        {
+            std::cerr << "AnalysisStore: can't write " << file.getFullPathName() << std::endl;
+            return false;
+        }
+
+        out.write("OTAB", 4);
+        out.writeInt(version);
+        out.write(data.getData(), data.getSize());
+    }
+
+    return temp.overwriteTargetFileWithTemporary();
+}
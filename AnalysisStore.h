@@ -0,0 +1,111 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <map>
+#include <vector>
+
+// AnalysisStore keeps what the analyzers found out about audio files, on disk in the data
+// folder, keyed by a hash of the file content. A file that is moved, renamed or imported
+// twice keeps its results, a file whose audio changed gets a new hash and is analysed again.
+// Every analyzer stores its result under its name and version, a new version of an analyzer
+// misses the old results while the results of the other analyzers are still found.
+// The small results of one file are kept together in one small file, large ones like waveform
+// pyramids in a file of their own per analyzer, read and written outside the lock so they
+// never hold up the small ones. Safe to use from any thread.
+// The store is a cache held under a size cap, the files used least recently are dropped when
+// it is exceeded. Their results are found again by analysing the file again.
+class AnalysisStore
+{
+public:
+
+    AnalysisStore(const juce::File& directory, juce::int64 maxSize);
+
+    ~AnalysisStore();
+
+    // purpose : hash the content of a file, from its size and 64 KiB from its start, middle
+    //           and end, so it costs a few reads however long the file is
+    // input : file
+    // output : hash as 16 hex digits, empty if the file can't be read
+    static juce::String hashFile(const juce::File& file);
+
+    // purpose : convert a 64 bit hash code of the JUCE caches to a hash
+    // input : hash code
+    // output : hash
+    static juce::String hashToString(juce::int64 hashCode);
+
+    // purpose : get the result of an analyzer
+    // input : hash of the file, name and version of the analyzer, block to fill
+    // output : true if found
+    bool get(const juce::String& hash, const juce::String& analyzer, int version, juce::MemoryBlock& data);
+
+    // purpose : store the result of an analyzer, replacing any other version of it
+    // input : hash of the file, name and version of the analyzer, result
+    // output : true if written
+    bool put(const juce::String& hash, const juce::String& analyzer, int version, const juce::MemoryBlock& data);
+
+private:
+
+    struct Record
+    {
+        juce::String analyzer;
+        int version{ 0 };
+        juce::MemoryBlock data;
+
+        // kept in a file of its own, of this size
+        bool separate{ false };
+        juce::int64 separateSize{ 0 };
+    };
+
+    struct Entry
+    {
+        juce::int64 size{ 0 };
+        juce::int64 lastUsed{ 0 };
+    };
+
+    juce::File directory;
+    juce::int64 maxSize;
+    juce::CriticalSection lock;
+
+    // size and last use of every entry file by hash, read from the folder on the first write
+    std::map<juce::String, Entry> entries;
+    juce::int64 totalSize{ 0 };
+    bool entriesListed{ false };
+
+    // purpose : list the entry files with their size and last use
+    // input : none
+    // output : void
+    void listEntries();
+
+    // purpose : drop the entries used least recently until the store is well below its cap
+    // input : hash of the entry to keep
+    // output : void
+    void evict(const juce::String& keep);
+
+    // purpose : get the file holding the results of a hash
+    // input : hash
+    // output : file, in a folder named by the first two digits of the hash
+    juce::File getEntryFile(const juce::String& hash);
+
+    // purpose : get the file holding a large result of a hash
+    // input : hash, name of the analyzer
+    // output : file, next to the file of the small results
+    juce::File getSeparateFile(const juce::String& hash, const juce::String& analyzer);
+
+    // purpose : read or write a large result
+    // input : file, version of the analyzer, result
+    // output : false if missing, of another version or unwritable
+    static bool readSeparate(const juce::File& file, int version, juce::MemoryBlock& data);
+    static bool writeSeparate(const juce::File& file, int version, const juce::MemoryBlock& data);
+
+    // purpose : read the results of a hash
+    // input : file, records to fill
+    // output : false if missing or unreadable
+    static bool readEntry(const juce::File& file, std::vector<Record>& records);
+
+    // purpose : write the results of a hash
+    // input : file, records
+    // output : true if written
+    static bool writeEntry(const juce::File& file, const std::vector<Record>& records);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AnalysisStore)
+};
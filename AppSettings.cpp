@@ -0,0 +1,41 @@
+#include "AppSettings.h"
+
+// set up the properties file in the platform's usual settings folder
+AppSettings::AppSettings()
+{
+    properties = std::make_unique<juce::PropertiesFile>(getOptions());
+}
+
+AppSettings::AppSettings(const juce::File& settingsFile)
+{
+    properties = std::make_unique<juce::PropertiesFile>(settingsFile, getOptions());
+}
+
+// write any pending change back to disk
+AppSettings::~AppSettings()
+{
+    properties->saveIfNeeded();
+}
+
+juce::PropertiesFile& AppSettings::getProperties()
+{
+    return *properties;
+}
+
+juce::PropertiesFile::Options AppSettings::getOptions()
+{
+    juce::PropertiesFile::Options options;
+    options.applicationName = "OtoDecks";
+    options.filenameSuffix = ".settings";
+    options.folderName = "OtoDecks";
+    options.osxLibrarySubFolder = "Application Support";
+    options.storageFormat = juce::PropertiesFile::storeAsXML;
+    return options;
+}
+
+juce::File AppSettings::getDataDirectory()
+{
+    juce::File dir{ properties->getFile().getParentDirectory() };
+    dir.createDirectory();
+    return dir;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// AppSettings keeps the user editable options of OtoDecks in a properties file
+// (~/.config/OtoDecks/OtoDecks.settings on Linux)
+class AppSettings
+{
+public:
+
+    AppSettings();
+
+    // settings kept in another file, so benchmarks never touch the user's settings
+    explicit AppSettings(const juce::File& settingsFile);
+
+    ~AppSettings();
+
+    // purpose : get the properties file holding every setting
+    // input : none
+    // output : properties file
+    juce::PropertiesFile& getProperties();
+
+    // purpose : get the folder where OtoDecks keeps its library and caches
+    // input : none
+    // output : data folder, created if missing
+    juce::File getDataDirectory();
+
+private:
+    std::unique_ptr<juce::PropertiesFile> properties;
+
+    // purpose : get the options of the settings file
+    // input : none
+    // output : options
+    static juce::PropertiesFile::Options getOptions();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AppSettings)
+};
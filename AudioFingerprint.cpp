@@ -0,0 +1,99 @@
+#include "AudioFingerprint.h"
+#include <algorithm>
+#include <cmath>
+
+std::vector<juce::uint32> AudioFingerprint::compute(juce::AudioFormatReader& reader, double startSeconds, double lengthSeconds)
+{
+    std::vector<juce::uint32> fingerprint;
+
+    if (reader.sampleRate <= 0.0 || reader.lengthInSamples <= 0 || reader.numChannels == 0)
+    {
+        return fingerprint;
+    }
+
+    juce::int64 start{ juce::jlimit((juce::int64) 0, reader.lengthInSamples, (juce::int64) (startSeconds * reader.sampleRate)) };
+    int numSamples{ (int) juce::jmin(reader.lengthInSamples - start, (juce::int64) (lengthSeconds * reader.sampleRate)) };
+
+    double ratio{ reader.sampleRate / sampleRate };
+    int numResampled{ (int) ((numSamples - 4) / ratio) };
+    if (numResampled < frameSize + hopSize)
+    {
+        return fingerprint;
+    }
+
+    // down to mono
+    juce::AudioBuffer<float> source{ (int) reader.numChannels, numSamples };
+    reader.read(&source, 0, numSamples, start, true, true);
+    for (int channel = 1; channel < source.getNumChannels(); ++channel)
+    {
+        source.addFrom(0, 0, source, channel, 0, numSamples);
+    }
+    source.applyGain(0, 0, numSamples, 1.0f / (float) source.getNumChannels());
+
+    // two low pass passes keep what is above the new Nyquist frequency out of the bands
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        juce::IIRFilter lowPass;
+        lowPass.setCoefficients(juce::IIRCoefficients::makeLowPass(reader.sampleRate, 2500.0));
+        lowPass.processSamples(source.getWritePointer(0), numSamples);
+    }
+
+    std::vector<float> mono((size_t) numResampled);
+    juce::LagrangeInterpolator interpolator;
+    interpolator.process(ratio, source.getReadPointer(0), mono.data(), numResampled);
+
+    // log spaced band edges, as fft bins
+    int bandEdges[numBands + 1];
+    for (int band = 0; band <= numBands; ++band)
+    {
+        double frequency{ 300.0 * std::pow(2000.0 / 300.0, (double) band / numBands) };
+        bandEdges[band] = (int) std::round(frequency * frameSize / sampleRate);
+    }
+
+    juce::dsp::FFT fft{ 11 };
+    juce::dsp::WindowingFunction<float> window{ (size_t) frameSize, juce::dsp::WindowingFunction<float>::hann, false };
+    std::vector<float> fftData((size_t) frameSize * 2);
+
+    float energies[numBands];
+    float previousEnergies[numBands];
+    bool first{ true };
+
+    fingerprint.reserve((size_t) ((numResampled - frameSize) / hopSize));
+
+    for (int position = 0; position + frameSize <= numResampled; position += hopSize)
+    {
+        std::copy(mono.begin() + position, mono.begin() + position + frameSize, fftData.begin());
+        std::fill(fftData.begin() + frameSize, fftData.end(), 0.0f);
+        window.multiplyWithWindowingTable(fftData.data(), (size_t) frameSize);
+        fft.performFrequencyOnlyForwardTransform(fftData.data());
+
+        for (int band = 0; band < numBands; ++band)
+        {
+            float energy{ 0.0f };
+            for (int bin = bandEdges[band]; bin < bandEdges[band + 1]; ++bin)
+            {
+                energy += fftData[(size_t) bin] * fftData[(size_t) bin];
+            }
+            energies[band] = energy;
+        }
+
+        if (!first)
+        {
+            juce::uint32 bits{ 0 };
+            for (int band = 0; band < numBands - 1; ++band)
+            {
+                float difference{ (energies[band] - energies[band + 1]) - (previousEnergies[band] - previousEnergies[band + 1]) };
+                if (difference > 0.0f)
+                {
+                    bits |= (juce::uint32) 1 << band;
+                }
+            }
+            fingerprint.push_back(bits);
+        }
+
+        std::copy(energies, energies + numBands, previousEnergies);
+        first = false;
+    }
+
+    return fingerprint;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+// AudioFingerprint computes a Haitsma-Kalker style fingerprint. The audio is brought down
+// to mono at 5512.5 Hz and cut into overlapping frames, the spectrum of every frame is split
+// into 33 bands between 300 and 2000 Hz and each frame gives a 32 bit sub-fingerprint, one
+// bit per pair of neighbouring bands, set when their energy difference grew since the
+// previous frame. Encoding, level and format changes flip only a few of those bits, so two
+// files of the same recording stay within a small bit error rate of each other.
+class AudioFingerprint
+{
+public:
+
+    static constexpr double sampleRate = 5512.5;
+    static constexpr int frameSize = 2048;
+    static constexpr int hopSize = 64;
+    static constexpr int numBands = 33;
+
+    // purpose : fingerprint a section of a file
+    // input : reader of the file, start and length of the section in seconds
+    // output : one sub-fingerprint per frame, empty if the section is too short
+    static std::vector<juce::uint32> compute(juce::AudioFormatReader& reader, double startSeconds, double lengthSeconds);
+};
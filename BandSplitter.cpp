@@ -0,0 +1,31 @@
+#include "BandSplitter.h"
+
+BandSplitter::BandSplitter()
+{
+}
+
+BandSplitter::~BandSplitter()
+{
+}
+
+void BandSplitter::prepare(double sampleRate, int maxBlockSize)
+{
+    juce::dsp::ProcessSpec spec{ sampleRate, (juce::uint32) juce::jmax(1, maxBlockSize), 1 };
+
+    // the high crossover can't go past the nyquist frequency of low rate files
+    lowSplit.setCutoffFrequency(juce::jmin(lowCrossover, (float) sampleRate * 0.4f));
+    highSplit.setCutoffFrequency(juce::jmin(highCrossover, (float) sampleRate * 0.4f));
+    lowSplit.prepare(spec);
+    highSplit.prepare(spec);
+}
+
+void BandSplitter::process(const float* input, float* low, float* mid, float* high, int numSamples)
+{
+    // the first crossover takes the lows off, the second splits the rest into mids and highs
+    for (int i = 0; i < numSamples; ++i)
+    {
+        float rest;
+        lowSplit.processSample(0, input[i], low[i], rest);
+        highSplit.processSample(0, rest, mid[i], high[i]);
+    }
+}
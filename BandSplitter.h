@@ -0,0 +1,37 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// BandSplitter splits a mono signal into the low, mid and high bands of the colored
+// waveforms, with two fourth order Linkwitz-Riley crossovers so the bands add up to the
+// whole signal again (up to phase).
+// Lows are kicks and bass below 200 Hz, highs are hats and cymbals above 2 kHz.
+class BandSplitter
+{
+public:
+
+    // crossover frequencies, in Hz
+    static constexpr float lowCrossover = 200.0f;
+    static constexpr float highCrossover = 2000.0f;
+
+    BandSplitter();
+
+    ~BandSplitter();
+
+    // purpose : set up the crossovers and clear their state
+    // input : sample rate, largest block
+    // output : void
+    void prepare(double sampleRate, int maxBlockSize);
+
+    // purpose : split the next samples of the signal, in order
+    // input : mono samples, buffers for the three bands, number of samples
+    // output : void
+    void process(const float* input, float* low, float* mid, float* high, int numSamples);
+
+private:
+
+    juce::dsp::LinkwitzRileyFilter<float> lowSplit;
+    juce::dsp::LinkwitzRileyFilter<float> highSplit;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BandSplitter)
+};
@@ -0,0 +1,342 @@
+#include "BeatAnalyzer.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+// onset frames per second
+static constexpr double framesPerSecond = 100.0;
+
+// tempo range searched, and the tempo the search leans toward
+static constexpr double minBpm = 60.0;
+static constexpr double maxBpm = 200.0;
+static constexpr double preferredBpm = 120.0;
+
+// how hard the beat tracker holds on to the tempo
+static constexpr double tightness = 100.0;
+
+// a grid marker is kept within this of every tracked beat it covers
+static constexpr double gridTolerance = 0.025;
+
+// fewest beats in a stretch of steady tempo
+static constexpr int minBeatsPerMarker = 16;
+
+BeatAnalyzer::BeatAnalyzer(double _sampleRate)
+    : sampleRate(_sampleRate),
+    hopSize(juce::jmax(1, (int) std::round(_sampleRate / framesPerSecond))),
+    fftOrder(juce::jlimit(8, 14, (int) std::ceil(std::log2(juce::jmax(256, (int) std::round(_sampleRate / framesPerSecond)) * 2.0)))),
+    fftSize(1 << fftOrder),
+    fft(fftOrder),
+    window((size_t) fftSize, juce::dsp::WindowingFunction<float>::hann, false)
+{
+    fftData.resize((size_t) fftSize * 2);
+    previousSpectrum.resize((size_t) fftSize / 2 + 1);
+    flux.resize((size_t) fftSize / 2 + 1);
+    pending.reserve((size_t) fftSize * 4);
+}
+
+BeatAnalyzer::~BeatAnalyzer()
+{
+}
+
+void BeatAnalyzer::process(const float* samples, int numSamples)
+{
+    pending.insert(pending.end(), samples, samples + numSamples);
+
+    size_t position{ 0 };
+    while (position + (size_t) fftSize <= pending.size())
+    {
+        processFrame(pending.data() + position);
+        position += (size_t) hopSize;
+    }
+    pending.erase(pending.begin(), pending.begin() + (std::ptrdiff_t) position);
+    analysed = false;
+}
+
+double BeatAnalyzer::getBpm()
+{
+    analyse();
+    return bpm;
+}
+
+std::vector<BeatMarker> BeatAnalyzer::getBeatGrid()
+{
+    analyse();
+    return beatGrid;
+}
+
+void BeatAnalyzer::processFrame(const float* frame)
+{
+    int numBins{ fftSize / 2 + 1 };
+
+    juce::FloatVectorOperations::copy(fftData.data(), frame, fftSize);
+    juce::FloatVectorOperations::clear(fftData.data() + fftSize, fftSize);
+    window.multiplyWithWindowingTable(fftData.data(), (size_t) fftSize);
+    fft.performFrequencyOnlyForwardTransform(fftData.data());
+
+    // log compression keeps quiet onsets from being drowned by loud ones
+    float* spectrum{ fftData.data() };
+    juce::FloatVectorOperations::multiply(spectrum, 100.0f, numBins);
+    for (int bin = 0; bin < numBins; ++bin)
+    {
+        spectrum[bin] = std::log1p(spectrum[bin]);
+    }
+
+    // only rising energy counts
+    juce::FloatVectorOperations::subtract(flux.data(), spectrum, previousSpectrum.data(), numBins);
+    juce::FloatVectorOperations::max(flux.data(), flux.data(), 0.0f, numBins);
+    juce::FloatVectorOperations::copy(previousSpectrum.data(), spectrum, numBins);
+
+    onsets.push_back(onsets.empty() ? 0.0f : std::accumulate(flux.begin(), flux.end(), 0.0f));
+}
+
+double BeatAnalyzer::frameToSeconds(double frame)
+{
+    // an onset frame compares a window with the one before it, so it sits at the window centre
+    return (frame * hopSize + fftSize * 0.5) / sampleRate;
+}
+
+void BeatAnalyzer::analyse()
+{
+    if (analysed)
+    {
+        return;
+    }
+    analysed = true;
+    bpm = 0.0;
+    beatGrid.clear();
+
+    double fps{ sampleRate / hopSize };
+    int numFrames{ (int) onsets.size() };
+    if (numFrames < (int) (fps * 10.0))
+    {
+        return;
+    }
+
+    // remove the local mean and keep the peaks, then normalise
+    std::vector<float> envelope((size_t) numFrames);
+    {
+        int halfWindow{ (int) (fps * 0.25) };
+        std::vector<double> sums((size_t) numFrames + 1, 0.0);
+        for (int i = 0; i < numFrames; ++i)
+        {
+            sums[(size_t) i + 1] = sums[(size_t) i] + onsets[(size_t) i];
+        }
+        for (int i = 0; i < numFrames; ++i)
+        {
+            int from{ juce::jmax(0, i - halfWindow) };
+            int to{ juce::jmin(numFrames, i + halfWindow + 1) };
+            double mean{ (sums[(size_t) to] - sums[(size_t) from]) / (to - from) };
+            envelope[(size_t) i] = (float) juce::jmax(0.0, onsets[(size_t) i] - mean);
+        }
+
+        double sumOfSquares{ 0.0 };
+        for (float value : envelope)
+        {
+            sumOfSquares += value * value;
+        }
+        double deviation{ std::sqrt(sumOfSquares / numFrames) };
+        if (deviation <= 0.0)
+        {
+            return;
+        }
+        juce::FloatVectorOperations::multiply(envelope.data(), (float) (1.0 / deviation), numFrames);
+    }
+
+    // tempo: the autocorrelation peak, weighted toward the preferred tempo on a log scale
+    int minLag{ (int) std::floor(fps * 60.0 / maxBpm) };
+    int maxLag{ juce::jmin(numFrames / 4, (int) std::ceil(fps * 60.0 / minBpm)) };
+    if (maxLag <= minLag + 2)
+    {
+        return;
+    }
+
+    std::vector<double> correlation((size_t) maxLag + 2, 0.0);
+    for (int lag = minLag - 1; lag <= maxLag + 1; ++lag)
+    {
+        double sum{ 0.0 };
+        for (int i = lag; i < numFrames; ++i)
+        {
+            sum += envelope[(size_t) i] * envelope[(size_t) (i - lag)];
+        }
+        correlation[(size_t) lag] = sum / (numFrames - lag);
+    }
+
+    double preferredLag{ fps * 60.0 / preferredBpm };
+    int bestLag{ 0 };
+    double bestScore{ 0.0 };
+    for (int lag = minLag; lag <= maxLag; ++lag)
+    {
+        double octaves{ std::log2(lag / preferredLag) };
+        double score{ correlation[(size_t) lag] * std::exp(-0.5 * octaves * octaves) };
+        if (score > bestScore)
+        {
+            bestScore = score;
+            bestLag = lag;
+        }
+    }
+    if (bestLag == 0)
+    {
+        return;
+    }
+
+    // parabolic interpolation between lags
+    double left{ correlation[(size_t) bestLag - 1] };
+    double centre{ correlation[(size_t) bestLag] };
+    double right{ correlation[(size_t) bestLag + 1] };
+    double denominator{ left - 2.0 * centre + right };
+    double period{ bestLag + (denominator < 0.0 ? 0.5 * (left - right) / denominator : 0.0) };
+
+    // beats: each frame scores its onset plus the best earlier beat about a period back
+    std::vector<double> score((size_t) numFrames);
+    std::vector<int> previousBeat((size_t) numFrames, -1);
+    for (int i = 0; i < numFrames; ++i)
+    {
+        double best{ 0.0 };
+        int from{ i - (int) std::round(2.0 * period) };
+        int to{ i - (int) std::round(0.5 * period) };
+        for (int candidate = juce::jmax(0, from); candidate <= to; ++candidate)
+        {
+            double stretch{ std::log((i - candidate) / period) };
+            double value{ score[(size_t) candidate] - tightness * stretch * stretch };
+            if (value > best || previousBeat[(size_t) i] < 0)
+            {
+                best = value;
+                previousBeat[(size_t) i] = candidate;
+            }
+        }
+        score[(size_t) i] = envelope[(size_t) i] + best;
+    }
+
+    int last{ numFrames - 1 };
+    for (int i = juce::jmax(0, numFrames - (int) std::ceil(period)); i < numFrames; ++i)
+    {
+        if (score[(size_t) i] > score[(size_t) last])
+        {
+            last = i;
+        }
+    }
+
+    std::vector<int> beats;
+    for (int beat = last; beat >= 0; beat = previousBeat[(size_t) beat])
+    {
+        beats.push_back(beat);
+    }
+    std::reverse(beats.begin(), beats.end());
+    if ((int) beats.size() < minBeatsPerMarker)
+    {
+        return;
+    }
+
+    // the downbeat is the bar phase with the strongest onsets
+    int downbeatPhase{ 0 };
+    double strongest{ -1.0 };
+    for (int phase = 0; phase < 4; ++phase)
+    {
+        double sum{ 0.0 };
+        int count{ 0 };
+        for (size_t beat = (size_t) phase; beat < beats.size(); beat += 4)
+        {
+            sum += envelope[(size_t) beats[beat]];
+            ++count;
+        }
+        if (count > 0 && sum / count > strongest)
+        {
+            strongest = sum / count;
+            downbeatPhase = phase;
+        }
+    }
+
+    std::vector<double> times;
+    for (size_t beat = (size_t) downbeatPhase; beat < beats.size(); ++beat)
+    {
+        times.push_back(frameToSeconds(beats[beat]));
+    }
+
+    // grid: grow a least squares line over the beats until a beat strays from it, then start
+    // a new marker there
+    auto fit = [&times](size_t first, size_t end, double& start, double& secondsPerBeat)
+    {
+        double n{ (double) (end - first) };
+        double sumX{ 0.0 }, sumY{ 0.0 }, sumXX{ 0.0 }, sumXY{ 0.0 };
+        for (size_t i = first; i < end; ++i)
+        {
+            double x{ (double) (i - first) };
+            sumX += x;
+            sumY += times[i];
+            sumXX += x * x;
+            sumXY += x * times[i];
+        }
+        secondsPerBeat = (n * sumXY - sumX * sumY) / (n * sumXX - sumX * sumX);
+        start = (sumY - secondsPerBeat * sumX) / n;
+    };
+
+    auto fits = [&times](size_t first, size_t end, double start, double secondsPerBeat)
+    {
+        for (size_t i = first; i < end; ++i)
+        {
+            if (std::abs(start + secondsPerBeat * (double) (i - first) - times[i]) > gridTolerance)
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // first beat of the last marker
+    size_t markerFirst{ 0 };
+
+    size_t first{ 0 };
+    while (first + (size_t) minBeatsPerMarker <= times.size())
+    {
+        size_t end{ first + (size_t) minBeatsPerMarker };
+        double start{ 0.0 };
+        double secondsPerBeat{ 0.0 };
+        fit(first, end, start, secondsPerBeat);
+
+        while (end < times.size())
+        {
+            double nextStart{ 0.0 };
+            double nextSecondsPerBeat{ 0.0 };
+            fit(first, end + 1, nextStart, nextSecondsPerBeat);
+            if (!fits(first, end + 1, nextStart, nextSecondsPerBeat))
+            {
+                break;
+            }
+            start = nextStart;
+            secondsPerBeat = nextSecondsPerBeat;
+            ++end;
+        }
+
+        if (secondsPerBeat > 0.0)
+        {
+            // the stretch only goes on the last marker when that marker's grid lands on every
+            // one of its beats, a slipped or skipped beat or a small drift in tempo gets its
+            // own marker
+            bool merged{ !beatGrid.empty()
+                && fits(markerFirst, end, beatGrid.back().time, 60.0 / beatGrid.back().bpm) };
+            if (!merged)
+            {
+                beatGrid.push_back({ start, 60.0 / secondsPerBeat });
+                markerFirst = first;
+            }
+        }
+
+        // the last beat of a stretch starts the next one
+        first = end - 1;
+        if (end == times.size())
+        {
+            break;
+        }
+    }
+
+    if (beatGrid.empty())
+    {
+        return;
+    }
+
+    // the tempo of the track is the average over all of its beats
+    double start{ 0.0 };
+    double secondsPerBeat{ 0.0 };
+    fit(0, times.size(), start, secondsPerBeat);
+    bpm = secondsPerBeat > 0.0 ? std::round(6000.0 / secondsPerBeat) / 100.0 : beatGrid.front().bpm;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include "Song.h"
+
+// BeatAnalyzer finds the tempo and beatgrid of a track from its mono samples, fed block by
+// block while the track is decoded.
+// An onset strength is taken every 10 ms as the spectral flux of log compressed magnitude
+// spectra, the tempo is the strongest autocorrelation lag of the onset curve weighted toward
+// 120 BPM, and the beats are tracked over the whole curve by dynamic programming so they
+// may drift from a strict grid. The beats are then cut into stretches of steady tempo, each
+// giving one grid marker, and the bar phase with the strongest onsets gives the first downbeat.
+class BeatAnalyzer
+{
+public:
+
+    BeatAnalyzer(double sampleRate);
+
+    ~BeatAnalyzer();
+
+    // purpose : add the next samples of the track
+    // input : mono samples
+    // output : void
+    void process(const float* samples, int numSamples);
+
+    // purpose : get the tempo of everything processed
+    // input : none
+    // output : bpm, 0 if the track is too short or has no clear beat
+    double getBpm();
+
+    // purpose : get the beatgrid of everything processed
+    // input : none
+    // output : grid markers, empty if there is no clear beat
+    std::vector<BeatMarker> getBeatGrid();
+
+private:
+
+    double sampleRate;
+    int hopSize;
+    int fftOrder;
+    int fftSize;
+
+    juce::dsp::FFT fft;
+    juce::dsp::WindowingFunction<float> window;
+
+    std::vector<float> pending;
+    std::vector<float> fftData;
+    std::vector<float> previousSpectrum;
+    std::vector<float> flux;
+
+    // one onset strength per hop
+    std::vector<float> onsets;
+
+    bool analysed{ false };
+    double bpm{ 0.0 };
+    std::vector<BeatMarker> beatGrid;
+
+    // purpose : add the onset strength of one frame
+    // input : first sample of the frame
+    // output : void
+    void processFrame(const float* frame);
+
+    // purpose : find tempo and grid once all samples are in
+    // input : none
+    // output : void
+    void analyse();
+
+    // purpose : get the time of an onset frame
+    // input : frame
+    // output : seconds
+    double frameToSeconds(double frame);
+};
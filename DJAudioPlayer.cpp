@@ -1,33 +1,132 @@
 #include "DJAudioPlayer.h"
 
-DJAudioPlayer::DJAudioPlayer(AudioFormatManager& _formatManager) 
-: formatManager(_formatManager)
+DJAudioPlayer::DJAudioPlayer(AudioFormatManager& _formatManager, TimeSliceThread& _readAheadThread) 
+: formatManager(_formatManager),
+  readAheadThread(_readAheadThread)
 {
     // set the initial paramters to default values
-    reverbParameters.roomSize = 0;
-    reverbParameters.damping = 0;
-    reverbParameters.wetLevel = 0;
-    reverbParameters.dryLevel = 1.0;
-    reverbSource.setParameters(reverbParameters);
+    reverbSource.setParameters(getReverbParameters());
 }
 
 DJAudioPlayer::~DJAudioPlayer()
 {
-
+    // detach the buffering source from the read ahead thread
+    transportSource.setSource(nullptr);
 }
 
 void DJAudioPlayer::prepareToPlay (int samplesPerBlockExpected, double sampleRate) 
 {
+    deviceSampleRate = sampleRate;
+    updateResamplingRatio();
+
     transportSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
     resampleSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
     reverbSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
+    filterController.prepareToPlay(sampleRate, samplesPerBlockExpected);
+    modulation.prepare(sampleRate);
+    modulatedGain = 1.0f;
 }
 void DJAudioPlayer::getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill)
 {
+    // a nudge seeks from the audio thread, through the same short range lock of the read ahead
+    // buffer that every block takes
+    double nudgeSeconds{ pendingNudge.exchange(0.0) };
+    double rate{ fileSampleRate };
+    if (nudgeSeconds != 0.0 && rate > 0)
+    {
+        int64 position{ transportSource.getNextReadPosition() + (int64) (nudgeSeconds * rate) };
+        transportSource.setNextReadPosition(jlimit((int64) 0, transportSource.getTotalLength(), position));
+    }
+
+    // the playhead as the block starts, the GUI moves it on from here
+    PlayheadTelemetry::Snapshot snapshot;
+    snapshot.position = transportSource.getNextReadPosition();
+    snapshot.length = transportSource.getTotalLength();
+    snapshot.samplesPerMs = playing ? fileSamplesPerMs.load() : 0.0;
+    snapshot.time = Time::getMillisecondCounterHiRes();
+    if (speedModulated)
+    {
+        snapshot.samplesPerMs *= std::exp2(modulation.getOffset(ModulationEngine::Target::speed));
+    }
+    telemetry.publish(snapshot);
+
+    // the reverb set from the GUI or a controller is taken up here, a modulated one every block
+    if (reverbChanged.exchange(false) && !reverbModulated)
+    {
+        reverbSource.setParameters(getReverbParameters());
+    }
+
+    if (modulation.isActive() || speedModulated || reverbModulated || modulatedGain != 1.0f)
+    {
+        renderModulated(bufferToFill);
+        return;
+    }
+
     reverbSource.getNextAudioBlock(bufferToFill);
     filterController.processAudioBlock(*bufferToFill.buffer);
 
 }
+
+void DJAudioPlayer::renderModulated(const AudioSourceChannelInfo& bufferToFill)
+{
+    using Target = ModulationEngine::Target;
+
+    // speed and reverb change once per block from the latest period, the resampler and reverb
+    // smooth the change over the block themselves
+    speedModulated = modulation.isModulated(Target::speed);
+    double speed{ speedModulated ? std::exp2(modulation.getOffset(Target::speed)) : 1.0 };
+    resampleSource.setResamplingRatio(resamplingRatio * speed);
+
+    bool reverbWasModulated{ reverbModulated };
+    reverbModulated = modulation.isModulated(Target::roomSize) || modulation.isModulated(Target::damping)
+                   || modulation.isModulated(Target::wetLevel) || modulation.isModulated(Target::dryLevel);
+    if (reverbModulated || reverbWasModulated)
+    {
+        Reverb::Parameters parameters{ getReverbParameters() };
+        parameters.roomSize = jlimit(0.0f, 1.0f, parameters.roomSize + modulation.getOffset(Target::roomSize));
+        parameters.damping = jlimit(0.0f, 1.0f, parameters.damping + modulation.getOffset(Target::damping));
+        parameters.wetLevel = jlimit(0.0f, 1.0f, parameters.wetLevel + modulation.getOffset(Target::wetLevel));
+        parameters.dryLevel = jlimit(0.0f, 1.0f, parameters.dryLevel + modulation.getOffset(Target::dryLevel));
+        reverbSource.setParameters(parameters);
+    }
+
+    reverbSource.getNextAudioBlock(bufferToFill);
+
+    // the position of the track moves on with the speed over the block
+    AudioBuffer<float>& buffer{ *bufferToFill.buffer };
+    double rate{ fileSampleRate };
+    double trackSeconds{ rate > 0 ? transportSource.getNextReadPosition() / rate : 0.0 };
+    double trackSecondsPerSample{ deviceSampleRate > 0 ? resamplingRatio * speed / deviceSampleRate : 0.0 };
+
+    // filters and gain follow every control period, the gain ramps between periods
+    double lowPass{ filterController.getLowPassFrequency() };
+    double highPass{ filterController.getHighPassFrequency() };
+    for (int offset = 0; offset < bufferToFill.numSamples; offset += ModulationEngine::controlInterval)
+    {
+        int start{ bufferToFill.startSample + offset };
+        int numSamples{ jmin(ModulationEngine::controlInterval, bufferToFill.numSamples - offset) };
+        modulation.advance(buffer, start, numSamples, trackSeconds + offset * trackSecondsPerSample);
+
+        filterController.processSection(buffer, start, numSamples,
+            lowPass * std::exp2(4.0 * modulation.getOffset(Target::lowPassCutoff)),
+            highPass * std::exp2(4.0 * modulation.getOffset(Target::highPassCutoff)));
+
+        float gain{ jlimit(0.0f, 1.0f, 1.0f + modulation.getOffset(Target::gain)) };
+        if (gain != modulatedGain || gain != 1.0f)
+        {
+            float step{ (gain - modulatedGain) / (float) numSamples };
+            for (int i = 0; i < numSamples; ++i)
+            {
+                gainRamp[(size_t) i] = modulatedGain + step * (float) (i + 1);
+            }
+            for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+            {
+                FloatVectorOperations::multiply(buffer.getWritePointer(channel, start), gainRamp.data(), numSamples);
+            }
+            modulatedGain = gain;
+        }
+    }
+}
 void DJAudioPlayer::releaseResources()
 {
     transportSource.releaseResources();
@@ -44,8 +143,21 @@ void DJAudioPlayer::loadURL(URL audioURL)
     {       
         std::unique_ptr<AudioFormatReaderSource> newSource (new AudioFormatReaderSource (reader, 
 true)); 
-        transportSource.setSource (newSource.get(), 0, nullptr, reader->sampleRate);             
+        // no rate to correct for, resampleSource converts the rate together with the speed
+        transportSource.setSource (newSource.get(), 32768, &readAheadThread, 0);             
         readerSource.reset (newSource.release());          
+
+        // the new track waits paused behind the play gate
+        playing = false;
+        pendingNudge = 0.0;
+        transportSource.start();
+        fileSampleRate = reader->sampleRate;
+        updateResamplingRatio();
+        loadedURL = audioURL;
+
+        // a new track starts uncorrected until its gain is set, and without a beatgrid
+        setTrackGain(0.0);
+        modulation.setBeatGrid({});
     }
 }
 
@@ -56,10 +168,17 @@ void DJAudioPlayer::setGain(double gain)
         std::cout << "DJAudioPlayer::setGain gain should be between 0 and 1" << std::endl;
     }
     else {
-        transportSource.setGain(gain);
+        volume = gain;
+        transportSource.setGain((float) (volume * trackGain));
     }
    
 }
+
+void DJAudioPlayer::setTrackGain(double gainInDecibels)
+{
+    trackGain = Decibels::decibelsToGain(gainInDecibels);
+    transportSource.setGain((float) (volume * trackGain));
+}
 void DJAudioPlayer::setSpeed(double ratio)
 {
   if (ratio < 0 || ratio > 100.0)
@@ -67,12 +186,31 @@ void DJAudioPlayer::setSpeed(double ratio)
         std::cout << "DJAudioPlayer::setSpeed ratio should be between 0 and 100" << std::endl;
     }
     else {
-        resampleSource.setResamplingRatio(ratio);
+        speedRatio = ratio;
+        updateResamplingRatio();
+    }
+}
+
+void DJAudioPlayer::updateResamplingRatio()
+{
+    // file samples consumed per output sample
+    double rateRatio{ 1.0 };
+    if (fileSampleRate > 0 && deviceSampleRate > 0)
+    {
+        rateRatio = fileSampleRate / deviceSampleRate;
     }
+    resamplingRatio = speedRatio * rateRatio;
+    resampleSource.setResamplingRatio(resamplingRatio);
+    fileSamplesPerMs = speedRatio * fileSampleRate / 1000.0;
 }
+
 void DJAudioPlayer::setPosition(double posInSecs)
 {
-    transportSource.setPosition(posInSecs);
+    // the transport runs at the file's rate, so positions are in file samples
+    if (fileSampleRate > 0)
+    {
+        transportSource.setNextReadPosition((int64) (posInSecs * fileSampleRate));
+    }
 }
 
 void DJAudioPlayer::setPositionRelative(double pos)
@@ -82,23 +220,58 @@ void DJAudioPlayer::setPositionRelative(double pos)
         std::cout << "DJAudioPlayer::setPositionRelative pos should be between 0 and 1" << std::endl;
     }
     else {
-        double posInSecs = transportSource.getLengthInSeconds() * pos;
+        double posInSecs = getLengthInSeconds() * pos;
         setPosition(posInSecs);
     }
 }
 
 void DJAudioPlayer::start()
 {
-    transportSource.start();
+    playing = true;
 }
 void DJAudioPlayer::stop()
 {
-  transportSource.stop();
+    playing = false;
+}
+
+void DJAudioPlayer::nudge(double seconds)
+{
+    double pending{ pendingNudge };
+    while (!pendingNudge.compare_exchange_weak(pending, pending + seconds))
+    {
+    }
 }
 
 double DJAudioPlayer::getPositionRelative()
 {
-    return transportSource.getCurrentPosition() / transportSource.getLengthInSeconds();
+    // the transport belongs to the audio thread, it is only asked while no device is running
+    double now{ Time::getMillisecondCounterHiRes() };
+    PlayheadTelemetry::Snapshot snapshot{ telemetry.read() };
+    if (PlayheadTelemetry::isLive(snapshot, now))
+    {
+        if (snapshot.length <= 0)
+        {
+            return 0;
+        }
+        return PlayheadTelemetry::getPositionAt(snapshot, now) / snapshot.length;
+    }
+
+    double length{ getLengthInSeconds() };
+    if (length <= 0)
+    {
+        return 0;
+    }
+    return transportSource.getNextReadPosition() / fileSampleRate / length;
+}
+
+bool DJAudioPlayer::isPlaying()
+{
+    return playing;
+}
+
+URL DJAudioPlayer::getLoadedURL()
+{
+    return loadedURL;
 }
 
 FilterController& DJAudioPlayer::getSoundController()
@@ -106,66 +279,144 @@ FilterController& DJAudioPlayer::getSoundController()
     return filterController;
 }
 
+void DJAudioPlayer::setCueEnabled(bool shouldCue)
+{
+    cueEnabled = shouldCue;
+}
+
+bool DJAudioPlayer::isCueEnabled()
+{
+    return cueEnabled;
+}
+
+ModulationEngine& DJAudioPlayer::getModulation()
+{
+    return modulation;
+}
+
+Reverb::Parameters DJAudioPlayer::getReverbParameters()
+{
+    Reverb::Parameters parameters;
+    parameters.roomSize = roomSize;
+    parameters.damping = damping;
+    parameters.wetLevel = wetLevel;
+    parameters.dryLevel = dryLevel;
+    return parameters;
+}
+
 
 // set the room size
 void DJAudioPlayer::setRoomSize(float size)
 {
-    std::cout << "DJAudioPlayer::setRoomSize triggered" << std::endl;
     if (size < 0 || size > 1.0)
     {
         std::cout << "DJAudioPlayer::setRoomSize size should be between 0 and 1.0" << std::endl;
     }
     else
     {
-        reverbParameters.roomSize = size;
-        reverbSource.setParameters(reverbParameters);
+        roomSize = size;
+        reverbChanged = true;
     }
 }
 
 // set the damping value
 void DJAudioPlayer::setDamping(float dampingAmt)
 {
-    std::cout << "DJAudioPlayer::setDamping called" << std::endl;
     if (dampingAmt < 0 || dampingAmt > 1.0)
     {
         std::cout << "DJAudioPlayer::setDamping amount should be between 0 and 1.0" << std::endl;
     }
     else
     {
-        reverbParameters.damping = dampingAmt;
-        reverbSource.setParameters(reverbParameters);
+        damping = dampingAmt;
+        reverbChanged = true;
     }
 }
 
 void DJAudioPlayer::setWetLevel(float wetLevel)
 {
-    std::cout << "DJAudioPlayer::setWetLevel called" << std::endl;
     if (wetLevel < 0 || wetLevel > 1.0)
     {
         std::cout << "DJAudioPlayer::setWetLevel level should be between 0 and 1.0" << std::endl;
     }
     else
     {
-        reverbParameters.wetLevel = wetLevel;
-        reverbSource.setParameters(reverbParameters);
+        this->wetLevel = wetLevel;
+        reverbChanged = true;
     }
 }
 
 void DJAudioPlayer::setDryLevel(float dryLevel)
 {
-    std::cout << "DJAudioPlayer::setDryLevel called" << std::endl;
     if (dryLevel < 0 || dryLevel > 1.0)
     {
         std::cout << "DJAudioPlayer::setDryLevel level should be between 0 and 1.0" << std::endl;
     }
     else
     {
-        reverbParameters.dryLevel = dryLevel;
-        reverbSource.setParameters(reverbParameters);
+        this->dryLevel = dryLevel;
+        reverbChanged = true;
     }
 }
 
 double DJAudioPlayer::getLengthInSeconds()
 {
-    return transportSource.getLengthInSeconds();
-}
\ No newline at end of file
+    if (fileSampleRate <= 0)
+    {
+        return 0;
+    }
+    return transportSource.getTotalLength() / fileSampleRate;
+}
+
+DJAudioPlayer::PlayGate::PlayGate(AudioTransportSource& _transport, std::atomic<bool>& _playing)
+    : transport(_transport),
+    playing(_playing)
+{
+}
+
+void DJAudioPlayer::PlayGate::prepareToPlay(int, double)
+{
+    open = false;
+}
+
+void DJAudioPlayer::PlayGate::getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill)
+{
+    // the transport isn't running before a track is loaded
+    bool shouldPlay{ playing && transport.isPlaying() };
+    if (!shouldPlay && !open)
+    {
+        bufferToFill.clearActiveBufferRegion();
+        return;
+    }
+
+    // the block asks for file samples, the last ones of the track are played and the deck
+    // stops without reading past the end
+    int numSamples{ bufferToFill.numSamples };
+    int64 remaining{ transport.getTotalLength() - transport.getNextReadPosition() };
+    bool ended{ remaining < numSamples };
+    if (ended)
+    {
+        numSamples = (int) jmax((int64) 0, remaining);
+        playing = false;
+    }
+
+    if (numSamples > 0)
+    {
+        transport.getNextAudioBlock(AudioSourceChannelInfo(bufferToFill.buffer, bufferToFill.startSample, numSamples));
+    }
+    if (numSamples < bufferToFill.numSamples)
+    {
+        bufferToFill.buffer->clear(bufferToFill.startSample + numSamples, bufferToFill.numSamples - numSamples);
+    }
+
+    // fade in as the deck starts and out over the block after it stops
+    if (shouldPlay != open && numSamples > 0)
+    {
+        bufferToFill.buffer->applyGainRamp(bufferToFill.startSample, numSamples, open ? 1.0f : 0.0f, open ? 0.0f : 1.0f);
+    }
+    open = shouldPlay && !ended;
+}
+
+void DJAudioPlayer::PlayGate::releaseResources()
+{
+}
@@ -2,12 +2,15 @@
 
 #include "../JuceLibraryCode/JuceHeader.h"
 #include"FilterController.h"
+#include "PlayheadTelemetry.h"
+#include "ModulationEngine.h"
 
 class DJAudioPlayer : public AudioSource {
   public:
 
     // constructor
-    DJAudioPlayer(AudioFormatManager& _formatManager);
+    // the read ahead thread decodes the file ahead of the audio callback
+    DJAudioPlayer(AudioFormatManager& _formatManager, TimeSliceThread& _readAheadThread);
 
     // deconstructor
     ~DJAudioPlayer();
@@ -26,6 +29,12 @@ class DJAudioPlayer : public AudioSource {
     // output : void
     void setGain(double gain);
 
+    // purpose : set the gain that evens out the loudness of the loaded track, on top of
+    //           the volume
+    // input : gain in decibels, 0 for none
+    // output : void
+    void setTrackGain(double gainInDecibels);
+
     // purpose : set the speed of the track
     // input : url of the track
     // output : void
@@ -68,42 +77,162 @@ class DJAudioPlayer : public AudioSource {
     // output : lenth of a song in seconds
     double getLengthInSeconds();
 
-    // purpose : start playing
+    // purpose : start playing, safe from the audio thread, the deck starts at its next block
     // input : none
     // output : void
     void start();
 
-    // purpose : pause playing
+    // purpose : pause playing, safe from the audio thread, the deck fades out over its next
+    //           block
     // input : none
     // output : void
     void stop();
 
-    // purpose : get the position of the song
+    // purpose : move the track on or back from where it plays, safe from the audio thread, the
+    //           deck moves at its next block
+    // input : seconds to move, negative to move back
+    // output : void
+    void nudge(double seconds);
+
+    // purpose : get the position of the song, from the audio thread's latest playhead moved on
+    //           to now
     // input : none
     // output : relative posion of the song
     double getPositionRelative();
 
+    // purpose : check if the deck is playing
+    // input : none
+    // output : true while playing
+    bool isPlaying();
+
+    // purpose : get the track loaded in the deck
+    // input : none
+    // output : url of the track, empty before the first load
+    URL getLoadedURL();
+
     // for adding the filter
     FilterController& getSoundController();
 
+    // purpose : send the deck to the cue (headphone) bus
+    // input : true to pre-listen the deck
+    // output : void
+    void setCueEnabled(bool shouldCue);
+
+    // purpose : check if the deck is sent to the cue bus, safe from the audio thread
+    // input : none
+    // output : true when cued
+    bool isCueEnabled();
+
+    // purpose : get the LFOs, envelope followers and step sequencers of the deck
+    // input : none
+    // output : modulation engine
+    ModulationEngine& getModulation();
+
 private:
 
     // resource for managing files
     AudioFormatManager& formatManager;
+    TimeSliceThread& readAheadThread;
     std::unique_ptr<AudioFormatReaderSource> readerSource;
+    URL loadedURL;
 
-    // for changing the song
+    // for changing the song, it is started on load and runs from then on, the play gate
+    // pauses it
     AudioTransportSource transportSource;
 
-    // resampling
-    ResamplingAudioSource resampleSource{&transportSource, false, 2};
+    // whether the deck plays, set from any thread
+    std::atomic<bool> playing{ false };
+
+    // seconds to move the track at the next block
+    std::atomic<double> pendingNudge{ 0.0 };
+
+    // passes the transport on while the deck plays and silence while it doesn't, so playing and
+    // pausing never go through the transport's start and stop, whose stop waits for the audio
+    // thread. It stops at the end of the track before the transport would stop itself.
+    class PlayGate : public AudioSource
+    {
+    public:
+        PlayGate(AudioTransportSource& transport, std::atomic<bool>& playing);
+
+        void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+        void getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill) override;
+        void releaseResources() override;
+
+    private:
+        AudioTransportSource& transport;
+        std::atomic<bool>& playing;
+
+        // whether the last block played, for fading in and out
+        bool open{ false };
+    };
+    PlayGate playGate{ transportSource, playing };
+
+    // resampling, a single stage doing both the file rate to device rate conversion
+    // and the speed change, the transport source itself never resamples
+    ResamplingAudioSource resampleSource{&playGate, false, 2};
+
+    // rates that make up the resampling ratio
+    std::atomic<double> fileSampleRate{ 0.0 };
+    double deviceSampleRate{ 0.0 };
+    double speedRatio{ 1.0 };
+
+    // resampling ratio at the speed set, the audio thread modulates from it
+    std::atomic<double> resamplingRatio{ 1.0 };
+
+    // file samples played per millisecond at the speed set, read by the audio thread
+    std::atomic<double> fileSamplesPerMs{ 0.0 };
+
+    // playhead published by the audio thread for the GUI
+    PlayheadTelemetry telemetry;
+
+    // volume of the deck and loudness correction of the track, applied together, the volume
+    // can also come from a controller on the audio thread
+    std::atomic<double> volume{ 1.0 };
+    std::atomic<double> trackGain{ 1.0 };
+
+    // purpose : set the combined ratio of the resampling stage
+    // input : none
+    // output : void
+    void updateResamplingRatio();
 
     // for adding the low pass and high pass filter functionality
     FilterController filterController;
     
     // for adding wetness,dryness,roomsize and damping functionality
     juce::ReverbAudioSource reverbSource{ &resampleSource, false };
-    juce::Reverb::Parameters reverbParameters;
+
+    // reverb parameters set from the GUI or a controller, the audio thread hands them to the
+    // reverb and modulates from them
+    std::atomic<float> roomSize{ 0.0f };
+    std::atomic<float> damping{ 0.0f };
+    std::atomic<float> wetLevel{ 0.0f };
+    std::atomic<float> dryLevel{ 1.0f };
+    std::atomic<bool> reverbChanged{ false };
+
+    // purpose : get the reverb parameters set
+    // input : none
+    // output : parameters
+    Reverb::Parameters getReverbParameters();
+
+    // moves parameters from the audio thread
+    ModulationEngine modulation;
+
+    // modulation state of the audio thread: gain at the end of the last period, and whether
+    // the speed and reverb were moved in the last block
+    float modulatedGain{ 1.0f };
+    bool speedModulated{ false };
+    bool reverbModulated{ false };
+
+    // ramp of the gain over a control period
+    std::array<float, ModulationEngine::controlInterval> gainRamp{};
+
+    // purpose : render a block with the modulation applied, from the audio thread
+    // input : block to fill
+    // output : void
+    void renderModulated(const AudioSourceChannelInfo& bufferToFill);
+
+    // pre-listen on the cue bus
+    std::atomic<bool> cueEnabled{ false };
 
 };
 
@@ -1,14 +1,83 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "DeckGUI.h"
 
+// purpose : set up the modulation of a deck from one of the presets of the MOD menu
+// input : modulation engine, preset id of the menu
+// output : void
+static void applyModulationPreset(ModulationEngine& modulation, int preset)
+{
+    using Settings = ModulationEngine::Settings;
+    using Target = ModulationEngine::Target;
+    using Type = ModulationEngine::Type;
+    using Shape = ModulationEngine::Shape;
+
+    modulation.clear();
+    Settings settings;
+    switch (preset)
+    {
+        case 2:
+            // low pass wobbling down from where it is once a beat
+            settings.type = Type::lfo;
+            settings.target = Target::lowPassCutoff;
+            settings.depth = 0.6f;
+            settings.rate = 1.0f;
+            break;
+        case 3:
+            // low pass sweeping over four bars
+            settings.type = Type::lfo;
+            settings.target = Target::lowPassCutoff;
+            settings.shape = Shape::triangle;
+            settings.depth = 0.75f;
+            settings.rate = 16.0f;
+            break;
+        case 4:
+            // sixteenth note gate
+            settings.type = Type::steps;
+            settings.target = Target::gain;
+            settings.depth = 1.0f;
+            settings.rate = 0.25f;
+            settings.steps = { 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, -1.0f };
+            settings.numSteps = 8;
+            break;
+        case 5:
+            // reverb coming in over two bars
+            settings.type = Type::lfo;
+            settings.target = Target::wetLevel;
+            settings.shape = Shape::triangle;
+            settings.depth = 0.4f;
+            settings.rate = 8.0f;
+            break;
+        case 6:
+            // loud parts push the high pass up
+            settings.type = Type::envelope;
+            settings.target = Target::highPassCutoff;
+            settings.depth = 0.75f;
+            settings.attack = 5.0f;
+            settings.release = 300.0f;
+            break;
+        case 7:
+            // warped record, free running
+            settings.type = Type::lfo;
+            settings.target = Target::speed;
+            settings.depth = 0.01f;
+            settings.sync = false;
+            settings.rate = 2.0f;
+            break;
+        default:
+            return;
+    }
+    modulation.setModulator(0, settings);
+}
+
 DeckGUI::DeckGUI(int _id,DJAudioPlayer* _player, 
                 AudioFormatManager & 	formatManagerToUse,
                 AudioThumbnailCache & 	cacheToUse,
+                WaveformLoader & loaderToUse,
                 FilterController& filterController
            ) : 
                 deck_id(_id),
                 player(_player), 
-                waveformDisplay(formatManagerToUse, cacheToUse),
+                waveformDisplay(formatManagerToUse, cacheToUse, loaderToUse),
                 filterController(filterController)
 {
     // load button
@@ -46,6 +115,15 @@ DeckGUI::DeckGUI(int _id,DJAudioPlayer* _player,
     addAndMakeVisible(forwardtButton);
     forwardtButton.addListener(this);
 
+    addAndMakeVisible(cueButton);
+    cueButton.addListener(this);
+    cueButton.setClickingTogglesState(true);
+    cueButton.setColour(TextButton::buttonOnColourId, Colours::orange);
+
+    addAndMakeVisible(modButton);
+    modButton.addListener(this);
+    modButton.setTooltip("Modulate the deck in time with the track");
+
     // rotary sliders config
     addAndMakeVisible(volSlider);
     volSlider.addListener(this);
@@ -112,14 +190,10 @@ DeckGUI::DeckGUI(int _id,DJAudioPlayer* _player,
     graphController2.addListener(this);
     graphController2.setTooltip("Set reverbe");
     graphController2.setLabelText("", "WetLevel v DryLevel");
-
-    // setting the timer
-    startTimer(500);
 }
 
 DeckGUI::~DeckGUI()
 {
-    stopTimer();
 }
 
 void DeckGUI::paint (Graphics& g)
@@ -142,8 +216,10 @@ void DeckGUI::resized()
     double colHButton = getWidth() / 5;
     double colHSliders = getWidth() / 4;
     
-    // load button
-    loadButton.setBounds(0, 0, getWidth(), rowH);
+    // load button, modulation and cue button
+    loadButton.setBounds(0, 0, 3 * colHButton, rowH);
+    modButton.setBounds(3 * colHButton, 0, colHButton, rowH);
+    cueButton.setBounds(4 * colHButton, 0, colHButton, rowH);
 
     // waveform
     waveformDisplay.setBounds(0, rowH, getWidth(), rowH * 1);
@@ -231,6 +307,38 @@ void DeckGUI::buttonClicked(Button* button)
             posSlider.setValue(0);
         }
     }
+    if (button == &cueButton)
+    {
+        std::cout << "Cue button was clicked " << std::endl;
+        player->setCueEnabled(cueButton.getToggleState());
+    }
+    if (button == &modButton)
+    {
+        PopupMenu menu;
+        menu.addItem(1, "Off");
+        menu.addSeparator();
+        menu.addItem(2, "Filter wobble, 1 beat");
+        menu.addItem(3, "Filter sweep, 16 beats");
+        menu.addItem(4, "Gate, 1/4 beat steps");
+        menu.addItem(5, "Reverb swell, 8 beats");
+        menu.addItem(6, "Envelope high pass");
+        menu.addItem(7, "Warped record");
+        menu.showMenuAsync(PopupMenu::Options().withTargetComponent(&modButton), [this](int result)
+        {
+            if (result != 0)
+            {
+                applyModulationPreset(player->getModulation(), result);
+                if (result == 1)
+                {
+                    modButton.removeColour(TextButton::buttonColourId);
+                }
+                else
+                {
+                    modButton.setColour(TextButton::buttonColourId, Colours::orange.darker());
+                }
+            }
+        });
+    }
     if (button == &loadButton)
     {
         auto fileChooserFlags = 
@@ -320,13 +428,18 @@ void DeckGUI::filesDropped (const StringArray &files, int x, int y)
     std::cout << "DeckGUI::filesDropped" << std::endl;
     if (files.size() == 1)
     {
-    player->loadURL(URL{File{files[0]}});
+    loadTrack(URL{File{files[0]}});
     }
 }
 
-void DeckGUI::timerCallback()
+void DeckGUI::setShowPaintTime(bool shouldShow)
 {
-    // wavefrom postion changing
+    waveformDisplay.setShowPaintTime(shouldShow);
+}
+
+void DeckGUI::updatePlayhead()
+{
+    // wavefrom postion changing, the waveform only repaints when the playhead moved a pixel
     waveformDisplay.setPositionRelative(
             player->getPositionRelative());
 }
@@ -339,6 +452,27 @@ void DeckGUI::loadTrack(juce::URL audioURL)
     waveformDisplay.loadURL(audioURL);
 }
 
+bool DeckGUI::isPlaying()
+{
+    return player->isPlaying();
+}
+
+juce::URL DeckGUI::getLoadedURL()
+{
+    return player->getLoadedURL();
+}
+
+void DeckGUI::setTrackGain(double gainInDecibels)
+{
+    player->setTrackGain(gainInDecibels);
+}
+
+void DeckGUI::setBeatGrid(std::vector<BeatMarker> grid)
+{
+    player->getModulation().setBeatGrid(grid);
+    waveformDisplay.setBeatGrid(std::move(grid));
+}
+
 
     
 
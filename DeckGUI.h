@@ -10,7 +10,6 @@ class DeckGUI    : public Component,
                    public Button::Listener, 
                    public Slider::Listener, 
                    public FileDragAndDropTarget, 
-                   public Timer,
     public GraphController::Listener
 {
 public:
@@ -18,6 +17,7 @@ public:
         DJAudioPlayer* player, 
         AudioFormatManager & 	formatManagerToUse,
         AudioThumbnailCache & 	cacheToUse ,
+        WaveformLoader & loaderToUse,
         FilterController& filterController);
 
     ~DeckGUI();
@@ -37,13 +37,36 @@ public:
     bool isInterestedInFileDrag (const StringArray &files) override;
     void filesDropped (const StringArray &files, int x, int y) override; 
 
-    void timerCallback() override; 
-
     // purpose : load a track to the deck
     // input : url of the track
     // output : void
     void loadTrack(juce::URL audioURL);
 
+    // purpose : check if the deck is playing
+    // input : none
+    // output : true while playing
+    bool isPlaying();
+
+    // purpose : get the track loaded in the deck, however it was loaded
+    // input : none
+    // output : url of the track, empty before the first load
+    juce::URL getLoadedURL();
+
+    // purpose : set the beatgrid drawn on the zoomed waveform
+    // input : grid markers of the loaded track
+    // output : void
+    void setBeatGrid(std::vector<BeatMarker> grid);
+
+    // purpose : set the loudness correction of the loaded track
+    // input : gain in decibels
+    // output : void
+    void setTrackGain(double gainInDecibels);
+
+    // purpose : show the paint time of the waveform
+    // input : true to show
+    // output : void
+    void setShowPaintTime(bool shouldShow);
+
 private:
 
     // id of the dj deck
@@ -65,6 +88,12 @@ private:
     TextButton forwardtButton{ ">>" };
     TextButton backwardButton{ "<<" };
 
+    // pre-listen the deck on the cue bus
+    TextButton cueButton{ "CUE" };
+
+    // picks the modulation of the deck
+    TextButton modButton{ "MOD" };
+
     // rotary sliders
     Slider volSlider;
     Slider speedSlider;
@@ -90,5 +119,13 @@ private:
     // filter controller component
     FilterController& filterController;
 
+    // moves the playhead once per display refresh, in step with the monitor
+    VBlankAttachment vBlankAttachment{ this, [this] { updatePlayhead(); } };
+
+    // purpose : move the playhead of the waveform to the position of the player
+    // input : none
+    // output : void
+    void updatePlayhead();
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DeckGUI)
 };
@@ -0,0 +1,158 @@
+#include "DeckMixer.h"
+
+DeckMixer::DeckMixer()
+{
+}
+
+DeckMixer::~DeckMixer()
+{
+}
+
+void DeckMixer::addDeck(DJAudioPlayer* deck)
+{
+    double sampleRate;
+    int blockSize;
+    {
+        const ScopedLock sl(lock);
+        sampleRate = currentSampleRate;
+        blockSize = bufferSizeExpected;
+    }
+
+    // prepared outside the lock, so the audio thread is only held up by the push
+    AudioBuffer<float> deckBuffer{ 2, blockSize };
+    if (sampleRate > 0.0)
+    {
+        deck->prepareToPlay(blockSize, sampleRate);
+    }
+
+    const ScopedLock sl(lock);
+
+    // the device was prepared again meanwhile
+    if (currentSampleRate > 0.0 && (currentSampleRate != sampleRate || bufferSizeExpected != blockSize))
+    {
+        deckBuffer.setSize(2, bufferSizeExpected);
+        deck->prepareToPlay(bufferSizeExpected, currentSampleRate);
+    }
+
+    decks.push_back(deck);
+    deckBuffers.push_back(std::move(deckBuffer));
+}
+
+void DeckMixer::setCueChannels(int firstChannel)
+{
+    if (firstChannel < 2)
+    {
+        std::cout << "DeckMixer::setCueChannels cue channels can't overlap the master pair" << std::endl;
+    }
+    else
+    {
+        cueFirstChannel = firstChannel;
+    }
+}
+
+void DeckMixer::setCueMix(double mix)
+{
+    if (mix < 0 || mix > 1.0)
+    {
+        std::cout << "DeckMixer::setCueMix mix should be between 0 and 1" << std::endl;
+    }
+    else
+    {
+        cueMix = (float) mix;
+    }
+}
+
+void DeckMixer::setCrossfader(double position)
+{
+    if (position < 0 || position > 1.0)
+    {
+        std::cout << "DeckMixer::setCrossfader position should be between 0 and 1" << std::endl;
+    }
+    else
+    {
+        crossfader = (float) position;
+    }
+}
+
+void DeckMixer::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+    const ScopedLock sl(lock);
+    currentSampleRate = sampleRate;
+    bufferSizeExpected = samplesPerBlockExpected;
+
+    for (size_t i = 0; i < decks.size(); ++i)
+    {
+        deckBuffers[i].setSize(2, samplesPerBlockExpected);
+        decks[i]->prepareToPlay(samplesPerBlockExpected, sampleRate);
+    }
+}
+
+void DeckMixer::getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill)
+{
+    AudioBuffer<float>& output = *bufferToFill.buffer;
+    const int numSamples = bufferToFill.numSamples;
+    const int start = bufferToFill.startSample;
+
+    const ScopedLock sl(lock);
+    bufferToFill.clearActiveBufferRegion();
+
+    // the cue pair only exists when the device opened enough outputs
+    const int cueLeft = cueFirstChannel;
+    const bool hasCueBus = output.getNumChannels() >= cueLeft + 2;
+
+    // the first deck fades out over the right half of the crossfader, the second over the left
+    const float fader = crossfader;
+    const float faderGains[2]{ juce::jmin(1.0f, 2.0f - 2.0f * fader), juce::jmin(1.0f, 2.0f * fader) };
+
+    // each deck decodes and processes its chain once, master gets every deck
+    for (size_t i = 0; i < decks.size(); ++i)
+    {
+        AudioBuffer<float>& deckBuffer = deckBuffers[i];
+        deckBuffer.setSize(2, numSamples, false, false, true);
+
+        AudioSourceChannelInfo deckInfo{ &deckBuffer, 0, numSamples };
+        decks[i]->getNextAudioBlock(deckInfo);
+
+        for (int channel = 0; channel < juce::jmin(2, output.getNumChannels()); ++channel)
+        {
+            output.addFrom(channel, start, deckBuffer, channel, 0, numSamples, i < 2 ? faderGains[i] : 1.0f);
+        }
+    }
+
+    if (!hasCueBus)
+    {
+        return;
+    }
+
+    // equal power blend between the cued decks and the master mix
+    const float mix = cueMix;
+    const float cueGain = std::cos(mix * juce::MathConstants<float>::halfPi);
+    const float masterGain = std::sin(mix * juce::MathConstants<float>::halfPi);
+
+    for (int channel = 0; channel < 2; ++channel)
+    {
+        output.addFrom(cueLeft + channel, start, output, channel, start, numSamples, masterGain);
+    }
+
+    for (size_t i = 0; i < decks.size(); ++i)
+    {
+        if (decks[i]->isCueEnabled())
+        {
+            for (int channel = 0; channel < 2; ++channel)
+            {
+                output.addFrom(cueLeft + channel, start, deckBuffers[i], channel, 0, numSamples, cueGain);
+            }
+        }
+    }
+}
+
+void DeckMixer::releaseResources()
+{
+    const ScopedLock sl(lock);
+    currentSampleRate = 0.0;
+
+    for (DJAudioPlayer* deck : decks)
+    {
+        deck->releaseResources();
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <vector>
+#include "DJAudioPlayer.h"
+
+// DeckMixer renders every deck once per block and fans the result out to two buses:
+// the master bus on the first output pair and the cue (headphone) bus on a second pair.
+// The cue bus carries the decks with cue enabled, blended with the master mix.
+// The crossfader fades between the first two decks on the master bus, the cue bus hears them
+// before it.
+class DeckMixer : public AudioSource
+{
+public:
+
+    DeckMixer();
+
+    ~DeckMixer();
+
+    // purpose : add a deck to the mix, a deck added while the audio runs is prepared first
+    // input : player of the deck
+    // output : void
+    void addDeck(DJAudioPlayer* deck);
+
+    // purpose : choose the device channels of the cue bus
+    // input : index of the left channel of the cue pair
+    // output : void
+    void setCueChannels(int firstChannel);
+
+    // purpose : set the blend of the cue bus
+    // input : 0 for cued decks only, 1 for the master mix only
+    // output : void
+    void setCueMix(double mix);
+
+    // purpose : set the crossfader, safe from the audio thread
+    // input : 0 for the first deck only, 1 for the second deck only, both at full level in the
+    //         middle
+    // output : void
+    void setCrossfader(double position);
+
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill) override;
+    void releaseResources() override;
+
+private:
+
+    // guards the decks against the audio thread while one is added
+    CriticalSection lock;
+
+    std::vector<DJAudioPlayer*> decks;
+
+    // the block of every deck, reused by both buses
+    std::vector<AudioBuffer<float>> deckBuffers;
+
+    // format of the device once prepared, 0 before
+    double currentSampleRate{ 0.0 };
+    int bufferSizeExpected{ 0 };
+
+    std::atomic<int> cueFirstChannel{ 2 };
+    std::atomic<float> cueMix{ 0.0f };
+    std::atomic<float> crossfader{ 0.5f };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DeckMixer)
+};
@@ -0,0 +1,30 @@
+#include "DiskThumbnailCache.h"
+
+DiskThumbnailCache::DiskThumbnailCache(AnalysisStore& _analysisStore, int maxThumbsInMemory)
+    : juce::AudioThumbnailCache(maxThumbsInMemory),
+    analysisStore(_analysisStore)
+{
+}
+
+DiskThumbnailCache::~DiskThumbnailCache()
+{
+}
+
+bool DiskThumbnailCache::loadNewThumb(juce::AudioThumbnailBase& thumb, juce::int64 hashCode)
+{
+    juce::MemoryBlock data;
+    if (!analysisStore.get(AnalysisStore::hashToString(hashCode), analyzerName, analyzerVersion, data))
+    {
+        return false;
+    }
+
+    juce::MemoryInputStream in{ data, false };
+    return thumb.loadFrom(in);
+}
+
+void DiskThumbnailCache::saveNewlyFinishedThumbnail(const juce::AudioThumbnailBase& thumb, juce::int64 hashCode)
+{
+    juce::MemoryOutputStream out;
+    thumb.saveTo(out);
+    analysisStore.put(AnalysisStore::hashToString(hashCode), analyzerName, analyzerVersion, out.getMemoryBlock());
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "AnalysisStore.h"
+
+// DiskThumbnailCache keeps the waveform overviews of tracks streamed onto the decks in the
+// analysis store, so a stream drawn once shows its waveform at once on later loads and after a
+// restart instead of being read again. Local files are drawn from their pyramids and never get
+// an overview. Overviews are also kept in memory like in the plain AudioThumbnailCache, keyed
+// by the hash code of their source, and the analysis store's size cap and least recently used
+// eviction apply to them too.
+class DiskThumbnailCache : public juce::AudioThumbnailCache
+{
+public:
+
+    // samples of the track per overview point
+    static constexpr int samplesPerThumbnailSample = 1000;
+
+    // name and version of the overview in the analysis store
+    static constexpr const char* analyzerName = "thumbnail";
+    static constexpr int analyzerVersion = 1;
+
+    DiskThumbnailCache(AnalysisStore& analysisStore, int maxThumbsInMemory);
+
+    ~DiskThumbnailCache() override;
+
+protected:
+
+    // purpose : read an overview that isn't in memory from the analysis store
+    // input : thumbnail to fill, hash code of its source
+    // output : true if found
+    bool loadNewThumb(juce::AudioThumbnailBase& thumb, juce::int64 hashCode) override;
+
+    // purpose : write a finished overview to the analysis store
+    // input : thumbnail, hash code of its source
+    // output : void
+    void saveNewlyFinishedThumbnail(const juce::AudioThumbnailBase& thumb, juce::int64 hashCode) override;
+
+private:
+
+    AnalysisStore& analysisStore;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DiskThumbnailCache)
+};
@@ -29,6 +29,10 @@ void FilterController::prepareToPlay(double sampleRate, int samplesPerBlock)
 
     highPassFilter.prepare(spec);
     highPassFilter.coefficients = juce::dsp::IIR::Coefficients<float>::makeHighPass(sampleRate, 20.0f);
+
+    // the frequencies set before are taken up by the first block
+    appliedLowPass = 20000.0;
+    appliedHighPass = 20.0;
 }
 
 // purpose: set the low pass frequency values
@@ -44,8 +48,7 @@ void FilterController::setLowPassFrequency(double frequency)
         frequency = 1000.0;
     }
 
-    auto values = juce::dsp::IIR::Coefficients<float>::makeLowPass(currentSampleRate, frequency);
-    lowPassFilter.coefficients = values;
+    lowPassFrequency = frequency;
 }
 
 // purpose: set the high pass frequency values
@@ -61,9 +64,39 @@ void FilterController::setHighPassFrequency(double frequency)
         frequency = 500.0;
     }
 
-    auto coefficients = juce::dsp::IIR::Coefficients<float>::makeHighPass(currentSampleRate, frequency);
-    highPassFilter.coefficients = coefficients;
+    highPassFrequency = frequency;
+}
+
+double FilterController::getLowPassFrequency() const
+{
+    return lowPassFrequency;
+}
+
+double FilterController::getHighPassFrequency() const
+{
+    return highPassFrequency;
+}
+
+// purpose: move the filters to new frequencies, without allocating
+// input: frequencies
+// output : none
+void FilterController::updateFilters(double lowPass, double highPass)
+{
+    // the filters can't go past the nyquist frequency
+    double highest{ currentSampleRate * 0.45 };
+    lowPass = juce::jlimit(20.0, highest, lowPass);
+    highPass = juce::jlimit(20.0, highest, highPass);
 
+    if (lowPass != appliedLowPass)
+    {
+        *lowPassFilter.coefficients = juce::dsp::IIR::ArrayCoefficients<float>::makeLowPass(currentSampleRate, (float) lowPass);
+        appliedLowPass = lowPass;
+    }
+    if (highPass != appliedHighPass)
+    {
+        *highPassFilter.coefficients = juce::dsp::IIR::ArrayCoefficients<float>::makeHighPass(currentSampleRate, (float) highPass);
+        appliedHighPass = highPass;
+    }
 }
 
 // purpose: apply filters to the audio bloack
@@ -78,6 +111,9 @@ void FilterController::processAudioBlock(juce::AudioBuffer<float>& buffer)
         return;
     }
 
+    // take up the frequencies set since the last block
+    updateFilters(lowPassFrequency, highPassFrequency);
+
     // get channels individually
     for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
     {
@@ -85,6 +121,20 @@ void FilterController::processAudioBlock(juce::AudioBuffer<float>& buffer)
     }
 }
 
+// purpose: apply filters to a part of the audio block at other frequencies than the ones set
+// input: audio buffer, first sample and number of samples, frequencies of the filters
+// output : none
+void FilterController::processSection(juce::AudioBuffer<float>& buffer, int startSample, int numSamples,
+    double lowPass, double highPass)
+{
+    updateFilters(lowPass, highPass);
+
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+    {
+        processSingleChannel(buffer.getWritePointer(channel, startSample), numSamples);
+    }
+}
+
 // purpose: process a channel
 // input: data array pointer and the number of samples in it
 // output : none
@@ -1,7 +1,10 @@
 
 #pragma once
 #include <JuceHeader.h>
+#include <atomic>
 // FilterController class is responsible for adding the lowPass and highPass filtering mechanisms
+// The frequencies are set from the message thread and taken up by the audio thread, which is
+// the only one changing the filters
 class FilterController
 {
 public:
@@ -25,11 +28,24 @@ public:
 	// output : none
 	void setHighPassFrequency(double frequency);
 
+	// purpose: get the frequencies set
+	// input: none
+	// output : frequency
+	double getLowPassFrequency() const;
+	double getHighPassFrequency() const;
+
 	// purpose: apply filters to the audio bloack
 	// input: audio buffer for processing
 	// output : none
 	void processAudioBlock(juce::AudioBuffer<float>& buffer);
 
+	// purpose: apply filters to a part of the audio block at other frequencies than the ones set,
+	//          for modulation, from the audio thread
+	// input: audio buffer, first sample and number of samples, frequencies of the filters
+	// output : none
+	void processSection(juce::AudioBuffer<float>& buffer, int startSample, int numSamples,
+		double lowPass, double highPass);
+
 	// purpose: process a channel
 	// input: data array pointer and the number of samples in it
 	// output : none
@@ -41,10 +57,19 @@ private:
 	juce::dsp::IIR::Filter<float> bandPassFilter;
 	juce::dsp::IIR::Filter<float> highPassFilter;
 
-	// setting initial values
-	double lowPassFrequency = 2000.0;
+	// setting initial values, fully open until the sliders move
+	std::atomic<double> lowPassFrequency{ 20000.0 };
 	double bandPassFrequency = 1000.0;
-	double highPassFrequency = 500.0;
+	std::atomic<double> highPassFrequency{ 20.0 };
+
+	// frequencies the filters are at, on the audio thread
+	double appliedLowPass = 20000.0;
+	double appliedHighPass = 20.0;
+
+	// purpose: move the filters to new frequencies, without allocating
+	// input: frequencies
+	// output : none
+	void updateFilters(double lowPass, double highPass);
 
 	double currentSampleRate;
 	double lastSampleRate;
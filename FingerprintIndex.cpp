@@ -0,0 +1,589 @@
+#include "FingerprintIndex.h"
+#include "AudioFingerprint.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+
+static constexpr int indexVersion = 2;
+static constexpr int headerSize = 8;
+
+// the section of a track that is fingerprinted, placed from its own length so two copies
+// of a recording pick the same section
+static constexpr double sectionStartMax = 30.0;
+static constexpr double sectionLength = 15.0;
+
+// every few frames go into the hash table, a true duplicate still hits dozens of them
+static constexpr int postingStride = 8;
+
+// candidates compared on their signature per lookup
+static constexpr int maxCandidates = 8;
+
+// below this bit error rate two fingerprints are the same recording
+static constexpr float maxBitErrorRate = 0.35f;
+
+// copies of a recording differ in length by encoder padding at most
+static constexpr double maxLengthDifference = 2.0;
+
+// FNV-1a over an entry of the file
+static juce::uint32 checksum(const void* data, size_t size)
+{
+    juce::uint32 hash{ 2166136261u };
+    const juce::uint8* bytes{ static_cast<const juce::uint8*>(data) };
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// silence and clipping give the same sub-fingerprint in every track, they say nothing
+static bool isInformative(juce::uint32 subFingerprint)
+{
+    return subFingerprint != 0 && subFingerprint != 0xffffffff;
+}
+
+class FingerprintIndex::FingerprintJob : public juce::ThreadPoolJob
+{
+public:
+    FingerprintJob(FingerprintIndex& _owner, Result _result)
+        : juce::ThreadPoolJob("Fingerprint"),
+        owner(_owner),
+        result(std::move(_result))
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        owner.threadConfig.applyToCurrentThread(ThreadConfig::Role::analysis);
+
+        std::unique_ptr<juce::AudioFormatReader> reader{ owner.formatManager.createReaderFor(result.file) };
+        if (reader != nullptr && !shouldExit())
+        {
+            double start{ juce::jmin(sectionStartMax, result.lengthInSeconds * 0.25) };
+            result.fingerprint = AudioFingerprint::compute(*reader, start, sectionLength);
+        }
+
+        result.fileSize = result.file.getSize();
+        result.modificationTime = result.file.getLastModificationTime().toMilliseconds();
+
+        const juce::ScopedLock lock(owner.resultsLock);
+        owner.pendingResults.push_back(std::move(result));
+        return jobHasFinished;
+    }
+
+private:
+    FingerprintIndex& owner;
+    Result result;
+};
+
+FingerprintIndex::FingerprintIndex(juce::AudioFormatManager& _formatManager, ThreadConfig& _threadConfig, const juce::File& indexFile)
+    : formatManager(_formatManager),
+    threadConfig(_threadConfig),
+    file(indexFile),
+    pool(1, 0, juce::Thread::Priority::low)
+{
+    // a missing, old or foreign file is written again from what could be read
+    if (load())
+    {
+        openJournal();
+    }
+    else
+    {
+        compact();
+    }
+}
+
+FingerprintIndex::~FingerprintIndex()
+{
+    stopTimer();
+    pool.removeAllJobs(true, 5000);
+    save();
+}
+
+void FingerprintIndex::queue(TrackId id, const juce::File& audioFile, double lengthInSeconds, bool reportDuplicate)
+{
+    Result job;
+    job.id = id;
+    job.file = audioFile;
+    job.lengthInSeconds = lengthInSeconds;
+    job.reportDuplicate = reportDuplicate;
+
+    pool.addJob(new FingerprintJob(*this, std::move(job)), true);
+    startTimer(250);
+}
+
+bool FingerprintIndex::isFingerprinting()
+{
+    return isTimerRunning();
+}
+
+bool FingerprintIndex::contains(TrackId id)
+{
+    return entries.count(id) > 0;
+}
+
+void FingerprintIndex::remove(TrackId id)
+{
+    removedIds.insert(id);
+
+    auto it = entries.find(id);
+    if (it != entries.end())
+    {
+        removePostings(id, it->second.signature);
+        entries.erase(it);
+
+        juce::MemoryOutputStream payload;
+        payload.writeInt64((juce::int64) id);
+        appendToJournal(removeOp, payload.getMemoryBlock());
+    }
+
+    // with the original gone its duplicates are welcome again
+    for (auto duplicate = duplicates.begin(); duplicate != duplicates.end();)
+    {
+        if (duplicate->second.original == id)
+        {
+            juce::MemoryOutputStream payload;
+            payload.writeString(duplicate->first);
+            appendToJournal(forgetDuplicateOp, payload.getMemoryBlock());
+            duplicate = duplicates.erase(duplicate);
+        }
+        else
+        {
+            ++duplicate;
+        }
+    }
+}
+
+bool FingerprintIndex::isKnownDuplicate(const juce::String& path, juce::int64 size, juce::int64 modificationTime)
+{
+    auto it = duplicates.find(path);
+    return it != duplicates.end() && it->second.size == size && it->second.modificationTime == modificationTime;
+}
+
+void FingerprintIndex::timerCallback()
+{
+    std::vector<Result> results;
+    {
+        const juce::ScopedLock lock(resultsLock);
+        results.swap(pendingResults);
+    }
+
+    for (Result& result : results)
+    {
+        if (result.fingerprint.empty() || removedIds.erase(result.id) > 0)
+        {
+            continue;
+        }
+
+        // a rewritten file replaces its old fingerprint
+        auto old = entries.find(result.id);
+        if (old != entries.end())
+        {
+            removePostings(result.id, old->second.signature);
+            entries.erase(old);
+        }
+
+        if (result.reportDuplicate)
+        {
+            TrackId original{ findDuplicate(result.fingerprint, result.lengthInSeconds, result.id) };
+            if (original != 0)
+            {
+                Duplicate duplicate{ result.fileSize, result.modificationTime, original };
+                duplicates[result.file.getFullPathName()] = duplicate;
+                appendToJournal(duplicateOp, encodeDuplicate(result.file.getFullPathName(), duplicate));
+
+                if (onDuplicateFound)
+                {
+                    onDuplicateFound(result.id, original);
+                }
+                continue;
+            }
+        }
+
+        // only the signature outlives the match
+        Entry entry{ result.lengthInSeconds, getSignature(result.fingerprint) };
+        addPostings(result.id, entry.signature);
+        appendToJournal(putOp, encodeEntry(result.id, entry));
+        entries[result.id] = std::move(entry);
+    }
+
+    if (pool.getNumJobs() == 0)
+    {
+        const juce::ScopedLock lock(resultsLock);
+        if (pendingResults.empty())
+        {
+            stopTimer();
+            save();
+        }
+    }
+}
+
+TrackId FingerprintIndex::findDuplicate(const std::vector<juce::uint32>& fingerprint, double lengthInSeconds, TrackId ignore)
+{
+    // every hit votes for a track and the alignment it implies
+    std::map<std::pair<TrackId, int>, int> votes;
+    for (size_t frame = 0; frame < fingerprint.size(); ++frame)
+    {
+        if (!isInformative(fingerprint[frame]))
+        {
+            continue;
+        }
+
+        auto hits = postings.find(fingerprint[frame]);
+        if (hits == postings.end())
+        {
+            continue;
+        }
+
+        for (const Posting& posting : hits->second)
+        {
+            if (posting.id != ignore)
+            {
+                ++votes[{ posting.id, (int) posting.frame - (int) frame }];
+            }
+        }
+    }
+
+    std::vector<std::pair<int, std::pair<TrackId, int>>> candidates;
+    for (const auto& vote : votes)
+    {
+        if (vote.second >= 2)
+        {
+            candidates.push_back({ vote.second, vote.first });
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    int minOverlap{ juce::jmin(32, (int) fingerprint.size() / (2 * postingStride)) };
+
+    for (size_t i = 0; i < candidates.size() && i < (size_t) maxCandidates; ++i)
+    {
+        TrackId id{ candidates[i].second.first };
+        int offset{ candidates[i].second.second };
+
+        auto entry = entries.find(id);
+        if (entry == entries.end())
+        {
+            continue;
+        }
+
+        if (lengthInSeconds > 0.0 && entry->second.lengthInSeconds > 0.0
+            && std::abs(lengthInSeconds - entry->second.lengthInSeconds) > maxLengthDifference)
+        {
+            continue;
+        }
+
+        if (signatureErrorRate(entry->second.signature, fingerprint, offset, minOverlap) < maxBitErrorRate)
+        {
+            return id;
+        }
+    }
+    return 0;
+}
+
+std::vector<juce::uint32> FingerprintIndex::getSignature(const std::vector<juce::uint32>& fingerprint)
+{
+    std::vector<juce::uint32> signature;
+    signature.reserve(fingerprint.size() / postingStride + 1);
+    for (size_t frame = 0; frame < fingerprint.size(); frame += postingStride)
+    {
+        signature.push_back(fingerprint[frame]);
+    }
+    return signature;
+}
+
+float FingerprintIndex::signatureErrorRate(const std::vector<juce::uint32>& signature, const std::vector<juce::uint32>& fingerprint,
+                                           int offset, int minOverlap)
+{
+    // sample k of the signature is frame k * postingStride of its track, which lines up with
+    // frame k * postingStride - offset of the fingerprint
+    int overlap{ 0 };
+    int differingBits{ 0 };
+    for (size_t k = 0; k < signature.size(); ++k)
+    {
+        int frame{ (int) k * postingStride - offset };
+        if (frame >= 0 && frame < (int) fingerprint.size())
+        {
+            differingBits += juce::countNumberOfBits(signature[k] ^ fingerprint[(size_t) frame]);
+            ++overlap;
+        }
+    }
+
+    if (overlap < juce::jmax(1, minOverlap))
+    {
+        return 1.0f;
+    }
+    return (float) differingBits / (float) (overlap * 32);
+}
+
+void FingerprintIndex::addPostings(TrackId id, const std::vector<juce::uint32>& signature)
+{
+    for (size_t k = 0; k < signature.size(); ++k)
+    {
+        if (isInformative(signature[k]))
+        {
+            postings[signature[k]].push_back({ id, (juce::uint32) (k * postingStride) });
+        }
+    }
+}
+
+void FingerprintIndex::removePostings(TrackId id, const std::vector<juce::uint32>& signature)
+{
+    for (juce::uint32 subFingerprint : signature)
+    {
+        auto hits = postings.find(subFingerprint);
+        if (hits == postings.end())
+        {
+            continue;
+        }
+
+        std::vector<Posting>& list{ hits->second };
+        list.erase(std::remove_if(list.begin(), list.end(), [id](const Posting& posting) { return posting.id == id; }), list.end());
+        if (list.empty())
+        {
+            postings.erase(hits);
+        }
+    }
+}
+
+void FingerprintIndex::save()
+{
+    // the file is rewritten once most of it is replaced or removed entries
+    if (journal != nullptr && journalEntries > juce::jmax(1024, 2 * (int) (entries.size() + duplicates.size())))
+    {
+        compact();
+    }
+}
+
+juce::MemoryBlock FingerprintIndex::encodeEntry(TrackId id, const Entry& entry)
+{
+    juce::MemoryOutputStream payload;
+    payload.writeInt64((juce::int64) id);
+    payload.writeDouble(entry.lengthInSeconds);
+    payload.writeInt((int) entry.signature.size());
+    for (juce::uint32 subFingerprint : entry.signature)
+    {
+        payload.writeInt((int) subFingerprint);
+    }
+    return payload.getMemoryBlock();
+}
+
+juce::MemoryBlock FingerprintIndex::encodeDuplicate(const juce::String& path, const Duplicate& duplicate)
+{
+    juce::MemoryOutputStream payload;
+    payload.writeString(path);
+    payload.writeInt64(duplicate.size);
+    payload.writeInt64(duplicate.modificationTime);
+    payload.writeInt64((juce::int64) duplicate.original);
+    return payload.getMemoryBlock();
+}
+
+void FingerprintIndex::openJournal()
+{
+    journal = std::make_unique<juce::FileOutputStream>(file);
+    if (journal->failedToOpen())
+    {
+        std::cerr << "FingerprintIndex: can't write " << file.getFullPathName() << std::endl;
+        journal.reset();
+    }
+}
+
+void FingerprintIndex::appendToJournal(Op op, const juce::MemoryBlock& payload)
+{
+    if (journal == nullptr)
+    {
+        return;
+    }
+
+    juce::MemoryOutputStream entry;
+    entry.writeByte((char) op);
+    entry.writeInt((int) payload.getSize());
+    entry.write(payload.getData(), payload.getSize());
+    entry.writeInt((int) checksum(entry.getData(), entry.getDataSize()));
+
+    journal->write(entry.getData(), entry.getDataSize());
+    journal->flush();
+    ++journalEntries;
+}
+
+void FingerprintIndex::compact()
+{
+    // the old journal stays open until the file is replaced, so a failed write loses nothing
+    juce::TemporaryFile temp{ file };
+    {
+        juce::FileOutputStream out{ temp.getFile() };
+        if (out.failedToOpen())
+        {
+            std::cerr << "FingerprintIndex: can't write " << file.getFullPathName() << std::endl;
+            return;
+        }
+
+        out.write("OTFP", 4);
+        out.writeInt(indexVersion);
+
+        auto writeEntry = [&out](Op op, const juce::MemoryBlock& payload)
+        {
+            juce::MemoryOutputStream entry;
+            entry.writeByte((char) op);
+            entry.writeInt((int) payload.getSize());
+            entry.write(payload.getData(), payload.getSize());
+            entry.writeInt((int) checksum(entry.getData(), entry.getDataSize()));
+            out.write(entry.getData(), entry.getDataSize());
+        };
+
+        for (const auto& item : entries)
+        {
+            writeEntry(putOp, encodeEntry(item.first, item.second));
+        }
+        for (const auto& item : duplicates)
+        {
+            writeEntry(duplicateOp, encodeDuplicate(item.first, item.second));
+        }
+    }
+
+    if (!temp.overwriteTargetFileWithTemporary())
+    {
+        std::cerr << "FingerprintIndex: can't replace " << file.getFullPathName() << std::endl;
+        return;
+    }
+    journalEntries = (int) (entries.size() + duplicates.size());
+
+    journal.reset();
+    openJournal();
+}
+
+bool FingerprintIndex::applyEntry(Op op, const void* data, size_t size)
+{
+    juce::MemoryInputStream in{ data, size, false };
+
+    switch (op)
+    {
+        case putOp:
+        {
+            TrackId id{ (TrackId) in.readInt64() };
+            Entry entry;
+            entry.lengthInSeconds = in.readDouble();
+            int count{ in.readInt() };
+            if (count < 0 || (size_t) count * 4 != (size_t) in.getNumBytesRemaining())
+            {
+                return false;
+            }
+
+            entry.signature.resize((size_t) count);
+            for (juce::uint32& subFingerprint : entry.signature)
+            {
+                subFingerprint = (juce::uint32) in.readInt();
+            }
+
+            auto old = entries.find(id);
+            if (old != entries.end())
+            {
+                removePostings(id, old->second.signature);
+            }
+            addPostings(id, entry.signature);
+            entries[id] = std::move(entry);
+            return true;
+        }
+        case removeOp:
+        {
+            TrackId id{ (TrackId) in.readInt64() };
+            auto it = entries.find(id);
+            if (it != entries.end())
+            {
+                removePostings(id, it->second.signature);
+                entries.erase(it);
+            }
+            return true;
+        }
+        case duplicateOp:
+        {
+            juce::String path{ in.readString() };
+            Duplicate duplicate;
+            duplicate.size = in.readInt64();
+            duplicate.modificationTime = in.readInt64();
+            duplicate.original = (TrackId) in.readInt64();
+            duplicates[path] = duplicate;
+            return true;
+        }
+        case forgetDuplicateOp:
+            duplicates.erase(in.readString());
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool FingerprintIndex::load()
+{
+    int version{ 0 };
+    juce::int64 position{ headerSize };
+    {
+        juce::FileInputStream in{ file };
+        if (in.failedToOpen())
+        {
+            return false;
+        }
+
+        char magic[4] = {};
+        if (in.read(magic, 4) == 4 && std::memcmp(magic, "OTFP", 4) == 0)
+        {
+            version = in.readInt();
+        }
+
+        if (version != indexVersion)
+        {
+            std::cerr << "FingerprintIndex: ignoring " << file.getFullPathName() << ", unknown format" << std::endl;
+            return false;
+        }
+
+        juce::BufferedInputStream buffered{ in, 1 << 16 };
+        juce::MemoryBlock entry;
+        const size_t entryHeader{ 1 + 4 };
+
+        while (!buffered.isExhausted())
+        {
+            // the payload can't be larger than what is left of the file
+            juce::int64 remaining{ buffered.getNumBytesRemaining() };
+            if (remaining < (juce::int64) entryHeader + 4)
+            {
+                break;
+            }
+
+            entry.setSize(entryHeader);
+            buffered.read(entry.getData(), (int) entryHeader);
+            const char* header{ static_cast<const char*>(entry.getData()) };
+            Op op{ (Op) (juce::uint8) header[0] };
+            size_t size{ juce::ByteOrder::littleEndianInt(header + 1) };
+            if ((juce::int64) (entryHeader + size + 4) > remaining)
+            {
+                break;
+            }
+
+            entry.setSize(entryHeader + size + 4);
+            buffered.read(static_cast<char*>(entry.getData()) + entryHeader, (int) (size + 4));
+            const char* bytes{ static_cast<const char*>(entry.getData()) };
+            if (checksum(bytes, entryHeader + size) != juce::ByteOrder::littleEndianInt(bytes + entryHeader + size)
+                || !applyEntry(op, bytes + entryHeader, size))
+            {
+                break;
+            }
+
+            position += (juce::int64) (entryHeader + size + 4);
+            ++journalEntries;
+        }
+    }
+
+    // keep only the valid part so new entries follow a complete one
+    if (position < file.getSize())
+    {
+        std::cerr << "FingerprintIndex: dropping a torn tail of " << file.getSize() - position << " bytes" << std::endl;
+        juce::FileOutputStream out{ file };
+        if (!out.failedToOpen())
+        {
+            out.setPosition(position);
+            out.truncate();
+        }
+    }
+    return true;
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "Song.h"
+#include "ThreadConfig.h"
+
+// FingerprintIndex fingerprints the library tracks on a low priority background thread and
+// finds true duplicates, the same recording under another name or in another format.
+// Every few sub-fingerprints of a track are kept in a hash table, so a new fingerprint only
+// looks up its own sub-fingerprints to find candidates and their alignment, and only those
+// few candidates are compared by bit error rate and length.
+// Only the sampled sub-fingerprints of a track are kept, in the hash table and as its
+// signature, candidates are compared on those frames.
+// Files rejected as duplicates are remembered by path, size and modification time so they
+// are turned away straight away when they come back. The index lives on the message thread.
+//
+// file  : header | entries of (op, size, payload, checksum)
+// every change is appended, the file is rewritten with only the live entries once it grows
+class FingerprintIndex : private juce::Timer
+{
+public:
+
+    FingerprintIndex(juce::AudioFormatManager& formatManager, ThreadConfig& threadConfig, const juce::File& indexFile);
+
+    ~FingerprintIndex() override;
+
+    // purpose : fingerprint a track in the background
+    // input : id, file and length of the track, and whether a match should be reported
+    // output : void
+    void queue(TrackId id, const juce::File& file, double lengthInSeconds, bool reportDuplicate);
+
+    // purpose : check if tracks are still being fingerprinted or matched
+    // input : none
+    // output : true while busy
+    bool isFingerprinting();
+
+    // purpose : check if a track is fingerprinted
+    // input : id of the track
+    // output : true if it is in the index
+    bool contains(TrackId id);
+
+    // purpose : forget a track, and the files rejected as its duplicates
+    // input : id of the track
+    // output : void
+    void remove(TrackId id);
+
+    // purpose : check if a file was already rejected as a duplicate
+    // input : path, current size and modification time (ms)
+    // output : true if it was rejected and hasn't changed since
+    bool isKnownDuplicate(const juce::String& path, juce::int64 size, juce::int64 modificationTime);
+
+    // called on the message thread when a reported track turns out to duplicate another one
+    std::function<void(TrackId id, TrackId original)> onDuplicateFound;
+
+    // purpose : rewrite the index file if it holds many replaced entries
+    // input : none
+    // output : void
+    void save();
+
+private:
+
+    class FingerprintJob;
+
+    // a track, its signature is every postingStride-th sub-fingerprint of its fingerprint
+    struct Entry
+    {
+        double lengthInSeconds{ 0.0 };
+        std::vector<juce::uint32> signature;
+    };
+
+    // file operations
+    enum Op : juce::uint8
+    {
+        putOp = 1,
+        removeOp = 2,
+        duplicateOp = 3,
+        forgetDuplicateOp = 4
+    };
+
+    struct Posting
+    {
+        TrackId id;
+        juce::uint32 frame;
+    };
+
+    struct Result
+    {
+        TrackId id{ 0 };
+        juce::File file;
+        juce::int64 fileSize{ 0 };
+        juce::int64 modificationTime{ 0 };
+        double lengthInSeconds{ 0.0 };
+        bool reportDuplicate{ false };
+        std::vector<juce::uint32> fingerprint;
+    };
+
+    struct Duplicate
+    {
+        juce::int64 size{ 0 };
+        juce::int64 modificationTime{ 0 };
+        TrackId original{ 0 };
+    };
+
+    struct StringHash
+    {
+        size_t operator()(const juce::String& text) const noexcept { return (size_t) text.hashCode64(); }
+    };
+
+    juce::AudioFormatManager& formatManager;
+    ThreadConfig& threadConfig;
+    juce::File file;
+
+    juce::ThreadPool pool;
+
+    // filled by the jobs, drained by the timer
+    juce::CriticalSection resultsLock;
+    std::vector<Result> pendingResults;
+
+    std::unordered_map<TrackId, Entry> entries;
+    std::unordered_map<juce::uint32, std::vector<Posting>> postings;
+    std::unordered_map<juce::String, Duplicate, StringHash> duplicates;
+
+    // tracks removed while their fingerprint was still being computed
+    std::unordered_set<TrackId> removedIds;
+
+    // appends the changes to the file
+    std::unique_ptr<juce::FileOutputStream> journal;
+    int journalEntries{ 0 };
+
+    // purpose : match and index the finished fingerprints
+    // input : none
+    // output : void
+    void timerCallback() override;
+
+    // purpose : find a track the fingerprint duplicates
+    // input : fingerprint, length of its track, track to leave out
+    // output : id of the duplicated track, 0 if none
+    TrackId findDuplicate(const std::vector<juce::uint32>& fingerprint, double lengthInSeconds, TrackId ignore);
+
+    // purpose : keep the sub-fingerprints of a fingerprint that go into the hash table
+    // input : fingerprint
+    // output : signature
+    static std::vector<juce::uint32> getSignature(const std::vector<juce::uint32>& fingerprint);
+
+    // purpose : compare a signature with a fingerprint shifted by an offset
+    // input : signature, fingerprint, offset in frames, frames they must overlap by
+    // output : fraction of differing bits, 1 if they overlap by less than minOverlap
+    static float signatureErrorRate(const std::vector<juce::uint32>& signature, const std::vector<juce::uint32>& fingerprint,
+                                    int offset, int minOverlap);
+
+    // purpose : add or remove the sub-fingerprints of a track in the hash table
+    // input : id of the track, its signature
+    // output : void
+    void addPostings(TrackId id, const std::vector<juce::uint32>& signature);
+    void removePostings(TrackId id, const std::vector<juce::uint32>& signature);
+
+    // purpose : read the index of the previous sessions, dropping a torn tail
+    // input : none
+    // output : true if new entries can be appended to the file as it is
+    bool load();
+
+    // purpose : apply one entry of the file
+    // input : operation, payload
+    // output : false if the payload doesn't fit the operation
+    bool applyEntry(Op op, const void* data, size_t size);
+
+    // purpose : start appending to the file
+    // input : none
+    // output : void
+    void openJournal();
+
+    // purpose : append an entry to the file and flush it
+    // input : operation, payload
+    // output : void
+    void appendToJournal(Op op, const juce::MemoryBlock& payload);
+
+    // purpose : write the payload of a track or a rejected file
+    // input : the track or the rejected file
+    // output : payload
+    static juce::MemoryBlock encodeEntry(TrackId id, const Entry& entry);
+    static juce::MemoryBlock encodeDuplicate(const juce::String& path, const Duplicate& duplicate);
+
+    // purpose : rewrite the file with only the live entries
+    // input : none
+    // output : void
+    void compact();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FingerprintIndex)
+};
@@ -0,0 +1,469 @@
+#include "FolderWatcher.h"
+
+#if JUCE_LINUX
+ #include <sys/inotify.h>
+ #include <sys/eventfd.h>
+ #include <poll.h>
+ #include <unistd.h>
+ #include <cerrno>
+#endif
+
+#include <algorithm>
+
+// a batch is handed over once nothing happened for this long
+static constexpr juce::uint32 quietPeriodMs = 500;
+
+// or earlier when this many changes piled up during a long copy
+static constexpr size_t maxPendingChanges = 2000;
+
+FolderWatcher::FolderWatcher(const juce::StringArray& audioExtensions, ThreadConfig& _threadConfig)
+    : juce::Thread("Folder watcher"),
+    threadConfig(_threadConfig)
+{
+    for (const juce::String& extension : audioExtensions)
+    {
+        extensions.add(extension.trim().toLowerCase());
+    }
+
+#if JUCE_LINUX
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotifyFd < 0)
+    {
+        std::cerr << "FolderWatcher: inotify is not available, folders are only scanned when added" << std::endl;
+    }
+#else
+    std::cout << "FolderWatcher: folders are only scanned when added, live updates need inotify" << std::endl;
+#endif
+
+    startThread(juce::Thread::Priority::low);
+    startTimer(200);
+}
+
+FolderWatcher::~FolderWatcher()
+{
+    stopTimer();
+    signalThreadShouldExit();
+
+#if JUCE_LINUX
+    if (wakeFd >= 0)
+    {
+        juce::uint64 one{ 1 };
+        ::write(wakeFd, &one, sizeof(one));
+    }
+#endif
+
+    stopThread(4000);
+
+#if JUCE_LINUX
+    if (inotifyFd >= 0)
+    {
+        ::close(inotifyFd);
+    }
+    if (wakeFd >= 0)
+    {
+        ::close(wakeFd);
+    }
+#endif
+}
+
+void FolderWatcher::addFolder(const juce::File& folder, bool scanExistingFiles)
+{
+    {
+        const juce::ScopedLock lock(requestLock);
+        addRequests.push_back({ folder, scanExistingFiles });
+    }
+    notify();
+
+#if JUCE_LINUX
+    if (wakeFd >= 0)
+    {
+        juce::uint64 one{ 1 };
+        ::write(wakeFd, &one, sizeof(one));
+    }
+#endif
+}
+
+void FolderWatcher::removeFolder(const juce::File& folder)
+{
+    {
+        const juce::ScopedLock lock(requestLock);
+        removeRequests.push_back(folder);
+    }
+    notify();
+
+#if JUCE_LINUX
+    if (wakeFd >= 0)
+    {
+        juce::uint64 one{ 1 };
+        ::write(wakeFd, &one, sizeof(one));
+    }
+#endif
+}
+
+void FolderWatcher::run()
+{
+    threadConfig.applyToCurrentThread(ThreadConfig::Role::loader);
+
+    while (!threadShouldExit())
+    {
+        std::vector<std::pair<juce::File, bool>> foldersToAdd;
+        std::vector<juce::File> foldersToRemove;
+        {
+            const juce::ScopedLock lock(requestLock);
+            foldersToAdd.swap(addRequests);
+            foldersToRemove.swap(removeRequests);
+        }
+
+#if JUCE_LINUX
+        for (const juce::File& folder : foldersToRemove)
+        {
+            juce::String root{ folder.getFullPathName() };
+            roots.erase(root);
+
+            for (auto it = watches.begin(); it != watches.end();)
+            {
+                if (it->second == root || it->second.startsWith(root + "/"))
+                {
+                    inotify_rm_watch(inotifyFd, it->first);
+                    it = watches.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+
+        for (const auto& request : foldersToAdd)
+        {
+            roots.insert(request.first.getFullPathName());
+            watchRecursively(request.first, request.second);
+        }
+
+        if (inotifyFd < 0)
+        {
+            wait(-1);
+            continue;
+        }
+
+        pollfd fds[2] = { { inotifyFd, POLLIN, 0 }, { wakeFd, POLLIN, 0 } };
+        if (poll(fds, 2, 1000) <= 0)
+        {
+            continue;
+        }
+
+        if ((fds[1].revents & POLLIN) != 0)
+        {
+            juce::uint64 value;
+            ::read(wakeFd, &value, sizeof(value));
+        }
+
+        if ((fds[0].revents & POLLIN) != 0)
+        {
+            alignas(inotify_event) char buffer[64 * 1024];
+            ssize_t bytesRead;
+            while ((bytesRead = ::read(inotifyFd, buffer, sizeof(buffer))) > 0)
+            {
+                handleEvents(buffer, (size_t) bytesRead);
+            }
+
+            // a move whose other half never came went out of the watched folders
+            for (const auto& move : movedFrom)
+            {
+                if (move.second.second)
+                {
+                    folderRemoved(move.second.first);
+                }
+                else if (isAudioFile(move.second.first))
+                {
+                    fileRemoved(move.second.first);
+                }
+            }
+            movedFrom.clear();
+        }
+#else
+        juce::ignoreUnused(foldersToRemove);
+
+        for (const auto& request : foldersToAdd)
+        {
+            if (!request.second)
+            {
+                continue;
+            }
+            for (const juce::DirectoryEntry& entry : juce::RangedDirectoryIterator(request.first, true, "*", juce::File::findFiles))
+            {
+                if (threadShouldExit())
+                {
+                    return;
+                }
+                if (isAudioFile(entry.getFile().getFullPathName()))
+                {
+                    fileAdded(entry.getFile().getFullPathName());
+                }
+            }
+        }
+        wait(-1);
+#endif
+    }
+}
+
+#if JUCE_LINUX
+void FolderWatcher::watchRecursively(const juce::File& folder, bool reportFiles)
+{
+    const juce::uint32 mask{ IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR };
+
+    if (inotifyFd >= 0)
+    {
+        int wd{ inotify_add_watch(inotifyFd, folder.getFullPathName().toRawUTF8(), mask) };
+        if (wd < 0)
+        {
+            if (errno == ENOSPC)
+            {
+                std::cerr << "FolderWatcher: out of inotify watches at " << folder.getFullPathName()
+                          << ", raise fs.inotify.max_user_watches" << std::endl;
+            }
+            else
+            {
+                std::cerr << "FolderWatcher: can't watch " << folder.getFullPathName() << std::endl;
+            }
+        }
+        else
+        {
+            watches[wd] = folder.getFullPathName();
+        }
+    }
+
+    // watching before listing means a file created meanwhile is seen at least once
+    for (const juce::DirectoryEntry& entry : juce::RangedDirectoryIterator(folder, false, "*", juce::File::findFilesAndDirectories))
+    {
+        if (threadShouldExit())
+        {
+            return;
+        }
+
+        juce::File file{ entry.getFile() };
+        if (entry.isDirectory())
+        {
+            if (!file.isSymbolicLink())
+            {
+                watchRecursively(file, reportFiles);
+            }
+        }
+        else if (reportFiles && isAudioFile(file.getFullPathName()))
+        {
+            fileAdded(file.getFullPathName());
+        }
+    }
+}
+
+void FolderWatcher::handleEvents(const char* buffer, size_t size)
+{
+    size_t position{ 0 };
+
+    while (position + sizeof(inotify_event) <= size)
+    {
+        const inotify_event* event{ reinterpret_cast<const inotify_event*>(buffer + position) };
+        position += sizeof(inotify_event) + event->len;
+
+        // the kernel dropped events, only a rescan can catch up
+        if ((event->mask & IN_Q_OVERFLOW) != 0)
+        {
+            std::cerr << "FolderWatcher: inotify queue overflowed, rescanning" << std::endl;
+            for (const juce::String& root : roots)
+            {
+                watchRecursively(juce::File{ root }, true);
+            }
+            continue;
+        }
+
+        auto watch = watches.find(event->wd);
+        if (watch == watches.end())
+        {
+            continue;
+        }
+
+        if ((event->mask & IN_IGNORED) != 0)
+        {
+            watches.erase(watch);
+            continue;
+        }
+
+        if (event->len == 0)
+        {
+            continue;
+        }
+
+        juce::String path{ watch->second + "/" + juce::String::fromUTF8(event->name) };
+        bool isFolder{ (event->mask & IN_ISDIR) != 0 };
+
+        if ((event->mask & IN_MOVED_FROM) != 0)
+        {
+            movedFrom[event->cookie] = { path, isFolder };
+        }
+        else if ((event->mask & IN_MOVED_TO) != 0)
+        {
+            auto from = movedFrom.find(event->cookie);
+            if (from == movedFrom.end())
+            {
+                // moved in from outside the watched folders
+                if (isFolder)
+                {
+                    watchRecursively(juce::File{ path }, true);
+                }
+                else if (isAudioFile(path))
+                {
+                    fileAdded(path);
+                }
+                continue;
+            }
+
+            juce::String fromPath{ from->second.first };
+            movedFrom.erase(from);
+
+            if (isFolder)
+            {
+                renameWatches(fromPath, path);
+                pathMoved(fromPath, path);
+            }
+            else if (isAudioFile(fromPath) && isAudioFile(path))
+            {
+                pathMoved(fromPath, path);
+            }
+            else if (isAudioFile(path))
+            {
+                fileAdded(path);
+            }
+            else if (isAudioFile(fromPath))
+            {
+                fileRemoved(fromPath);
+            }
+        }
+        else if ((event->mask & IN_CREATE) != 0 && isFolder)
+        {
+            watchRecursively(juce::File{ path }, true);
+        }
+        else if ((event->mask & IN_CLOSE_WRITE) != 0 && isAudioFile(path))
+        {
+            // only once the writer closed it, so half copied files are never read
+            fileAdded(path);
+        }
+        else if ((event->mask & IN_DELETE) != 0)
+        {
+            if (isFolder)
+            {
+                folderRemoved(path);
+            }
+            else if (isAudioFile(path))
+            {
+                fileRemoved(path);
+            }
+        }
+    }
+}
+
+void FolderWatcher::renameWatches(const juce::String& from, const juce::String& to)
+{
+    for (auto& watch : watches)
+    {
+        if (watch.second == from || watch.second.startsWith(from + "/"))
+        {
+            watch.second = to + watch.second.substring(from.length());
+        }
+    }
+}
+#endif
+
+void FolderWatcher::timerCallback()
+{
+    FolderChanges changes;
+    {
+        const juce::ScopedLock lock(pendingLock);
+
+        size_t pending{ pendingAdded.size() + pendingSteps.size() };
+        bool quiet{ juce::Time::getMillisecondCounter() - lastEventTime > quietPeriodMs };
+
+        if (pending == 0 || (!quiet && pending < maxPendingChanges))
+        {
+            return;
+        }
+
+        for (const juce::String& path : pendingAdded)
+        {
+            changes.added.add(juce::File{ path });
+        }
+        changes.steps.swap(pendingSteps);
+
+        pendingAdded.clear();
+    }
+
+    if (onChanges)
+    {
+        onChanges(changes);
+    }
+}
+
+bool FolderWatcher::isAudioFile(const juce::String& path)
+{
+    juce::String extension{ path.fromLastOccurrenceOf(".", true, false).toLowerCase() };
+    return extension.isNotEmpty() && extensions.contains(extension);
+}
+
+void FolderWatcher::fileAdded(const juce::String& path)
+{
+    const juce::ScopedLock lock(pendingLock);
+
+    // a file deleted and written again is refreshed in place, so it keeps its id
+    pendingSteps.erase(std::remove_if(pendingSteps.begin(), pendingSteps.end(), [&path](const FolderChange& step)
+    {
+        return step.type == FolderChange::removedFile && step.file.getFullPathName() == path;
+    }), pendingSteps.end());
+
+    pendingAdded.insert(path);
+    lastEventTime = juce::Time::getMillisecondCounter();
+}
+
+void FolderWatcher::fileRemoved(const juce::String& path)
+{
+    const juce::ScopedLock lock(pendingLock);
+    pendingAdded.erase(path);
+    pendingSteps.push_back({ FolderChange::removedFile, juce::File{ path }, {} });
+    lastEventTime = juce::Time::getMillisecondCounter();
+}
+
+void FolderWatcher::folderRemoved(const juce::String& path)
+{
+    const juce::ScopedLock lock(pendingLock);
+    juce::String prefix{ path + juce::File::getSeparatorString() };
+    for (auto it = pendingAdded.begin(); it != pendingAdded.end();)
+    {
+        it = it->startsWith(prefix) ? pendingAdded.erase(it) : std::next(it);
+    }
+    pendingSteps.push_back({ FolderChange::removedFolder, juce::File{ path }, {} });
+    lastEventTime = juce::Time::getMillisecondCounter();
+}
+
+void FolderWatcher::pathMoved(const juce::String& from, const juce::String& to)
+{
+    const juce::ScopedLock lock(pendingLock);
+
+    // files that were never handed over just change their name
+    std::set<juce::String> renamed;
+    juce::String prefix{ from + juce::File::getSeparatorString() };
+    for (auto it = pendingAdded.begin(); it != pendingAdded.end();)
+    {
+        if (*it == from || it->startsWith(prefix))
+        {
+            renamed.insert(to + it->substring(from.length()));
+            it = pendingAdded.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    pendingAdded.insert(renamed.begin(), renamed.end());
+
+    pendingSteps.push_back({ FolderChange::moved, juce::File{ from }, juce::File{ to } });
+    lastEventTime = juce::Time::getMillisecondCounter();
+}
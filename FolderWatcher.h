@@ -0,0 +1,124 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+#include "ThreadConfig.h"
+
+// a removal or move in the watched folders
+struct FolderChange
+{
+    enum Type
+    {
+        removedFile,      // deleted file, or moved out of the watched folders
+        removedFolder,    // deleted folder, with everything in it
+        moved             // renamed file or folder
+    };
+
+    Type type;
+    juce::File file;
+    juce::File to;        // new name of a moved file or folder
+};
+
+// changes found in the watched folders since the last batch. Removals and moves are kept in
+// the order they happened, as a file moved to a name that is deleted afterwards has to end up
+// removed. Added files are imported under their final names once the steps are applied
+struct FolderChanges
+{
+    std::vector<FolderChange> steps;                         // removals and moves, oldest first
+    juce::Array<juce::File> added;                           // new or rewritten files
+};
+
+// FolderWatcher scans watched folders recursively when they are added and then follows
+// them with inotify on a background thread. Events are coalesced and handed to the
+// message thread in one batch once the folders have been quiet for a moment, so copying
+// thousands of files produces a few batches instead of thousands of callbacks.
+// Only files with one of the given extensions are reported.
+class FolderWatcher : private juce::Thread,
+    private juce::Timer
+{
+public:
+
+    FolderWatcher(const juce::StringArray& audioExtensions, ThreadConfig& threadConfig);
+
+    ~FolderWatcher() override;
+
+    // purpose : start watching a folder and everything below it
+    // input : folder, and whether its files should be reported as added
+    // output : void
+    void addFolder(const juce::File& folder, bool scanExistingFiles);
+
+    // purpose : stop watching a folder
+    // input : folder
+    // output : void
+    void removeFolder(const juce::File& folder);
+
+    // called on the message thread with the next batch of changes
+    std::function<void(FolderChanges& changes)> onChanges;
+
+private:
+
+    juce::StringArray extensions;
+    ThreadConfig& threadConfig;
+
+    // folders waiting to be added by the watcher thread, with their scan flag
+    juce::CriticalSection requestLock;
+    std::vector<std::pair<juce::File, bool>> addRequests;
+    std::vector<juce::File> removeRequests;
+
+    // changes collected since the last batch
+    juce::CriticalSection pendingLock;
+    std::set<juce::String> pendingAdded;
+    std::vector<FolderChange> pendingSteps;
+    juce::uint32 lastEventTime{ 0 };
+
+#if JUCE_LINUX
+    int inotifyFd{ -1 };
+    int wakeFd{ -1 };
+
+    // watch descriptor to folder, the watched roots and the halves of moves waiting for
+    // their other half, only used by the watcher thread
+    std::map<int, juce::String> watches;
+    std::set<juce::String> roots;
+    std::map<juce::uint32, std::pair<juce::String, bool>> movedFrom;
+
+    // purpose : watch a folder and its sub folders
+    // input : folder, and whether its files should be reported as added
+    // output : void
+    void watchRecursively(const juce::File& folder, bool reportFiles);
+
+    // purpose : handle the events read from inotify
+    // input : buffer of events
+    // output : void
+    void handleEvents(const char* buffer, size_t size);
+
+    // purpose : rename the watched folders below a moved folder
+    // input : old and new path
+    // output : void
+    void renameWatches(const juce::String& from, const juce::String& to);
+#endif
+
+    void run() override;
+
+    // purpose : hand the collected changes to the message thread once it is quiet
+    // input : none
+    // output : void
+    void timerCallback() override;
+
+    // purpose : check if a file is an audio file that should be reported
+    // input : path
+    // output : true if the extension is known
+    bool isAudioFile(const juce::String& path);
+
+    // purpose : record changes, cancelling out the ones that undo each other
+    // input : paths
+    // output : void
+    void fileAdded(const juce::String& path);
+    void fileRemoved(const juce::String& path);
+    void folderRemoved(const juce::String& path);
+    void pathMoved(const juce::String& from, const juce::String& to);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FolderWatcher)
+};
@@ -0,0 +1,193 @@
+#include "FrameProfiler.h"
+#include <algorithm>
+
+#if JUCE_LINUX || JUCE_MAC
+ #include <time.h>
+#endif
+
+// values kept per series for the percentiles, some seconds of frames
+static constexpr size_t seriesLength = 600;
+
+FrameProfiler::ScopedPaint::ScopedPaint(const char* _name, double _budget)
+    : name(_name), budget(_budget)
+{
+    if (FrameProfiler::getInstance().isEnabled())
+    {
+        start = juce::Time::getHighResolutionTicks();
+    }
+}
+
+FrameProfiler::ScopedPaint::~ScopedPaint()
+{
+    if (start != 0)
+    {
+        double milliseconds{ juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start) * 1000.0 };
+        FrameProfiler::getInstance().addPaint(name, milliseconds, budget);
+    }
+}
+
+void FrameProfiler::Series::add(double value)
+{
+    if (values.size() < seriesLength)
+    {
+        values.push_back(value);
+    }
+    else
+    {
+        values[next] = value;
+    }
+    next = (next + 1) % seriesLength;
+    ++count;
+}
+
+FrameProfiler::FrameProfiler()
+{
+}
+
+FrameProfiler::~FrameProfiler()
+{
+}
+
+FrameProfiler& FrameProfiler::getInstance()
+{
+    static FrameProfiler instance;
+    return instance;
+}
+
+void FrameProfiler::setEnabled(bool shouldMeasure)
+{
+    JUCE_ASSERT_MESSAGE_THREAD;
+    enabled = shouldMeasure;
+    paints.clear();
+    frameTimes = {};
+    framePaintTimes = {};
+    framePaintShare = {};
+    frameBusy = {};
+    queueDelays = {};
+    paintInFrame = 0.0;
+    frameStart = 0.0;
+    frameStartCpu = 0.0;
+    lastReport = juce::Time::getMillisecondCounterHiRes();
+}
+
+bool FrameProfiler::isEnabled() const
+{
+    return enabled;
+}
+
+void FrameProfiler::addPaint(const char* name, double milliseconds, double budget)
+{
+    if (!enabled)
+    {
+        return;
+    }
+    Series& series{ paints[name] };
+    series.add(milliseconds);
+    series.budget = budget;
+    if (budget > 0.0 && milliseconds > budget)
+    {
+        ++series.overBudget;
+    }
+    paintInFrame += milliseconds;
+}
+
+void FrameProfiler::startFrame()
+{
+    if (!enabled)
+    {
+        return;
+    }
+
+    double now{ juce::Time::getMillisecondCounterHiRes() };
+    double nowCpu{ getThreadCpuMs() };
+    if (frameStart > 0.0)
+    {
+        double frameTime{ now - frameStart };
+        frameTimes.add(frameTime);
+        framePaintTimes.add(paintInFrame);
+        framePaintShare.add(frameTime > 0.0 ? juce::jmin(100.0, paintInFrame / frameTime * 100.0) : 0.0);
+
+        // everything the message thread ran since the last frame, this runs on it too
+        if (nowCpu >= 0.0 && frameStartCpu >= 0.0 && frameTime > 0.0)
+        {
+            frameBusy.add(juce::jmin(100.0, (nowCpu - frameStartCpu) / frameTime * 100.0));
+        }
+    }
+    frameStart = now;
+    frameStartCpu = nowCpu;
+    paintInFrame = 0.0;
+
+    // a message posted now runs once the ones queued before it are done, its wait is what
+    // any other work posted to the message thread waits
+    juce::MessageManager::callAsync([now]
+    {
+        FrameProfiler& profiler{ FrameProfiler::getInstance() };
+        if (profiler.enabled)
+        {
+            profiler.queueDelays.add(juce::Time::getMillisecondCounterHiRes() - now);
+        }
+    });
+}
+
+juce::StringArray FrameProfiler::createReport()
+{
+    double now{ juce::Time::getMillisecondCounterHiRes() };
+    double seconds{ (now - lastReport) / 1000.0 };
+    lastReport = now;
+
+    juce::StringArray lines;
+    lines.add(describe("frame", frameTimes, "ms", seconds));
+    lines.add(describe("painting", framePaintTimes, "ms", 0.0));
+    lines.add(describe("paint share", framePaintShare, "%", 0.0));
+    lines.add(describe("message thread busy", frameBusy, "%", 0.0));
+    lines.add(describe("queue delay", queueDelays, "ms", 0.0));
+    for (auto& paint : paints)
+    {
+        lines.add(describe(paint.first, paint.second, "ms", seconds));
+    }
+    return lines;
+}
+
+double FrameProfiler::getThreadCpuMs()
+{
+#if JUCE_LINUX || JUCE_MAC
+    timespec time;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) == 0)
+    {
+        return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+    }
+#endif
+    return -1.0;
+}
+
+juce::String FrameProfiler::describe(const juce::String& name, Series& series, const juce::String& unit, double seconds)
+{
+    juce::String line{ name + ":" };
+    if (series.values.empty())
+    {
+        return line + " -";
+    }
+
+    std::vector<double> sorted{ series.values };
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&sorted](double fraction)
+    {
+        return sorted[juce::jmin(sorted.size() - 1, (size_t) (fraction * (double) sorted.size()))];
+    };
+
+    line << " p50 " << juce::String(percentile(0.5), 2)
+         << " p95 " << juce::String(percentile(0.95), 2)
+         << " p99 " << juce::String(percentile(0.99), 2)
+         << " max " << juce::String(sorted.back(), 2) << " " << unit;
+    if (seconds > 0.0)
+    {
+        line << ", " << juce::String(series.count / seconds, 1) << "/s";
+    }
+    if (series.budget > 0.0)
+    {
+        line << ", " << series.overBudget << " of " << series.count << " over " << juce::String(series.budget, 1) << " ms";
+    }
+    series.count = 0;
+    series.overBudget = 0;
+    return line;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <map>
+#include <vector>
+
+// FrameProfiler measures how much of the message thread goes into painting, to see when the
+// GUI starts to hold up the work queued behind it.
+// Components time their paint with a ScopedPaint, the frame overlay marks every display
+// frame. For each frame the profiler keeps the time between frames, the paint time in it and
+// the share of the frame that was painting, the share the message thread was busy with
+// anything (paints, timers, async callbacks, library work), and how long a message posted at
+// the start of the frame waited to run. The busy share is the CPU time of the message thread,
+// so time it spends blocked on a file is not in it, the queue delay shows that.
+// A paint can be given a budget in milliseconds, the report then counts the paints over it.
+// Percentiles are taken over the last samples of each series.
+// Everything runs on the message thread, and nothing is measured while it is disabled.
+class FrameProfiler
+{
+public:
+
+    // times a paint, from construction to destruction
+    class ScopedPaint
+    {
+    public:
+        // the name has to outlive the profiler, a string literal, and the budget is in
+        // milliseconds, 0 for none
+        explicit ScopedPaint(const char* name, double budget = 0.0);
+
+        ~ScopedPaint();
+
+    private:
+        const char* name;
+        double budget;
+        juce::int64 start{ 0 };
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedPaint)
+    };
+
+    FrameProfiler();
+
+    ~FrameProfiler();
+
+    // purpose : get the profiler of the app
+    // input : none
+    // output : profiler
+    static FrameProfiler& getInstance();
+
+    // purpose : start or stop measuring, stopping clears what was measured
+    // input : true to measure
+    // output : void
+    void setEnabled(bool shouldMeasure);
+
+    // purpose : check if measuring
+    // input : none
+    // output : true if measuring
+    bool isEnabled() const;
+
+    // purpose : add the time of a paint
+    // input : name of the component, milliseconds, budget of the paint in milliseconds, 0 for
+    //         none
+    // output : void
+    void addPaint(const char* name, double milliseconds, double budget = 0.0);
+
+    // purpose : mark the start of a display frame
+    // input : none
+    // output : void
+    void startFrame();
+
+    // purpose : summarise what was measured since the last report
+    // input : none
+    // output : one line per series
+    juce::StringArray createReport();
+
+private:
+
+    // the last values of a measurement
+    struct Series
+    {
+        std::vector<double> values;
+        size_t next{ 0 };
+
+        // values added since the last report, and those over the budget
+        int count{ 0 };
+        int overBudget{ 0 };
+        double budget{ 0.0 };
+
+        void add(double value);
+    };
+
+    bool enabled{ false };
+
+    std::map<const char*, Series> paints;
+    Series frameTimes;
+    Series framePaintTimes;
+    Series framePaintShare;
+    Series frameBusy;
+    Series queueDelays;
+
+    double paintInFrame{ 0.0 };
+    double frameStart{ 0.0 };
+    double frameStartCpu{ 0.0 };
+    double lastReport{ 0.0 };
+
+    // purpose : get the CPU time used by the calling thread
+    // input : none
+    // output : milliseconds, negative where the platform can't tell
+    static double getThreadCpuMs();
+
+    // purpose : describe a series with its percentiles
+    // input : name, series, unit, seconds since the last report to give a rate, 0 for none
+    // output : line
+    static juce::String describe(const juce::String& name, Series& series, const juce::String& unit, double seconds);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FrameProfiler)
+};
@@ -0,0 +1,69 @@
+#include "FrameProfilerOverlay.h"
+
+// report period, and the reports between two logs
+static constexpr int reportInterval = 500;
+static constexpr int reportsPerLog = 20;
+
+// height of a line of the report
+static constexpr int lineHeight = 14;
+
+FrameProfilerOverlay::FrameProfilerOverlay()
+{
+    setInterceptsMouseClicks(false, false);
+    setVisible(false);
+}
+
+FrameProfilerOverlay::~FrameProfilerOverlay()
+{
+    setProfiling(false);
+}
+
+void FrameProfilerOverlay::setProfiling(bool shouldProfile)
+{
+    FrameProfiler::getInstance().setEnabled(shouldProfile);
+    setVisible(shouldProfile);
+    report.clear();
+    reportsSinceLog = 0;
+
+    if (shouldProfile)
+    {
+        vBlankAttachment = std::make_unique<juce::VBlankAttachment>(this, [] { FrameProfiler::getInstance().startFrame(); });
+        startTimer(reportInterval);
+    }
+    else
+    {
+        vBlankAttachment.reset();
+        stopTimer();
+    }
+}
+
+void FrameProfilerOverlay::paint(juce::Graphics& g)
+{
+    // the overlay is left out of the paint times, it is the one painting them
+    int height{ juce::jmin(getHeight(), (report.size() + 1) * lineHeight) };
+    g.setColour(juce::Colours::black.withAlpha(0.7f));
+    g.fillRect(0, 0, getWidth(), height);
+
+    g.setColour(juce::Colours::white);
+    g.setFont(juce::Font(juce::Font::getDefaultMonospacedFontName(), 11.0f, juce::Font::plain));
+    for (int i = 0; i < report.size(); ++i)
+    {
+        g.drawText(report[i], 6, lineHeight / 2 + i * lineHeight, getWidth() - 12, lineHeight, juce::Justification::centredLeft, true);
+    }
+}
+
+void FrameProfilerOverlay::timerCallback()
+{
+    report = FrameProfiler::getInstance().createReport();
+    repaint();
+
+    if (++reportsSinceLog >= reportsPerLog)
+    {
+        reportsSinceLog = 0;
+        std::cout << "FrameProfiler:" << std::endl;
+        for (const juce::String& line : report)
+        {
+            std::cout << "  " << line << std::endl;
+        }
+    }
+}
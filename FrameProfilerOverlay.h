@@ -0,0 +1,41 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "FrameProfiler.h"
+
+// FrameProfilerOverlay drives the frame profiler from the display refresh and shows its
+// report over the app, twice a second, and logs it every ten seconds. It doesn't take mouse
+// clicks, so the app under it works as usual.
+class FrameProfilerOverlay : public juce::Component,
+                             private juce::Timer
+{
+public:
+
+    FrameProfilerOverlay();
+
+    ~FrameProfilerOverlay() override;
+
+    // purpose : start or stop profiling, the overlay is only shown while it runs
+    // input : true to profile
+    // output : void
+    void setProfiling(bool shouldProfile);
+
+    void paint(juce::Graphics& g) override;
+
+private:
+
+    juce::StringArray report;
+
+    // reports since the last one logged
+    int reportsSinceLog{ 0 };
+
+    // marks the frames of the profiler, only while profiling
+    std::unique_ptr<juce::VBlankAttachment> vBlankAttachment;
+
+    // purpose : take a new report, show it and log it every now and then
+    // input : none
+    // output : void
+    void timerCallback() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FrameProfilerOverlay)
+};
@@ -1,5 +1,6 @@
 #include <JuceHeader.h>
 #include "GraphController.h"
+#include "FrameProfiler.h"
 #include <iomanip>
 #include <sstream>
 
@@ -33,6 +34,7 @@ void GraphController::paint(juce::Graphics& g)
     // - Plot: drawn in grey
     // - Marker: drawn in orange (and associated text if moved)
     // - Raw range: captured for resizing reference
+    FrameProfiler::ScopedPaint profile{ "GraphController" };
 
     g.fillAll(getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId));
 
@@ -0,0 +1,160 @@
+#include "KeyAnalyzer.h"
+#include <cmath>
+
+// frame size, and the hop between frames
+static constexpr int fftOrder = 12;
+static constexpr int fftSize = 1 << fftOrder;
+static constexpr int hopSize = fftSize / 2;
+
+// rate the samples are decimated toward, and the notes looked at
+static constexpr double targetRate = 11025.0;
+static constexpr double lowestNote = 36.0;
+static constexpr double highestNote = 96.0;
+
+// frames quieter than this, summed over the chroma, are left out
+static constexpr float silence = 1.0e-3f;
+
+// Krumhansl-Kessler key profiles, from the tonic up
+static constexpr double majorProfile[12] = { 6.35, 2.23, 3.48, 2.33, 4.38, 4.09, 2.52, 5.19, 2.39, 3.66, 2.29, 2.88 };
+static constexpr double minorProfile[12] = { 6.33, 2.68, 3.52, 5.38, 2.60, 3.53, 2.54, 4.75, 3.98, 2.69, 3.34, 3.17 };
+
+KeyAnalyzer::KeyAnalyzer(double sampleRate)
+    : decimation(juce::jmax(1, (int) (sampleRate / targetRate))),
+    analysisRate(sampleRate / decimation),
+    fft(fftOrder),
+    window((size_t) fftSize, juce::dsp::WindowingFunction<float>::hann, false)
+{
+    // the highest note is well below the decimated nyquist
+    double cutoff{ juce::jmin(2500.0, analysisRate * 0.45) };
+    lowPass1.setCoefficients(juce::IIRCoefficients::makeLowPass(sampleRate, cutoff));
+    lowPass2.setCoefficients(juce::IIRCoefficients::makeLowPass(sampleRate, cutoff));
+
+    fftData.resize((size_t) fftSize * 2);
+    pending.reserve((size_t) fftSize * 4);
+
+    binPitchClass.resize((size_t) fftSize / 2 + 1, -1);
+    for (int bin = 1; bin <= fftSize / 2; ++bin)
+    {
+        double frequency{ bin * analysisRate / fftSize };
+        double note{ 69.0 + 12.0 * std::log2(frequency / 440.0) };
+        if (note >= lowestNote - 0.5 && note < highestNote + 0.5)
+        {
+            binPitchClass[(size_t) bin] = (int) std::lround(note) % 12;
+        }
+    }
+}
+
+KeyAnalyzer::~KeyAnalyzer()
+{
+}
+
+void KeyAnalyzer::process(const float* samples, int numSamples)
+{
+    filtered.assign(samples, samples + numSamples);
+    lowPass1.processSamples(filtered.data(), numSamples);
+    lowPass2.processSamples(filtered.data(), numSamples);
+
+    for (int i = decimationPhase; i < numSamples; i += decimation)
+    {
+        pending.push_back(filtered[(size_t) i]);
+    }
+    decimationPhase = (decimationPhase + decimation - numSamples % decimation) % decimation;
+
+    size_t position{ 0 };
+    while (position + (size_t) fftSize <= pending.size())
+    {
+        processFrame(pending.data() + position);
+        position += (size_t) hopSize;
+    }
+    pending.erase(pending.begin(), pending.begin() + (std::ptrdiff_t) position);
+}
+
+void KeyAnalyzer::processFrame(const float* frame)
+{
+    juce::FloatVectorOperations::copy(fftData.data(), frame, fftSize);
+    juce::FloatVectorOperations::clear(fftData.data() + fftSize, fftSize);
+    window.multiplyWithWindowingTable(fftData.data(), (size_t) fftSize);
+    fft.performFrequencyOnlyForwardTransform(fftData.data());
+
+    std::array<float, 12> frameChroma{};
+    for (int bin = 1; bin <= fftSize / 2; ++bin)
+    {
+        int pitchClass{ binPitchClass[(size_t) bin] };
+        if (pitchClass >= 0)
+        {
+            frameChroma[(size_t) pitchClass] += fftData[(size_t) bin];
+        }
+    }
+
+    // every frame counts the same however loud it is
+    float sum{ 0.0f };
+    for (float value : frameChroma)
+    {
+        sum += value;
+    }
+    if (sum < silence)
+    {
+        return;
+    }
+    for (size_t pitchClass = 0; pitchClass < 12; ++pitchClass)
+    {
+        chroma[pitchClass] += frameChroma[pitchClass] / sum;
+    }
+    ++numFrames;
+}
+
+int KeyAnalyzer::getKey()
+{
+    // less than about ten seconds of sound says too little
+    if (numFrames < (int) (10.0 * analysisRate / hopSize))
+    {
+        return -1;
+    }
+
+    double chromaMean{ 0.0 };
+    for (double value : chroma)
+    {
+        chromaMean += value / 12.0;
+    }
+
+    int bestKey{ -1 };
+    double bestCorrelation{ 0.0 };
+
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        const double* profile{ mode == 0 ? majorProfile : minorProfile };
+        double profileMean{ 0.0 };
+        for (int i = 0; i < 12; ++i)
+        {
+            profileMean += profile[i] / 12.0;
+        }
+
+        for (int tonic = 0; tonic < 12; ++tonic)
+        {
+            double covariance{ 0.0 };
+            double chromaVariance{ 0.0 };
+            double profileVariance{ 0.0 };
+            for (int i = 0; i < 12; ++i)
+            {
+                double c{ chroma[(size_t) ((tonic + i) % 12)] - chromaMean };
+                double p{ profile[i] - profileMean };
+                covariance += c * p;
+                chromaVariance += c * c;
+                profileVariance += p * p;
+            }
+            if (chromaVariance <= 0.0)
+            {
+                return -1;
+            }
+
+            double correlation{ covariance / std::sqrt(chromaVariance * profileVariance) };
+            if (correlation > bestCorrelation)
+            {
+                bestCorrelation = correlation;
+                bestKey = mode * 12 + tonic;
+            }
+        }
+    }
+
+    return bestKey;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <vector>
+
+// KeyAnalyzer estimates the musical key of a track from its mono samples, fed block by block
+// while the track is decoded.
+// The samples are low passed and decimated to around 11 kHz, a chromagram is taken over the
+// notes from C2 to C7 with one frame every 2048 decimated samples, and the summed chroma is
+// correlated with the Krumhansl-Kessler profile of each of the 24 keys.
+class KeyAnalyzer
+{
+public:
+
+    KeyAnalyzer(double sampleRate);
+
+    ~KeyAnalyzer();
+
+    // purpose : add the next samples of the track
+    // input : mono samples
+    // output : void
+    void process(const float* samples, int numSamples);
+
+    // purpose : get the key of everything processed
+    // input : none
+    // output : 0 to 11 for the major keys from C, 12 to 23 for the minor keys, -1 if unclear
+    int getKey();
+
+private:
+
+    int decimation;
+    double analysisRate;
+
+    juce::IIRFilter lowPass1;
+    juce::IIRFilter lowPass2;
+    int decimationPhase{ 0 };
+
+    juce::dsp::FFT fft;
+    juce::dsp::WindowingFunction<float> window;
+
+    std::vector<float> filtered;
+    std::vector<float> pending;
+    std::vector<float> fftData;
+
+    // pitch class of every bin, -1 outside the notes looked at
+    std::vector<int> binPitchClass;
+
+    std::array<double, 12> chroma{};
+    int numFrames{ 0 };
+
+    // purpose : add the chroma of one frame
+    // input : first sample of the frame
+    // output : void
+    void processFrame(const float* frame);
+};
@@ -0,0 +1,98 @@
+#include "KeyIndex.h"
+#include <algorithm>
+
+KeyIndex::KeyIndex()
+{
+}
+
+KeyIndex::~KeyIndex()
+{
+}
+
+void KeyIndex::addSong(const Song& song)
+{
+    removeSong(song.id);
+
+    if (song.key >= 0 && song.key < 24)
+    {
+        tracksByKey[(size_t) song.key].insert(song.id);
+        keyOfTrack[song.id] = song.key;
+    }
+}
+
+void KeyIndex::removeSong(TrackId id)
+{
+    auto it = keyOfTrack.find(id);
+    if (it != keyOfTrack.end())
+    {
+        tracksByKey[(size_t) it->second].erase(id);
+        keyOfTrack.erase(it);
+    }
+}
+
+void KeyIndex::clear()
+{
+    for (auto& tracks : tracksByKey)
+    {
+        tracks.clear();
+    }
+    keyOfTrack.clear();
+}
+
+std::vector<TrackId> KeyIndex::getCompatibleTracks(int key)
+{
+    std::vector<TrackId> ids;
+    for (int compatibleKey : getCompatibleKeys(key))
+    {
+        const auto& tracks{ tracksByKey[(size_t) compatibleKey] };
+        ids.insert(ids.end(), tracks.begin(), tracks.end());
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+std::vector<int> KeyIndex::getCompatibleKeys(int key)
+{
+    if (key < 0 || key >= 24)
+    {
+        return {};
+    }
+
+    int tonic{ key % 12 };
+    bool minor{ key >= 12 };
+
+    // a fifth is 7 semitones, the relative minor is 3 below its major and the other way round
+    int relative{ minor ? (tonic + 3) % 12 : 12 + (tonic + 9) % 12 };
+    int fifthUp{ (minor ? 12 : 0) + (tonic + 7) % 12 };
+    int fifthDown{ (minor ? 12 : 0) + (tonic + 5) % 12 };
+    return { key, relative, fifthUp, fifthDown };
+}
+
+int KeyIndex::getCamelotNumber(int key)
+{
+    if (key < 0 || key >= 24)
+    {
+        return 0;
+    }
+
+    // C major is 8B and A minor 8A, each step round the wheel is a fifth up
+    int tonic{ key >= 12 ? (key % 12 + 3) % 12 : key };
+    return (7 * tonic + 7) % 12 + 1;
+}
+
+juce::String KeyIndex::getKeyName(int key, bool openKey)
+{
+    int camelot{ getCamelotNumber(key) };
+    if (camelot == 0)
+    {
+        return {};
+    }
+
+    bool minor{ key >= 12 };
+    if (openKey)
+    {
+        // Open Key starts at C major as 1d
+        return juce::String{ (camelot + 4) % 12 + 1 } + (minor ? "m" : "d");
+    }
+    return juce::String{ camelot } + (minor ? "A" : "B");
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "Song.h"
+
+// KeyIndex keeps the tracks of every musical key, so the tracks that mix in key with a
+// playing track are found by joining three sets instead of reading the whole library.
+// Keys are numbered as in Song, 0 to 11 major and 12 to 23 minor from C. On the Camelot
+// wheel a key mixes with its relative major or minor and with the keys a fifth up or down.
+class KeyIndex
+{
+public:
+
+    KeyIndex();
+
+    ~KeyIndex();
+
+    // purpose : add a track, or move it if its key changed, tracks without a key are left out
+    // input : track with a valid id
+    // output : void
+    void addSong(const Song& song);
+
+    // purpose : remove a track
+    // input : id of the track
+    // output : void
+    void removeSong(TrackId id);
+
+    // purpose : forget every track
+    // input : none
+    // output : void
+    void clear();
+
+    // purpose : get the tracks that mix in key with a key
+    // input : key
+    // output : ids of the tracks in ascending order, empty for an unknown key
+    std::vector<TrackId> getCompatibleTracks(int key);
+
+    // purpose : get the keys that mix with a key, the key itself first
+    // input : key
+    // output : keys, empty for an unknown key
+    static std::vector<int> getCompatibleKeys(int key);
+
+    // purpose : get the place of a key on the Camelot wheel
+    // input : key
+    // output : 1 to 12, 0 for an unknown key
+    static int getCamelotNumber(int key);
+
+    // purpose : get the name of a key for the table
+    // input : key, and whether to use the Open Key notation instead of Camelot
+    // output : name such as 8B or 1d, empty for an unknown key
+    static juce::String getKeyName(int key, bool openKey);
+
+private:
+
+    std::array<std::unordered_set<TrackId>, 24> tracksByKey;
+    std::unordered_map<TrackId, int> keyOfTrack;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(KeyIndex)
+};
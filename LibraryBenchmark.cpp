@@ -0,0 +1,573 @@
+#include "LibraryBenchmark.h"
+#include "AppSettings.h"
+#include "FingerprintIndex.h"
+#include "LibraryImporter.h"
+#include "LibraryStore.h"
+#include "LibraryView.h"
+#include "LoudnessAnalyzer.h"
+#include "SearchIndex.h"
+#include "ThreadConfig.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+static constexpr int minTracks = 10000;
+static constexpr int maxTracks = 2000000;
+
+// original files of the audio pool of the benchmark, every third one has a copy
+static constexpr int benchmarkPoolSize = 32;
+
+// the longest the background work of one measurement may take
+static constexpr double maxWaitMs = 600000.0;
+
+// purpose : get the text following an option on the command line
+// input : command line, option
+// output : text, empty if the option or its value is missing
+static juce::String getOptionArgument(const juce::String& commandLine, const juce::String& option)
+{
+    juce::StringArray arguments{ juce::StringArray::fromTokens(commandLine, true) };
+    int index{ arguments.indexOf(option) };
+    if (index >= 0 && index + 1 < arguments.size() && !arguments[index + 1].startsWith("--"))
+    {
+        return arguments[index + 1].unquoted();
+    }
+    return {};
+}
+
+// purpose : get the number of tracks following an option, within the supported range
+// input : command line, option, position of the number after the option
+// output : number of tracks
+static int getNumTracks(const juce::String& commandLine, const juce::String& option, int position, int defaultValue)
+{
+    juce::StringArray arguments{ juce::StringArray::fromTokens(commandLine, true) };
+    int optionIndex{ arguments.indexOf(option) };
+    int numTracks{ defaultValue };
+    if (optionIndex >= 0 && optionIndex + position < arguments.size() && arguments[optionIndex + position].containsOnly("0123456789"))
+    {
+        numTracks = arguments[optionIndex + position].getIntValue();
+    }
+
+    if (numTracks < minTracks || numTracks > maxTracks)
+    {
+        std::cout << "LibraryBenchmark: " << numTracks << " tracks is outside " << minTracks << " to " << maxTracks << std::endl;
+    }
+    return juce::jlimit(1, maxTracks, numTracks);
+}
+
+// purpose : time a piece of work
+// input : work
+// output : time taken in ms
+template <typename Function>
+static double timeMs(Function&& function)
+{
+    double start{ juce::Time::getMillisecondCounterHiRes() };
+    function();
+    return juce::Time::getMillisecondCounterHiRes() - start;
+}
+
+// purpose : describe the spread of a set of timings
+// input : name of the measurement, timings in ms
+// output : one report line
+static juce::String formatTimings(const juce::String& name, std::vector<double> timings)
+{
+    if (timings.empty())
+    {
+        return name + ": no samples" + juce::newLine;
+    }
+
+    std::sort(timings.begin(), timings.end());
+    double total{ 0.0 };
+    for (double timing : timings)
+    {
+        total += timing;
+    }
+
+    return name + ": n " + juce::String((int) timings.size())
+        + ", mean " + juce::String(total / (double) timings.size(), 3) + " ms"
+        + ", p50 " + juce::String(timings[timings.size() / 2], 3) + " ms"
+        + ", p99 " + juce::String(timings[juce::jmin(timings.size() - 1, timings.size() * 99 / 100)], 3) + " ms"
+        + ", max " + juce::String(timings.back(), 3) + " ms" + juce::newLine;
+}
+
+// purpose : let the timers of the components run while they work in the background. The
+//           benchmark runs before the message loop starts, so nothing else would call them
+// input : condition that holds while the work is going on
+// output : void
+template <typename Condition>
+static void runTimersWhile(Condition&& busy)
+{
+    double start{ juce::Time::getMillisecondCounterHiRes() };
+    while (busy() && juce::Time::getMillisecondCounterHiRes() - start < maxWaitMs)
+    {
+        juce::Thread::sleep(5);
+        juce::Timer::callPendingTimersSynchronously();
+    }
+}
+
+// purpose : describe the time taken to get through a number of files
+// input : name of the measurement, time in ms, number of files
+// output : one report line
+static juce::String formatFiles(const juce::String& name, double ms, int numFiles)
+{
+    return name + ": " + juce::String(numFiles) + " files in " + juce::String(ms, 1) + " ms ("
+        + juce::String(numFiles * 1000.0 / juce::jmax(ms, 0.001), 0) + " files per second)" + juce::newLine;
+}
+
+// purpose : describe one timing
+// input : name of the measurement, time in ms, number of items it covered
+// output : one report line
+static juce::String formatTiming(const juce::String& name, double ms, int numItems)
+{
+    juce::String line{ name + ": " + juce::String(ms, 1) + " ms" };
+    if (numItems > 0)
+    {
+        line << " (" << juce::String(ms * 1000.0 / numItems, 2) << " us per track)";
+    }
+    return line + juce::newLine;
+}
+
+// purpose : make up a word out of syllables
+// input : random generator, number of syllables
+// output : word
+static juce::String makeWord(juce::Random& random, int numSyllables)
+{
+    static const char* const syllables[] = { "ka", "lo", "mi", "ra", "ve", "shi", "dor", "an", "tu", "bel",
+                                             "ne", "xo", "qui", "sa", "mar", "el", "to", "vi", "gro", "lux" };
+    juce::String word;
+    for (int i = 0; i < numSyllables; ++i)
+    {
+        word += syllables[random.nextInt(juce::numElementsInArray(syllables))];
+    }
+    return word;
+}
+
+bool LibraryBenchmark::runFromCommandLine(const juce::String& commandLine)
+{
+    if (commandLine.contains("--generate-library"))
+    {
+        juce::String folder{ getOptionArgument(commandLine, "--generate-library") };
+        if (folder.isEmpty() || !juce::File::isAbsolutePath(folder))
+        {
+            std::cerr << "LibraryBenchmark: --generate-library needs an absolute folder" << std::endl;
+            return true;
+        }
+        generateLibrary(juce::File{ folder }, getNumTracks(commandLine, "--generate-library", 2, 100000));
+        return true;
+    }
+
+    if (commandLine.contains("--benchmark-library"))
+    {
+        juce::File scratch{ juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile("OtoDecks benchmark") };
+        juce::String report{ benchmarkLibrary(getNumTracks(commandLine, "--benchmark-library", 1, 100000), scratch) };
+        scratch.deleteRecursively();
+
+        std::cout << report;
+
+        juce::String reportFile{ getOptionArgument(commandLine, "--report") };
+        if (reportFile.isNotEmpty() && !juce::File::getCurrentWorkingDirectory().getChildFile(reportFile).replaceWithText(report))
+        {
+            std::cerr << "LibraryBenchmark: can't write " << reportFile << std::endl;
+        }
+        return true;
+    }
+
+    if (commandLine.contains("--benchmark-search"))
+    {
+        int numTracks{ getNumTracks(commandLine, "--benchmark-search", 1, 500000) };
+        std::cout << "search benchmark, " << numTracks << " synthetic tracks" << std::endl;
+        std::cout << benchmarkSearch(generateSongs(numTracks, 1234));
+        return true;
+    }
+    return false;
+}
+
+std::vector<Song> LibraryBenchmark::generateSongs(int numTracks, juce::int64 seed)
+{
+    juce::Random random{ seed };
+    juce::File root{ juce::File::getSpecialLocation(juce::File::userMusicDirectory).getChildFile("Synthetic") };
+
+    // a long tail of artists with a few albums each, like a real collection
+    int numArtists{ juce::jmax(1, numTracks / 25) };
+    std::vector<juce::String> artists;
+    for (int i = 0; i < numArtists; ++i)
+    {
+        artists.push_back(makeWord(random, 2 + random.nextInt(2)) + (random.nextInt(3) == 0 ? " " + makeWord(random, 2) : ""));
+    }
+
+    std::vector<Song> songs;
+    songs.reserve((size_t) numTracks);
+
+    for (int i = 0; i < numTracks; ++i)
+    {
+        const juce::String& artist{ artists[(size_t) random.nextInt(numArtists)] };
+        juce::String album{ makeWord(random, 2) + " " + makeWord(random, 1 + random.nextInt(2)) };
+
+        juce::String title;
+        int numWords{ 1 + random.nextInt(4) };
+        for (int word = 0; word < numWords; ++word)
+        {
+            title += (word > 0 ? " " : "") + makeWord(random, 1 + random.nextInt(3));
+        }
+
+        juce::String fileName{ juce::String(1 + random.nextInt(14)).paddedLeft('0', 2) + " " + title + ".mp3" };
+        Song song{ root.getChildFile(artist).getChildFile(album).getChildFile(fileName) };
+        song.id = (TrackId) (i + 1);
+        song.title = title;
+        song.artist = artist;
+        song.album = album;
+        song.lengthInSeconds = 120.0 + random.nextInt(360);
+        song.sampleRate = 44100.0;
+        song.numChannels = 2;
+        song.bitrate = 320;
+        song.fileSize = (juce::int64) (song.lengthInSeconds * 40000.0);
+        song.modificationTime = juce::Time::currentTimeMillis() - random.nextInt(1000000000);
+        songs.push_back(std::move(song));
+    }
+    return songs;
+}
+
+juce::Array<juce::File> LibraryBenchmark::generateAudioPool(const juce::File& folder, int numFiles)
+{
+    const double sampleRate{ 22050.0 };
+    const int numSamples{ (int) (20.0 * sampleRate) };
+
+    folder.createDirectory();
+    juce::Random random{ 42 };
+    juce::WavAudioFormat wav;
+    juce::Array<juce::File> files;
+
+    auto write = [&](const juce::File& file, const juce::AudioBuffer<float>& buffer)
+    {
+        file.deleteFile();
+        std::unique_ptr<juce::FileOutputStream> stream{ file.createOutputStream() };
+        if (stream == nullptr)
+        {
+            std::cerr << "LibraryBenchmark: can't write " << file.getFullPathName() << std::endl;
+            return;
+        }
+
+        std::unique_ptr<juce::AudioFormatWriter> writer{ wav.createWriterFor(stream.get(), sampleRate, 1, 16, {}, 0) };
+        if (writer == nullptr)
+        {
+            return;
+        }
+        stream.release();
+        writer->writeFromAudioSampleBuffer(buffer, 0, buffer.getNumSamples());
+        files.add(file);
+    };
+
+    for (int i = 0; i < numFiles; ++i)
+    {
+        // a few notes changing every half second over some noise, so every file is different
+        juce::AudioBuffer<float> buffer{ 1, numSamples };
+        float* samples{ buffer.getWritePointer(0) };
+        double frequencies[3] = {};
+        for (int sample = 0; sample < numSamples; ++sample)
+        {
+            if (sample % (int) (sampleRate / 2) == 0)
+            {
+                for (double& frequency : frequencies)
+                {
+                    frequency = 200.0 + random.nextDouble() * 1800.0;
+                }
+            }
+
+            double time{ sample / sampleRate };
+            double value{ 0.0 };
+            for (double frequency : frequencies)
+            {
+                value += std::sin(juce::MathConstants<double>::twoPi * frequency * time);
+            }
+            samples[sample] = (float) (0.2 * value + 0.05 * (random.nextDouble() * 2.0 - 1.0));
+        }
+
+        write(folder.getChildFile("pool " + juce::String(i + 1).paddedLeft('0', 2) + ".wav"), buffer);
+
+        if (i % 3 == 0)
+        {
+            buffer.applyGain(0.5f);
+            write(folder.getChildFile("pool " + juce::String(i + 1).paddedLeft('0', 2) + " copy.wav"), buffer);
+        }
+    }
+    return files;
+}
+
+void LibraryBenchmark::generateLibrary(const juce::File& folder, int numTracks)
+{
+    if (!folder.createDirectory())
+    {
+        std::cerr << "LibraryBenchmark: can't create " << folder.getFullPathName() << std::endl;
+        return;
+    }
+
+    std::vector<Song> songs{ generateSongs(numTracks, 1234) };
+
+    LibraryStore store;
+    store.open(folder, {});
+    for (Song& song : songs)
+    {
+        store.addSong(song);
+    }
+    store.close();
+
+    juce::Array<juce::File> pool{ generateAudioPool(folder.getChildFile("audio"), 8) };
+    std::cout << "LibraryBenchmark: wrote " << numTracks << " tracks and " << pool.size() << " audio files to "
+              << folder.getFullPathName() << std::endl;
+}
+
+juce::String LibraryBenchmark::benchmarkSearch(const std::vector<Song>& songs)
+{
+    juce::String report;
+    int numTracks{ (int) songs.size() };
+
+    SearchIndex index;
+    report << formatTiming("search index build", timeMs([&]
+    {
+        for (const Song& song : songs)
+        {
+            index.addSong(song);
+        }
+    }), numTracks);
+
+    // typing a title, an artist and two words, one keystroke at a time
+    juce::Random random{ 99 };
+    std::vector<double> shortQueries;
+    std::vector<double> longQueries;
+    size_t totalResults{ 0 };
+
+    for (int i = 0; i < 200; ++i)
+    {
+        const Song& song{ songs[(size_t) random.nextInt(numTracks)] };
+        juce::String target;
+        switch (i % 3)
+        {
+            case 0: target = song.title; break;
+            case 1: target = song.artist; break;
+            default: target = song.artist.upToFirstOccurrenceOf(" ", false, false) + " " + song.title.upToFirstOccurrenceOf(" ", false, false); break;
+        }
+
+        for (int length = 1; length <= target.length(); ++length)
+        {
+            std::vector<TrackId> results;
+            double elapsed{ timeMs([&] { results = index.search(target.substring(0, length)); }) };
+
+            (length < 3 ? shortQueries : longQueries).push_back(elapsed);
+            totalResults += results.size();
+        }
+    }
+
+    report << formatTimings("search, 1-2 characters", shortQueries);
+    report << formatTimings("search, 3+ characters", longQueries);
+    report << "search results per query: " << (int) (totalResults / juce::jmax((size_t) 1, shortQueries.size() + longQueries.size())) << juce::newLine;
+
+    // incremental updates while the index is in use
+    std::vector<double> updates;
+    for (int i = 0; i < 1000; ++i)
+    {
+        Song song{ songs[(size_t) random.nextInt(numTracks)] };
+        song.title = makeWord(random, 3);
+        updates.push_back(timeMs([&] { index.addSong(song); }));
+    }
+    report << formatTimings("search index update", updates);
+    return report;
+}
+
+juce::String LibraryBenchmark::benchmarkLibrary(int numTracks, const juce::File& folder)
+{
+    juce::String report;
+    report << "library benchmark, " << numTracks << " synthetic tracks, " << juce::SystemStats::getCpuModel()
+           << ", " << juce::SystemStats::getNumCpus() << " cpus" << juce::newLine;
+
+    folder.deleteRecursively();
+    folder.createDirectory();
+
+    std::vector<Song> songs;
+    report << formatTiming("generate", timeMs([&] { songs = generateSongs(numTracks, 1234); }), numTracks);
+    juce::Array<juce::File> pool{ generateAudioPool(folder.getChildFile("audio"), benchmarkPoolSize) };
+
+    // save: every add is journaled as it happens, compaction writes the snapshot
+    {
+        LibraryStore store;
+        store.open(folder, {});
+        report << formatTiming("save, journaled adds", timeMs([&]
+        {
+            for (Song& song : songs)
+            {
+                store.addSong(song);
+            }
+        }), numTracks);
+        report << formatTiming("save, compaction", timeMs([&] { store.compact(); }), numTracks);
+    }
+    report << "library file: " << folder.getChildFile("library.otodb").getSize() / 1024 << " KiB" << juce::newLine;
+
+    // open: what loadPreviousLibrary does at startup
+    LibraryStore store;
+    report << formatTiming("open", timeMs([&] { store.open(folder, {}); }), numTracks);
+    report << formatTiming("decode every track", timeMs([&]
+    {
+        for (TrackId id : store.getTrackIds())
+        {
+            store.getSong(id);
+        }
+    }), numTracks);
+
+    // the components the library uses, with their settings and caches in the scratch folder
+    {
+        AppSettings settings{ folder.getChildFile("benchmark.settings") };
+        ThreadConfig threadConfig{ settings };
+        juce::AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+
+        // import: the loader pool reading every file, then again from the metadata cache
+        LibraryImporter importer{ formatManager, threadConfig, folder.getChildFile("metadata.cache") };
+        std::map<juce::String, double> lengths;
+        int imported{ 0 };
+        importer.onBatchReady = [&](std::vector<ImportResult>& batch)
+        {
+            for (const ImportResult& result : batch)
+            {
+                lengths[result.file.getFullPathName()] = result.metadata.lengthInSeconds;
+            }
+            imported += (int) batch.size();
+        };
+
+        for (const char* pass : { "import", "import from the cache" })
+        {
+            imported = 0;
+            double ms{ timeMs([&]
+            {
+                importer.importFiles(pool);
+                runTimersWhile([&] { return importer.isImporting(); });
+            }) };
+            report << formatFiles(pass, ms, imported);
+        }
+
+        // dedupe by content: fingerprint the pool in the background and look every file up in
+        // the index, the copies follow their originals so they are the ones reported
+        FingerprintIndex fingerprintIndex{ formatManager, threadConfig, folder.getChildFile("fingerprints.index") };
+        std::vector<std::pair<TrackId, TrackId>> matches;
+        fingerprintIndex.onDuplicateFound = [&matches](TrackId id, TrackId original) { matches.push_back({ id, original }); };
+
+        double dedupeMs{ timeMs([&]
+        {
+            for (int i = 0; i < pool.size(); ++i)
+            {
+                fingerprintIndex.queue((TrackId) (i + 1), pool[i], lengths[pool[i].getFullPathName()], true);
+            }
+            runTimersWhile([&] { return fingerprintIndex.isFingerprinting(); });
+        }) };
+        report << formatFiles("dedupe, fingerprint and match", dedupeMs, pool.size());
+
+        int copies{ 0 };
+        for (const juce::File& file : pool)
+        {
+            copies += file.getFileNameWithoutExtension().endsWith(" copy") ? 1 : 0;
+        }
+
+        int found{ 0 };
+        int falseMatches{ 0 };
+        for (const auto& match : matches)
+        {
+            juce::String name{ pool[(int) match.first - 1].getFileNameWithoutExtension() };
+            juce::String original{ pool[(int) match.second - 1].getFileNameWithoutExtension() };
+            bool isCopy{ name == original + " copy" || original == name + " copy" };
+            found += isCopy ? 1 : 0;
+            falseMatches += isCopy ? 0 : 1;
+        }
+        report << "dedupe, copies found: " << found << " of " << copies << ", false matches: " << falseMatches << juce::newLine;
+
+        // loudness: decoding and measuring one file on one core, the analysis runs one file
+        // per core but one
+        std::vector<double> loudnessTimes;
+        double audioSeconds{ 0.0 };
+        for (const juce::File& file : pool)
+        {
+            std::unique_ptr<juce::AudioFormatReader> reader{ formatManager.createReaderFor(file) };
+            if (reader == nullptr)
+            {
+                continue;
+            }
+
+            loudnessTimes.push_back(timeMs([&]
+            {
+                int blockSize{ 65536 };
+                LoudnessAnalyzer loudness{ reader->sampleRate, (int) reader->numChannels, blockSize };
+                juce::AudioBuffer<float> buffer{ (int) reader->numChannels, blockSize };
+                for (juce::int64 position = 0; position < reader->lengthInSamples; position += blockSize)
+                {
+                    int numSamples{ (int) juce::jmin((juce::int64) blockSize, reader->lengthInSamples - position) };
+                    reader->read(&buffer, 0, numSamples, position, true, true);
+                    loudness.process(buffer, numSamples);
+                }
+                loudness.getLoudness();
+            }));
+            audioSeconds += reader->lengthInSamples / reader->sampleRate;
+        }
+        report << formatTimings("loudness, per file", loudnessTimes);
+        double loudnessMs{ 0.0 };
+        for (double ms : loudnessTimes)
+        {
+            loudnessMs += ms;
+        }
+        if (loudnessMs > 0.0)
+        {
+            report << "loudness, times realtime per core: " << juce::String(audioSeconds * 1000.0 / loudnessMs, 0)
+                   << ", on " << juce::jmax(1, juce::SystemStats::getNumCpus() - 1) << " cores: "
+                   << juce::String(audioSeconds * 1000.0 / loudnessMs * juce::jmax(1, juce::SystemStats::getNumCpus() - 1), 0) << juce::newLine;
+        }
+    }
+
+    // dedupe by path: what replaced checkSongExistance, the first lookup builds the index
+    juce::Random random{ 7 };
+    report << formatTiming("dedupe, path index build", timeMs([&] { store.findByPath(songs.front().file); }), numTracks);
+    std::vector<double> lookups;
+    for (int i = 0; i < 10000; ++i)
+    {
+        const juce::File& file{ songs[(size_t) random.nextInt(numTracks)].file };
+        lookups.push_back(timeMs([&] { store.findByPath(file); }));
+    }
+    report << formatTimings("dedupe, path lookup", lookups);
+
+    // search: what replaced findInPlaylist
+    report << benchmarkSearch(songs);
+
+    // sort: the first sort decodes the keys, later sorts of a column come from its cache
+    LibraryView view{ store };
+    view.clearFilter();
+    const std::pair<int, const char*> columns[] = { { LibraryView::byTitle, "title" },
+                                                    { LibraryView::byArtist, "artist" },
+                                                    { LibraryView::byLength, "length" } };
+    for (const auto& column : columns)
+    {
+        report << formatTiming(juce::String("sort by ") + column.second, timeMs([&] { view.setSort(column.first, true); }), numTracks);
+        report << formatTiming(juce::String("sort by ") + column.second + ", cached", timeMs([&] { view.setSort(column.first, false); }), 0);
+    }
+
+    // scrolling: painting a screen of rows at random places, as the table does
+    const int rowHeight{ 22 };
+    juce::Image screen{ juce::Image::RGB, 1000, 30 * rowHeight, true };
+    juce::Graphics g{ screen };
+    g.setFont(14.0f);
+    std::vector<double> frames;
+    for (int frame = 0; frame < 500; ++frame)
+    {
+        int top{ random.nextInt(juce::jmax(1, view.getNumRows() - 30)) };
+        frames.push_back(timeMs([&]
+        {
+            g.fillAll(juce::Colours::darkgrey);
+            for (int row = 0; row < 30; ++row)
+            {
+                Song song{ store.getSong(view.getTrackId(top + row)) };
+                int y{ row * rowHeight };
+                g.setColour(juce::Colours::white);
+                g.drawText(song.title, 2, y, 396, rowHeight, juce::Justification::centredLeft, true);
+                g.drawText(song.artist, 402, y, 236, rowHeight, juce::Justification::centredLeft, true);
+                g.drawText(juce::String((int) song.lengthInSeconds / 60) + ":" + juce::String((int) song.lengthInSeconds % 60).paddedLeft('0', 2),
+                    642, y, 246, rowHeight, juce::Justification::centred, true);
+            }
+        }));
+    }
+    report << formatTimings("scroll, one screen of 30 rows", frames);
+
+    return report;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include "Song.h"
+
+// LibraryBenchmark generates synthetic libraries and measures the library code on them,
+// run from the command line instead of opening the window:
+//
+//   OtoDecks --generate-library <folder> [tracks]     write a library and a pool of audio files
+//   OtoDecks --benchmark-library [tracks] [--report <file>]
+//                                                     open, save, import, dedupe, loudness,
+//                                                     search, sort and table scrolling
+//   OtoDecks --benchmark-search [tracks]              search-as-you-type only
+//
+// Libraries from 10k to 2M tracks are realistic: a long tail of artists with a few albums
+// each and paths laid out as artist/album/track. The audio pool holds a few short real files,
+// some of them copies at another level, for the import and duplicate measurements, which go
+// through the importer pool and the fingerprint index the library uses. The benchmark keeps its
+// library, settings and caches in a scratch folder and never reads the user's.
+// The report is written to the standard output, and to a file when asked.
+class LibraryBenchmark
+{
+public:
+
+    // purpose : run the benchmark asked for on the command line
+    // input : command line of the app
+    // output : true if a benchmark was run and the app should quit
+    static bool runFromCommandLine(const juce::String& commandLine);
+
+    // purpose : make up a library with realistic titles, artists, albums and paths
+    // input : number of tracks, seed of the random generator
+    // output : tracks with ids from 1
+    static std::vector<Song> generateSongs(int numTracks, juce::int64 seed);
+
+    // purpose : write short audio files, every third one is followed by a quieter copy
+    // input : folder, number of original files
+    // output : the files written
+    static juce::Array<juce::File> generateAudioPool(const juce::File& folder, int numFiles);
+
+    // purpose : write a synthetic library and an audio pool into a folder
+    // input : folder, number of tracks
+    // output : void
+    static void generateLibrary(const juce::File& folder, int numTracks);
+
+    // purpose : time building the search index and typing queries into it
+    // input : tracks to index
+    // output : report
+    static juce::String benchmarkSearch(const std::vector<Song>& songs);
+
+    // purpose : time every library operation on a synthetic library
+    // input : number of tracks, scratch folder
+    // output : report
+    static juce::String benchmarkLibrary(int numTracks, const juce::File& folder);
+};
@@ -0,0 +1,195 @@
+#include "LibraryImporter.h"
+
+// a few files per job keeps the pool busy without queueing thousands of jobs
+static constexpr int filesPerJob = 16;
+
+// time the message thread may spend on one batch, so a big import never stalls painting
+static constexpr double batchBudgetMs = 20.0;
+static constexpr size_t minBatchSize = 16;
+static constexpr size_t maxBatchSize = 65536;
+
+class LibraryImporter::ImportJob : public juce::ThreadPoolJob
+{
+public:
+    ImportJob(LibraryImporter& _owner, juce::Array<juce::File> _files)
+        : juce::ThreadPoolJob("Import"),
+        owner(_owner),
+        files(std::move(_files))
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        owner.threadConfig.applyToCurrentThread(ThreadConfig::Role::loader);
+
+        for (const juce::File& file : files)
+        {
+            if (shouldExit() || owner.cancelled)
+            {
+                return jobHasFinished;
+            }
+
+            ImportResult result{ owner.readFile(file) };
+
+            const juce::ScopedLock lock(owner.resultsLock);
+            owner.pendingResults.push_back(std::move(result));
+        }
+        return jobHasFinished;
+    }
+
+private:
+    LibraryImporter& owner;
+    juce::Array<juce::File> files;
+};
+
+LibraryImporter::LibraryImporter(juce::AudioFormatManager& _formatManager, ThreadConfig& _threadConfig, const juce::File& metadataCacheFile)
+    : formatManager(_formatManager),
+    threadConfig(_threadConfig),
+    metadataCache(metadataCacheFile),
+    pool(juce::jmax(1, juce::SystemStats::getNumCpus()))
+{
+}
+
+LibraryImporter::~LibraryImporter()
+{
+    stopTimer();
+    cancelled = true;
+    pool.removeAllJobs(true, 5000);
+}
+
+void LibraryImporter::importFiles(const juce::Array<juce::File>& files)
+{
+    if (!isImporting())
+    {
+        totalFiles = 0;
+        deliveredFiles = 0;
+    }
+    cancelled = false;
+    totalFiles += files.size();
+
+    for (int start = 0; start < files.size(); start += filesPerJob)
+    {
+        juce::Array<juce::File> chunk;
+        for (int i = start; i < juce::jmin(start + filesPerJob, files.size()); ++i)
+        {
+            chunk.add(files[i]);
+        }
+        pool.addJob(new ImportJob(*this, std::move(chunk)), true);
+    }
+
+    startTimer(100);
+}
+
+void LibraryImporter::cancel()
+{
+    cancelled = true;
+    pool.removeAllJobs(true, 2000);
+
+    {
+        const juce::ScopedLock lock(resultsLock);
+        pendingResults.clear();
+    }
+    deliveringResults.clear();
+    deliveredIndex = 0;
+
+    stopTimer();
+    metadataCache.save();
+    totalFiles = 0;
+    deliveredFiles = 0;
+
+    if (onFinished)
+    {
+        onFinished(true);
+    }
+}
+
+bool LibraryImporter::isImporting()
+{
+    return isTimerRunning();
+}
+
+double LibraryImporter::getProgress()
+{
+    if (totalFiles == 0)
+    {
+        return 0.0;
+    }
+    return deliveredFiles / (double) totalFiles;
+}
+
+ImportResult LibraryImporter::readFile(const juce::File& file)
+{
+    ImportResult result;
+    result.file = file;
+    result.fileSize = file.getSize();
+    result.modificationTime = file.getLastModificationTime().toMilliseconds();
+
+    if (metadataCache.lookup(file, result.fileSize, result.modificationTime, result.metadata))
+    {
+        result.readable = true;
+        return result;
+    }
+
+    result.metadata = MetadataProbe::probe(file);
+
+    // formats the probe doesn't know go through a reader, each thread uses its own
+    if (!result.metadata.valid)
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader{ formatManager.createReaderFor(file) };
+        if (reader != nullptr && reader->sampleRate > 0)
+        {
+            result.metadata.lengthInSeconds = reader->lengthInSamples / reader->sampleRate;
+            result.metadata.sampleRate = reader->sampleRate;
+            result.metadata.numChannels = (int) reader->numChannels;
+            result.metadata.valid = true;
+        }
+    }
+
+    result.readable = result.metadata.valid;
+    if (result.readable)
+    {
+        metadataCache.store(file, result.fileSize, result.modificationTime, result.metadata);
+    }
+    return result;
+}
+
+void LibraryImporter::timerCallback()
+{
+    // once the delivery buffer is handed over, take everything that is ready, the jobs go on
+    // filling the other buffer meanwhile
+    if (deliveredIndex == deliveringResults.size())
+    {
+        deliveringResults.clear();
+        deliveredIndex = 0;
+
+        const juce::ScopedLock lock(resultsLock);
+        pendingResults.swap(deliveringResults);
+    }
+
+    size_t count{ juce::jmin(batchSize, deliveringResults.size() - deliveredIndex) };
+    batch.assign(std::make_move_iterator(deliveringResults.begin() + (std::ptrdiff_t) deliveredIndex),
+                 std::make_move_iterator(deliveringResults.begin() + (std::ptrdiff_t) (deliveredIndex + count)));
+    deliveredIndex += count;
+    deliveredFiles += (int) count;
+
+    if (count > 0 && onBatchReady)
+    {
+        // every result is stored and journaled, the next batch is sized to the budget from
+        // what this one cost
+        double start{ juce::Time::getMillisecondCounterHiRes() };
+        onBatchReady(batch);
+        double ms{ juce::Time::getMillisecondCounterHiRes() - start };
+        batchSize = juce::jlimit(minBatchSize, maxBatchSize, (size_t) (count * batchBudgetMs / juce::jmax(ms, 0.01)));
+    }
+    batch.clear();
+
+    if (deliveredFiles >= totalFiles)
+    {
+        stopTimer();
+        metadataCache.save();
+        if (onFinished)
+        {
+            onFinished(false);
+        }
+    }
+}
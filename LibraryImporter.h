@@ -0,0 +1,95 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include "ThreadConfig.h"
+#include "MetadataProbe.h"
+#include "MetadataCache.h"
+
+// what the importer found out about one file
+struct ImportResult
+{
+    juce::File file;
+    TrackMetadata metadata;
+    juce::int64 fileSize{ 0 };
+    juce::int64 modificationTime{ 0 };
+    bool readable{ false };
+};
+
+// LibraryImporter reads the files picked for the library on a pool of loader threads,
+// one per core, and hands the results back to the message thread in batches
+class LibraryImporter : private juce::Timer
+{
+public:
+
+    LibraryImporter(juce::AudioFormatManager& formatManager, ThreadConfig& threadConfig, const juce::File& metadataCacheFile);
+
+    ~LibraryImporter() override;
+
+    // purpose : queue files for import, can be called while an import is running
+    // input : files to import
+    // output : void
+    void importFiles(const juce::Array<juce::File>& files);
+
+    // purpose : stop the running import, results not delivered yet are dropped
+    // input : none
+    // output : void
+    void cancel();
+
+    // purpose : check if files are still being read
+    // input : none
+    // output : true while importing
+    bool isImporting();
+
+    // purpose : get the progress of the running import
+    // input : none
+    // output : value between 0 and 1
+    double getProgress();
+
+    // called on the message thread with the next results
+    std::function<void(std::vector<ImportResult>& batch)> onBatchReady;
+
+    // called on the message thread once all queued files are delivered or the import was cancelled
+    std::function<void(bool cancelled)> onFinished;
+
+    // purpose : read the metadata of an audio file from its headers, or from the cache when
+    //           the file hasn't changed. Safe to call from any thread
+    // input : file
+    // output : result of the read
+    ImportResult readFile(const juce::File& file);
+
+private:
+
+    class ImportJob;
+
+    juce::AudioFormatManager& formatManager;
+    ThreadConfig& threadConfig;
+
+    MetadataCache metadataCache;
+
+    juce::ThreadPool pool;
+
+    // filled by the jobs, swapped with the delivery buffer by the timer once that is handed over,
+    // so both keep their capacity
+    juce::CriticalSection resultsLock;
+    std::vector<ImportResult> pendingResults;
+    std::vector<ImportResult> deliveringResults;
+    size_t deliveredIndex{ 0 };
+
+    // results handed over per tick, sized from the time the last batch took
+    std::vector<ImportResult> batch;
+    size_t batchSize{ 256 };
+
+    int totalFiles{ 0 };
+    int deliveredFiles{ 0 };
+    std::atomic<bool> cancelled{ false };
+
+    // purpose : deliver as many results as fit the time budget of a tick
+    // input : none
+    // output : void
+    void timerCallback() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LibraryImporter)
+};
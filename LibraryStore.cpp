@@ -0,0 +1,873 @@
+#include "LibraryStore.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+LibraryStore::LibraryStore()
+{
+}
+
+LibraryStore::~LibraryStore()
+{
+    close();
+}
+
+bool LibraryStore::open(const juce::File& directory, const juce::File& legacyCsv)
+{
+    close();
+
+    snapshotFile = directory.getChildFile("library.otodb");
+    journalFile = directory.getChildFile("library.journal");
+
+    // a crash during compaction can leave the new snapshot next to the journal
+    juce::File tempFile{ snapshotFile.getSiblingFile(snapshotFile.getFileName() + ".tmp") };
+    if (!snapshotFile.existsAsFile() && tempFile.existsAsFile())
+    {
+        tempFile.moveFileTo(snapshotFile);
+    }
+
+    bool isNewLibrary{ !snapshotFile.existsAsFile() && !journalFile.existsAsFile() };
+
+    mapSnapshot();
+    replayJournal();
+    openJournal();
+
+    // tracks of the old text library are brought over once
+    if (isNewLibrary && legacyCsv.existsAsFile())
+    {
+        importLegacyCsv(legacyCsv);
+    }
+
+    compactIfNeeded();
+    return journal != nullptr;
+}
+
+void LibraryStore::close()
+{
+    if (journal != nullptr && journalEntries > 0)
+    {
+        compact();
+    }
+
+    journal.reset();
+    snapshot.reset();
+    indexData = nullptr;
+    snapshotCount = 0;
+    overlay.clear();
+    removedFromSnapshot.clear();
+    trackIds.clear();
+    removedIds.clear();
+    pathIndex.clear();
+    pathIndexBuilt = false;
+    journalEntries = 0;
+    nextId = 1;
+}
+
+int LibraryStore::getNumTracks()
+{
+    return (int) (trackIds.size() - removedIds.size());
+}
+
+const std::vector<TrackId>& LibraryStore::getTrackIds()
+{
+    dropRemovedIds();
+    return trackIds;
+}
+
+void LibraryStore::dropRemovedIds()
+{
+    if (removedIds.empty())
+    {
+        return;
+    }
+
+    trackIds.erase(std::remove_if(trackIds.begin(), trackIds.end(), [this](TrackId id) { return removedIds.count(id) > 0; }),
+        trackIds.end());
+    removedIds.clear();
+}
+
+bool LibraryStore::contains(TrackId id)
+{
+    if (overlay.count(id) > 0)
+    {
+        return true;
+    }
+    return findInSnapshot(id) >= 0 && removedFromSnapshot.count(id) == 0;
+}
+
+Song LibraryStore::getSong(TrackId id)
+{
+    const void* data{ nullptr };
+    size_t size{ 0 };
+
+    if (!getRecord(id, data, size))
+    {
+        return Song{ juce::File{} };
+    }
+    return decodeSong(id, data, size);
+}
+
+juce::String LibraryStore::getPath(TrackId id)
+{
+    const void* data{ nullptr };
+    size_t size{ 0 };
+    const char* field{ nullptr };
+    size_t fieldSize{ 0 };
+
+    if (!getRecord(id, data, size) || !findField(data, size, pathTag, field, fieldSize))
+    {
+        return {};
+    }
+    return juce::String::fromUTF8(field, (int) fieldSize);
+}
+
+int LibraryStore::getAnalysisVersion(TrackId id)
+{
+    // tracks changed since the snapshot are in memory, their records are short to walk
+    auto it = overlay.find(id);
+    if (it != overlay.end())
+    {
+        return readAnalysisVersion(it->second.getData(), it->second.getSize());
+    }
+
+    juce::int64 index{ findInSnapshot(id) };
+    if (index < 0 || removedFromSnapshot.count(id) > 0)
+    {
+        return 0;
+    }
+    return (int) juce::ByteOrder::littleEndianInt(indexData + index * indexEntrySize + 20);
+}
+
+TrackId LibraryStore::findByPath(const juce::File& file)
+{
+    buildPathIndex();
+
+    auto it = pathIndex.find(getCanonicalPath(file));
+    return it != pathIndex.end() ? it->second : 0;
+}
+
+std::vector<TrackId> LibraryStore::findInFolder(const juce::File& folder)
+{
+    buildPathIndex();
+
+    std::vector<TrackId> ids;
+    juce::String prefix{ getCanonicalPath(folder) + juce::File::getSeparatorString() };
+    for (const auto& entry : pathIndex)
+    {
+        if (entry.first.startsWith(prefix))
+        {
+            ids.push_back(entry.second);
+        }
+    }
+    return ids;
+}
+
+juce::String LibraryStore::getCanonicalPath(const juce::File& file)
+{
+#if JUCE_WINDOWS
+    std::filesystem::path path{ file.getFullPathName().toWideCharPointer() };
+#else
+    std::filesystem::path path{ file.getFullPathName().toRawUTF8() };
+#endif
+
+    std::error_code error;
+    std::filesystem::path canonical{ std::filesystem::weakly_canonical(path, error) };
+    if (error)
+    {
+        return file.getFullPathName();
+    }
+
+#if JUCE_WINDOWS
+    return juce::String{ canonical.wstring().c_str() };
+#else
+    return juce::String::fromUTF8(canonical.c_str());
+#endif
+}
+
+void LibraryStore::buildPathIndex()
+{
+    if (pathIndexBuilt)
+    {
+        return;
+    }
+
+    dropRemovedIds();
+    pathIndex.reserve(trackIds.size());
+    for (TrackId id : trackIds)
+    {
+        pathIndex[getPath(id)] = id;
+    }
+    pathIndexBuilt = true;
+}
+
+TrackId LibraryStore::addSong(Song& song)
+{
+    song.id = nextId++;
+
+    if (pathIndexBuilt)
+    {
+        pathIndex[song.file.getFullPathName()] = song.id;
+    }
+
+    juce::MemoryBlock record{ encodeSong(song) };
+    appendToJournal(putOp, song.id, record);
+    overlay[song.id] = std::move(record);
+    trackIds.push_back(song.id);
+
+    if (onSongStored)
+    {
+        onSongStored(song);
+    }
+
+    compactIfNeeded();
+    return song.id;
+}
+
+void LibraryStore::updateSong(const Song& song)
+{
+    if (!contains(song.id))
+    {
+        std::cout << "LibraryStore::updateSong unknown track " << (juce::int64) song.id << std::endl;
+        return;
+    }
+
+    if (pathIndexBuilt)
+    {
+        pathIndex.erase(getSong(song.id).file.getFullPathName());
+        pathIndex[song.file.getFullPathName()] = song.id;
+    }
+
+    juce::MemoryBlock record{ encodeSong(song) };
+    appendToJournal(putOp, song.id, record);
+    overlay[song.id] = std::move(record);
+
+    if (onSongStored)
+    {
+        onSongStored(song);
+    }
+
+    compactIfNeeded();
+}
+
+void LibraryStore::removeSong(TrackId id)
+{
+    if (!contains(id))
+    {
+        return;
+    }
+
+    if (pathIndexBuilt)
+    {
+        pathIndex.erase(getSong(id).file.getFullPathName());
+    }
+
+    appendToJournal(removeOp, id, {});
+    overlay.erase(id);
+    if (findInSnapshot(id) >= 0)
+    {
+        removedFromSnapshot.insert(id);
+    }
+
+    // erasing from the middle of the library order is deferred, so removing many tracks
+    // costs one pass instead of one pass each
+    removedIds.insert(id);
+
+    if (onSongRemoved)
+    {
+        onSongRemoved(id);
+    }
+
+    compactIfNeeded();
+}
+
+void LibraryStore::compact()
+{
+    juce::File tempFile{ snapshotFile.getSiblingFile(snapshotFile.getFileName() + ".tmp") };
+    dropRemovedIds();
+
+    {
+        juce::FileOutputStream out{ tempFile };
+        if (out.failedToOpen())
+        {
+            std::cerr << "LibraryStore::compact can't write " << tempFile.getFullPathName() << std::endl;
+            return;
+        }
+        out.setPosition(0);
+        out.truncate();
+
+        // header
+        out.write("OTDB", 4);
+        out.writeInt((int) formatVersion);
+        out.writeInt64((juce::int64) trackIds.size());
+        out.writeInt64((juce::int64) nextId);
+        out.writeInt64(0);
+
+        // index, ids are handed out in increasing order so library order is sorted by id
+        juce::int64 offset{ headerSize + (juce::int64) trackIds.size() * indexEntrySize };
+        for (TrackId id : trackIds)
+        {
+            const void* data{ nullptr };
+            size_t size{ 0 };
+            getRecord(id, data, size);
+
+            out.writeInt64((juce::int64) id);
+            out.writeInt64(offset);
+            out.writeInt((int) size);
+            out.writeInt(readAnalysisVersion(data, size));
+            offset += (juce::int64) size;
+        }
+
+        // records
+        for (TrackId id : trackIds)
+        {
+            const void* data{ nullptr };
+            size_t size{ 0 };
+            if (getRecord(id, data, size))
+            {
+                out.write(data, size);
+            }
+        }
+
+        out.flush();
+        if (out.getStatus().failed())
+        {
+            std::cerr << "LibraryStore::compact " << out.getStatus().getErrorMessage() << std::endl;
+            return;
+        }
+    }
+
+    // the old mapping has to go before the file is replaced
+    snapshot.reset();
+    indexData = nullptr;
+    snapshotCount = 0;
+
+    // the old snapshot and the journal still hold every change, keep using them
+    if (!tempFile.replaceFileIn(snapshotFile))
+    {
+        std::cerr << "LibraryStore::compact can't replace " << snapshotFile.getFullPathName() << std::endl;
+        tempFile.deleteFile();
+        mapSnapshot();
+        return;
+    }
+
+    mapSnapshot();
+    overlay.clear();
+    removedFromSnapshot.clear();
+
+    // replaying the old journal on the new snapshot is harmless, so a crash here loses nothing
+    if (journal != nullptr)
+    {
+        journal->setPosition(0);
+        journal->truncate();
+        journal->flush();
+    }
+    journalEntries = 0;
+}
+
+bool LibraryStore::mapSnapshot()
+{
+    snapshot.reset();
+    indexData = nullptr;
+    snapshotCount = 0;
+
+    if (!snapshotFile.existsAsFile())
+    {
+        return false;
+    }
+
+    auto mapped = std::make_unique<juce::MemoryMappedFile>(snapshotFile, juce::MemoryMappedFile::readOnly);
+    const char* data{ static_cast<const char*>(mapped->getData()) };
+    juce::int64 size{ (juce::int64) mapped->getSize() };
+
+    bool valid{ data != nullptr && size >= headerSize
+        && std::memcmp(data, "OTDB", 4) == 0
+        && juce::ByteOrder::littleEndianInt(data + 4) == formatVersion };
+
+    juce::int64 count{ valid ? (juce::int64) juce::ByteOrder::littleEndianInt64(data + 8) : 0 };
+    valid = valid && count >= 0 && headerSize + count * indexEntrySize <= size;
+
+    if (!valid)
+    {
+        std::cerr << "LibraryStore: " << snapshotFile.getFullPathName() << " is damaged, starting from the journal" << std::endl;
+        mapped.reset();
+        snapshotFile.moveFileTo(snapshotFile.withFileExtension("corrupt"));
+        return false;
+    }
+
+    snapshot = std::move(mapped);
+    indexData = data + headerSize;
+    snapshotCount = count;
+    nextId = juce::jmax(nextId, (TrackId) juce::ByteOrder::littleEndianInt64(data + 16));
+
+    return true;
+}
+
+void LibraryStore::replayJournal()
+{
+    juce::MemoryBlock journalData;
+    if (journalFile.existsAsFile())
+    {
+        journalFile.loadFileAsData(journalData);
+    }
+
+    const char* data{ static_cast<const char*>(journalData.getData()) };
+    size_t size{ journalData.getSize() };
+    size_t position{ 0 };
+    const size_t entryHeader{ 1 + 8 + 4 };
+
+    while (position + entryHeader + 4 <= size)
+    {
+        const char* entry{ data + position };
+        Op op{ (Op) (juce::uint8) entry[0] };
+        TrackId id{ juce::ByteOrder::littleEndianInt64(entry + 1) };
+        size_t recordSize{ juce::ByteOrder::littleEndianInt(entry + 9) };
+
+        if (position + entryHeader + recordSize + 4 > size
+            || (op != putOp && op != removeOp)
+            || checksum(entry, entryHeader + recordSize, 0) != juce::ByteOrder::littleEndianInt(entry + entryHeader + recordSize))
+        {
+            std::cerr << "LibraryStore: dropping a torn journal tail of " << (int) (size - position) << " bytes" << std::endl;
+            break;
+        }
+
+        if (op == putOp)
+        {
+            overlay[id] = juce::MemoryBlock{ entry + entryHeader, recordSize };
+            nextId = juce::jmax(nextId, id + 1);
+        }
+        else
+        {
+            overlay.erase(id);
+            if (findInSnapshot(id) >= 0)
+            {
+                removedFromSnapshot.insert(id);
+            }
+        }
+
+        position += entryHeader + recordSize + 4;
+        ++journalEntries;
+    }
+
+    // library order: snapshot tracks, then the ones added since, both sorted by id
+    trackIds.clear();
+    trackIds.reserve((size_t) snapshotCount + overlay.size());
+    for (juce::int64 i = 0; i < snapshotCount; ++i)
+    {
+        TrackId id{ juce::ByteOrder::littleEndianInt64(indexData + i * indexEntrySize) };
+        if (removedFromSnapshot.count(id) == 0)
+        {
+            trackIds.push_back(id);
+        }
+    }
+
+    std::vector<TrackId> addedIds;
+    for (const auto& entry : overlay)
+    {
+        if (findInSnapshot(entry.first) < 0)
+        {
+            addedIds.push_back(entry.first);
+        }
+    }
+    std::sort(addedIds.begin(), addedIds.end());
+    trackIds.insert(trackIds.end(), addedIds.begin(), addedIds.end());
+
+    // keep only the valid part so new entries follow a complete one
+    if (position < size)
+    {
+        juce::FileOutputStream out{ journalFile };
+        if (!out.failedToOpen())
+        {
+            out.setPosition((juce::int64) position);
+            out.truncate();
+        }
+    }
+}
+
+void LibraryStore::openJournal()
+{
+    journal = std::make_unique<juce::FileOutputStream>(journalFile);
+    if (journal->failedToOpen())
+    {
+        std::cerr << "LibraryStore: can't write " << journalFile.getFullPathName()
+                  << ", changes to the library won't be saved" << std::endl;
+        journal.reset();
+    }
+}
+
+void LibraryStore::appendToJournal(Op op, TrackId id, const juce::MemoryBlock& record)
+{
+    if (journal == nullptr)
+    {
+        return;
+    }
+
+    juce::MemoryOutputStream entry;
+    entry.writeByte((char) op);
+    entry.writeInt64((juce::int64) id);
+    entry.writeInt((int) record.getSize());
+    entry.write(record.getData(), record.getSize());
+    entry.writeInt((int) checksum(entry.getData(), entry.getDataSize(), 0));
+
+    journal->write(entry.getData(), entry.getDataSize());
+    journal->flush();
+    ++journalEntries;
+}
+
+juce::int64 LibraryStore::findInSnapshot(TrackId id)
+{
+    juce::int64 low{ 0 };
+    juce::int64 high{ snapshotCount - 1 };
+
+    while (low <= high)
+    {
+        juce::int64 middle{ (low + high) / 2 };
+        TrackId middleId{ juce::ByteOrder::littleEndianInt64(indexData + middle * indexEntrySize) };
+
+        if (middleId == id)
+        {
+            return middle;
+        }
+        if (middleId < id)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle - 1;
+        }
+    }
+    return -1;
+}
+
+bool LibraryStore::getRecord(TrackId id, const void*& data, size_t& size)
+{
+    auto it = overlay.find(id);
+    if (it != overlay.end())
+    {
+        data = it->second.getData();
+        size = it->second.getSize();
+        return true;
+    }
+
+    if (removedFromSnapshot.count(id) > 0)
+    {
+        return false;
+    }
+
+    juce::int64 index{ findInSnapshot(id) };
+    if (index < 0)
+    {
+        return false;
+    }
+
+    const char* entry{ indexData + index * indexEntrySize };
+    juce::uint64 offset{ juce::ByteOrder::littleEndianInt64(entry + 8) };
+    juce::uint32 recordSize{ juce::ByteOrder::littleEndianInt(entry + 16) };
+
+    if (offset + recordSize > snapshot->getSize())
+    {
+        std::cerr << "LibraryStore: record " << (juce::int64) id << " lies outside the snapshot" << std::endl;
+        return false;
+    }
+
+    data = static_cast<const char*>(snapshot->getData()) + offset;
+    size = recordSize;
+    return true;
+}
+
+void LibraryStore::compactIfNeeded()
+{
+    if (journalEntries > juce::jmax(1024, getNumTracks() / 4))
+    {
+        compact();
+    }
+}
+
+void LibraryStore::importLegacyCsv(const juce::File& csvFile)
+{
+    juce::StringArray lines;
+    csvFile.readLines(lines);
+
+    int imported{ 0 };
+    for (const juce::String& line : lines)
+    {
+        // the length never has a comma, the path may
+        int comma{ line.lastIndexOfChar(',') };
+        if (comma <= 0)
+        {
+            continue;
+        }
+
+        juce::String path{ line.substring(0, comma) };
+        if (!juce::File::isAbsolutePath(path))
+        {
+            continue;
+        }
+
+        juce::String length{ line.substring(comma + 1).trim() };
+        Song song{ juce::File{ getCanonicalPath(juce::File{ path }) } };
+        song.lengthInSeconds = length.upToFirstOccurrenceOf(":", false, false).getIntValue() * 60.0
+            + length.fromFirstOccurrenceOf(":", false, false).getIntValue();
+
+        addSong(song);
+        ++imported;
+    }
+
+    std::cout << "LibraryStore: imported " << imported << " tracks from " << csvFile.getFullPathName() << std::endl;
+    compact();
+}
+
+juce::MemoryBlock LibraryStore::encodeSong(const Song& song)
+{
+    juce::MemoryOutputStream out;
+
+    writeField(out, pathTag, song.file.getFullPathName());
+    writeField(out, lengthTag, song.lengthInSeconds);
+
+    // the title is only stored when it comes from the tags
+    if (song.title != song.file.getFileNameWithoutExtension())
+    {
+        writeField(out, titleTag, song.title);
+    }
+    if (song.artist.isNotEmpty())
+    {
+        writeField(out, artistTag, song.artist);
+    }
+    if (song.album.isNotEmpty())
+    {
+        writeField(out, albumTag, song.album);
+    }
+
+    writeField(out, sampleRateTag, song.sampleRate);
+    writeField(out, channelsTag, (juce::int64) song.numChannels);
+    writeField(out, bitrateTag, (juce::int64) song.bitrate);
+    writeField(out, fileSizeTag, song.fileSize);
+    writeField(out, modificationTimeTag, song.modificationTime);
+
+    // analysis results, once there are any
+    if (song.bpm > 0.0)
+    {
+        writeField(out, bpmTag, song.bpm);
+    }
+    if (!song.beatGrid.empty())
+    {
+        out.writeByte((char) beatGridTag);
+        out.writeInt((int) song.beatGrid.size() * 16);
+        for (const BeatMarker& marker : song.beatGrid)
+        {
+            out.writeDouble(marker.time);
+            out.writeDouble(marker.bpm);
+        }
+    }
+    if (song.key >= 0)
+    {
+        writeField(out, keyTag, (juce::int64) song.key);
+    }
+    if (song.loudness < 0.0)
+    {
+        writeField(out, loudnessTag, song.loudness);
+        writeField(out, truePeakTag, song.truePeak);
+    }
+    if (song.analysisVersion > 0)
+    {
+        writeField(out, analysisVersionTag, (juce::int64) song.analysisVersion);
+    }
+
+    return out.getMemoryBlock();
+}
+
+void LibraryStore::writeField(juce::MemoryOutputStream& out, Tag tag, const juce::String& value)
+{
+    out.writeByte((char) tag);
+    out.writeInt((int) value.getNumBytesAsUTF8());
+    out.write(value.toRawUTF8(), value.getNumBytesAsUTF8());
+}
+
+void LibraryStore::writeField(juce::MemoryOutputStream& out, Tag tag, double value)
+{
+    out.writeByte((char) tag);
+    out.writeInt(8);
+    out.writeDouble(value);
+}
+
+void LibraryStore::writeField(juce::MemoryOutputStream& out, Tag tag, juce::int64 value)
+{
+    out.writeByte((char) tag);
+    out.writeInt(8);
+    out.writeInt64(value);
+}
+
+double LibraryStore::readDouble(const char* field, size_t size)
+{
+    double value{ 0.0 };
+    if (size == 8)
+    {
+        juce::uint64 bits{ juce::ByteOrder::littleEndianInt64(field) };
+        std::memcpy(&value, &bits, sizeof(double));
+    }
+    return value;
+}
+
+juce::int64 LibraryStore::readInt64(const char* field, size_t size)
+{
+    return size == 8 ? (juce::int64) juce::ByteOrder::littleEndianInt64(field) : 0;
+}
+
+Song LibraryStore::decodeSong(TrackId id, const void* data, size_t size)
+{
+    juce::String path;
+    juce::String title;
+    juce::String artist;
+    juce::String album;
+    double lengthInSeconds{ 0.0 };
+    double sampleRate{ 0.0 };
+    juce::int64 numChannels{ 0 };
+    juce::int64 bitrate{ 0 };
+    juce::int64 fileSize{ 0 };
+    juce::int64 modificationTime{ 0 };
+    double bpm{ 0.0 };
+    std::vector<BeatMarker> beatGrid;
+    juce::int64 key{ -1 };
+    double loudness{ 0.0 };
+    double truePeak{ 0.0 };
+    juce::int64 analysisVersion{ 0 };
+
+    const char* bytes{ static_cast<const char*>(data) };
+    size_t position{ 0 };
+
+    while (position + 5 <= size)
+    {
+        juce::uint8 tag{ (juce::uint8) bytes[position] };
+        size_t fieldSize{ juce::ByteOrder::littleEndianInt(bytes + position + 1) };
+        const char* field{ bytes + position + 5 };
+        position += 5 + fieldSize;
+
+        if (position > size)
+        {
+            break;
+        }
+
+        switch (tag)
+        {
+            case pathTag:
+                path = juce::String::fromUTF8(field, (int) fieldSize);
+                break;
+            case lengthTag:
+                lengthInSeconds = readDouble(field, fieldSize);
+                break;
+            case titleTag:
+                title = juce::String::fromUTF8(field, (int) fieldSize);
+                break;
+            case artistTag:
+                artist = juce::String::fromUTF8(field, (int) fieldSize);
+                break;
+            case albumTag:
+                album = juce::String::fromUTF8(field, (int) fieldSize);
+                break;
+            case sampleRateTag:
+                sampleRate = readDouble(field, fieldSize);
+                break;
+            case channelsTag:
+                numChannels = readInt64(field, fieldSize);
+                break;
+            case bitrateTag:
+                bitrate = readInt64(field, fieldSize);
+                break;
+            case fileSizeTag:
+                fileSize = readInt64(field, fieldSize);
+                break;
+            case modificationTimeTag:
+                modificationTime = readInt64(field, fieldSize);
+                break;
+            case bpmTag:
+                bpm = readDouble(field, fieldSize);
+                break;
+            case beatGridTag:
+                for (size_t marker = 0; marker + 16 <= fieldSize; marker += 16)
+                {
+                    beatGrid.push_back({ readDouble(field + marker, 8), readDouble(field + marker + 8, 8) });
+                }
+                break;
+            case keyTag:
+                key = readInt64(field, fieldSize);
+                break;
+            case loudnessTag:
+                loudness = readDouble(field, fieldSize);
+                break;
+            case truePeakTag:
+                truePeak = readDouble(field, fieldSize);
+                break;
+            case analysisVersionTag:
+                analysisVersion = readInt64(field, fieldSize);
+                break;
+            default:
+                // written by a newer version
+                break;
+        }
+    }
+
+    Song song{ juce::File::isAbsolutePath(path) ? juce::File{ path } : juce::File{} };
+    song.id = id;
+    if (title.isNotEmpty())
+    {
+        song.title = title;
+    }
+    song.artist = artist;
+    song.album = album;
+    song.lengthInSeconds = lengthInSeconds;
+    song.sampleRate = sampleRate;
+    song.numChannels = (int) numChannels;
+    song.bitrate = (int) bitrate;
+    song.fileSize = fileSize;
+    song.modificationTime = modificationTime;
+    song.bpm = bpm;
+    song.beatGrid = std::move(beatGrid);
+    song.key = key >= 0 && key < 24 ? (int) key : -1;
+    song.loudness = loudness;
+    song.truePeak = truePeak;
+    song.analysisVersion = (int) analysisVersion;
+    return song;
+}
+
+bool LibraryStore::findField(const void* data, size_t size, Tag tag, const char*& field, size_t& fieldSize)
+{
+    const char* bytes{ static_cast<const char*>(data) };
+    size_t position{ 0 };
+
+    while (position + 5 <= size)
+    {
+        juce::uint8 fieldTag{ (juce::uint8) bytes[position] };
+        fieldSize = juce::ByteOrder::littleEndianInt(bytes + position + 1);
+        field = bytes + position + 5;
+        position += 5 + fieldSize;
+
+        if (position > size)
+        {
+            return false;
+        }
+        if (fieldTag == tag)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int LibraryStore::readAnalysisVersion(const void* data, size_t size)
+{
+    const char* field{ nullptr };
+    size_t fieldSize{ 0 };
+    return findField(data, size, analysisVersionTag, field, fieldSize) ? (int) readInt64(field, fieldSize) : 0;
+}
+
+juce::uint32 LibraryStore::checksum(const void* data, size_t size, juce::uint32 seed)
+{
+    // FNV-1a
+    juce::uint32 hash{ 2166136261u ^ seed };
+    const juce::uint8* bytes{ static_cast<const juce::uint8*>(data) };
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "Song.h"
+
+// LibraryStore keeps the track library on disk as a compact binary snapshot plus an
+// append-only journal. The snapshot is memory mapped when the library is opened and
+// records are only decoded when they are asked for, every change is appended to the
+// journal straight away and the journal is folded into a new snapshot once it grows.
+//
+// snapshot : header | index of (id, offset, size, analysis version) sorted by id | records
+// journal  : entries of (op, id, size, record, checksum)
+// record   : fields of (tag, size, bytes), unknown tags are skipped when reading
+class LibraryStore
+{
+public:
+
+    LibraryStore();
+
+    ~LibraryStore();
+
+    // purpose : open the library kept in a folder, replaying the journal of the last session
+    // input : folder holding the library files, old text library brought over into a new one
+    // output : true if the library could be opened
+    bool open(const juce::File& directory, const juce::File& legacyCsv);
+
+    // purpose : fold the journal into the snapshot and release the files
+    // input : none
+    // output : void
+    void close();
+
+    // purpose : get the number of tracks
+    // input : none
+    // output : number of tracks
+    int getNumTracks();
+
+    // purpose : get the ids of the tracks in library order
+    // input : none
+    // output : track ids
+    const std::vector<TrackId>& getTrackIds();
+
+    // purpose : check if a track is in the library
+    // input : id of the track
+    // output : true if it is stored
+    bool contains(TrackId id);
+
+    // purpose : decode a track
+    // input : id of the track
+    // output : the track, with an empty file if the id is unknown
+    Song getSong(TrackId id);
+
+    // purpose : get the path of a track without decoding the rest of it
+    // input : id of the track
+    // output : full path, empty if the id is unknown
+    juce::String getPath(TrackId id);
+
+    // purpose : get the analysis version a track was analysed with, read from the snapshot
+    //           index so no record is decoded
+    // input : id of the track
+    // output : analysis version, 0 if never analysed or unknown
+    int getAnalysisVersion(TrackId id);
+
+    // purpose : find a track by the path of its file
+    // input : file
+    // output : id of the track, 0 if it isn't in the library
+    TrackId findByPath(const juce::File& file);
+
+    // purpose : find every track stored below a folder
+    // input : folder
+    // output : ids of the tracks
+    std::vector<TrackId> findInFolder(const juce::File& folder);
+
+    // purpose : add a track and journal it
+    // input : track, its id is set by the store
+    // output : id of the new track
+    TrackId addSong(Song& song);
+
+    // purpose : replace the stored fields of a track
+    // input : track with a valid id
+    // output : void
+    void updateSong(const Song& song);
+
+    // purpose : remove a track
+    // input : id of the track
+    // output : void
+    void removeSong(TrackId id);
+
+    // purpose : get the path a file is stored under, with links, "." and ".." resolved so
+    //           one file always has one path
+    // input : file, it doesn't have to exist anymore
+    // output : canonical path
+    static juce::String getCanonicalPath(const juce::File& file);
+
+    // purpose : rewrite the snapshot with every live track and empty the journal
+    // input : none
+    // output : void
+    void compact();
+
+    // called after a track was added or changed, and after one was removed
+    std::function<void(const Song& song)> onSongStored;
+    std::function<void(TrackId id)> onSongRemoved;
+
+private:
+
+    // journal operations
+    enum Op : juce::uint8
+    {
+        putOp = 1,
+        removeOp = 2
+    };
+
+    // record fields
+    enum Tag : juce::uint8
+    {
+        pathTag = 1,
+        lengthTag = 2,
+        titleTag = 3,
+        artistTag = 4,
+        albumTag = 5,
+        sampleRateTag = 6,
+        channelsTag = 7,
+        bitrateTag = 8,
+        fileSizeTag = 9,
+        modificationTimeTag = 10,
+        bpmTag = 11,
+        beatGridTag = 12,
+        keyTag = 13,
+        loudnessTag = 14,
+        truePeakTag = 15,
+        analysisVersionTag = 16
+    };
+
+    static constexpr int headerSize = 32;
+    static constexpr int indexEntrySize = 24;
+    static constexpr juce::uint32 formatVersion = 2;
+
+    juce::File snapshotFile;
+    juce::File journalFile;
+
+    // the mapped snapshot
+    std::unique_ptr<juce::MemoryMappedFile> snapshot;
+    const char* indexData{ nullptr };
+    juce::int64 snapshotCount{ 0 };
+
+    // tracks changed since the snapshot was written
+    std::unordered_map<TrackId, juce::MemoryBlock> overlay;
+    std::unordered_set<TrackId> removedFromSnapshot;
+    int journalEntries{ 0 };
+
+    std::unique_ptr<juce::FileOutputStream> journal;
+
+    std::vector<TrackId> trackIds;
+    TrackId nextId{ 1 };
+
+    // removed tracks still in trackIds, dropped in one pass when the ids are next needed
+    std::unordered_set<TrackId> removedIds;
+
+    // purpose : drop the removed tracks from the library order
+    // input : none
+    // output : void
+    void dropRemovedIds();
+
+    struct StringHash
+    {
+        size_t operator()(const juce::String& text) const noexcept { return (size_t) text.hashCode64(); }
+    };
+
+    // path of every track, built on the first lookup and kept up to date after that
+    std::unordered_map<juce::String, TrackId, StringHash> pathIndex;
+    bool pathIndexBuilt{ false };
+
+    // purpose : decode the path of every track into the path index
+    // input : none
+    // output : void
+    void buildPathIndex();
+
+    // purpose : map the snapshot and check its header
+    // input : none
+    // output : true if a valid snapshot was mapped
+    bool mapSnapshot();
+
+    // purpose : apply the journal on top of the snapshot, dropping a torn tail
+    // input : none
+    // output : void
+    void replayJournal();
+
+    // purpose : start appending to the journal
+    // input : none
+    // output : void
+    void openJournal();
+
+    // purpose : append an operation to the journal and flush it
+    // input : operation, id and record
+    // output : void
+    void appendToJournal(Op op, TrackId id, const juce::MemoryBlock& record);
+
+    // purpose : find a track in the snapshot index
+    // input : id of the track
+    // output : index entry or -1
+    juce::int64 findInSnapshot(TrackId id);
+
+    // purpose : get the bytes of a stored record
+    // input : id of the track, pointer and size to fill
+    // output : true if found
+    bool getRecord(TrackId id, const void*& data, size_t& size);
+
+    // purpose : compact when the journal is large compared to the library
+    // input : none
+    // output : void
+    void compactIfNeeded();
+
+    // purpose : bring the tracks of the old my-library.csv into the store
+    // input : csv file
+    // output : void
+    void importLegacyCsv(const juce::File& csvFile);
+
+    static juce::MemoryBlock encodeSong(const Song& song);
+    static void writeField(juce::MemoryOutputStream& out, Tag tag, const juce::String& value);
+    static void writeField(juce::MemoryOutputStream& out, Tag tag, double value);
+    static void writeField(juce::MemoryOutputStream& out, Tag tag, juce::int64 value);
+    static double readDouble(const char* field, size_t size);
+    static juce::int64 readInt64(const char* field, size_t size);
+    static Song decodeSong(TrackId id, const void* data, size_t size);
+    static bool findField(const void* data, size_t size, Tag tag, const char*& field, size_t& fieldSize);
+    static int readAnalysisVersion(const void* data, size_t size);
+    static juce::uint32 checksum(const void* data, size_t size, juce::uint32 seed);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LibraryStore)
+};
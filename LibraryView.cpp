@@ -0,0 +1,272 @@
+#include "LibraryView.h"
+#include <algorithm>
+
+LibraryView::LibraryView(LibraryStore& _store)
+    : store(_store)
+{
+}
+
+LibraryView::~LibraryView()
+{
+    cancelPendingUpdate();
+}
+
+int LibraryView::getNumRows()
+{
+    return (int) rows.size();
+}
+
+TrackId LibraryView::getTrackId(int row)
+{
+    if (row < 0 || row >= (int) rows.size())
+    {
+        return 0;
+    }
+
+    TrackId id{ rows[(size_t) row] };
+    return removedIds.count(id) > 0 ? 0 : id;
+}
+
+void LibraryView::setFilter(std::vector<TrackId> ids)
+{
+    filtered = true;
+    filter = std::move(ids);
+    rebuildRows();
+}
+
+void LibraryView::clearFilter()
+{
+    filtered = false;
+    filter.clear();
+    rebuildRows();
+}
+
+void LibraryView::setSort(int column, bool forwards)
+{
+    sortColumn = column;
+    sortForwards = forwards;
+    rebuildRows();
+}
+
+void LibraryView::songStored(const Song& song)
+{
+    if (keysBuilt)
+    {
+        // a changed track may have to move in the cached orders
+        auto it = keys.find(song.id);
+        if (it != keys.end())
+        {
+            staleIds.insert(song.id);
+        }
+        keys[song.id] = getSortKeys(song);
+        storedIds.push_back(song.id);
+    }
+
+    // a track added to the library order shows up in the rows on the next rebuild
+    triggerAsyncUpdate();
+}
+
+void LibraryView::songRemoved(TrackId id)
+{
+    // the row stays until the next rebuild, empty
+    removedIds.insert(id);
+    triggerAsyncUpdate();
+}
+
+void LibraryView::handleAsyncUpdate()
+{
+    rebuildRows();
+
+    if (onRowsChanged)
+    {
+        onRowsChanged();
+    }
+}
+
+void LibraryView::buildKeys()
+{
+    if (keysBuilt)
+    {
+        return;
+    }
+
+    const std::vector<TrackId>& ids{ store.getTrackIds() };
+    keys.reserve(ids.size());
+    for (TrackId id : ids)
+    {
+        keys[id] = getSortKeys(store.getSong(id));
+    }
+    keysBuilt = true;
+
+    // everything is in the keys now
+    storedIds.clear();
+    staleIds.clear();
+}
+
+LibraryView::SortKeys LibraryView::getSortKeys(const Song& song)
+{
+    int key{ song.key < 0 ? -1 : KeyIndex::getCamelotNumber(song.key) * 2 + (song.key < 12 ? 1 : 0) };
+    return { song.title.toLowerCase(), song.artist.toLowerCase(), song.lengthInSeconds, song.bpm, key };
+}
+
+bool LibraryView::isBefore(int column, const SortKeys& a, TrackId idA, const SortKeys& b, TrackId idB)
+{
+    int comparison{ 0 };
+    switch (column)
+    {
+        case byTitle:
+            comparison = a.title.compare(b.title);
+            break;
+        case byArtist:
+            comparison = a.artist.compare(b.artist);
+            break;
+        case byLength:
+            comparison = a.lengthInSeconds < b.lengthInSeconds ? -1 : (b.lengthInSeconds < a.lengthInSeconds ? 1 : 0);
+            break;
+        case byBpm:
+            comparison = a.bpm < b.bpm ? -1 : (b.bpm < a.bpm ? 1 : 0);
+            break;
+        case byKey:
+            comparison = a.key - b.key;
+            break;
+        default:
+            break;
+    }
+    return comparison != 0 ? comparison < 0 : idA < idB;
+}
+
+const std::vector<TrackId>& LibraryView::getOrder(int column)
+{
+    buildKeys();
+
+    auto cached = orders.find(column);
+    if (cached != orders.end())
+    {
+        return cached->second;
+    }
+
+    // sort pointers to the keys, so the comparisons don't look them up
+    std::vector<std::pair<const SortKeys*, TrackId>> entries;
+    entries.reserve(keys.size());
+    for (const auto& entry : keys)
+    {
+        if (removedIds.count(entry.first) == 0)
+        {
+            entries.push_back({ &entry.second, entry.first });
+        }
+    }
+    std::sort(entries.begin(), entries.end(), [column](const auto& a, const auto& b)
+    {
+        return isBefore(column, *a.first, a.second, *b.first, b.second);
+    });
+
+    std::vector<TrackId>& order{ orders[column] };
+    order.reserve(entries.size());
+    for (const auto& entry : entries)
+    {
+        order.push_back(entry.second);
+    }
+    return order;
+}
+
+void LibraryView::updateOrders()
+{
+    for (TrackId id : removedIds)
+    {
+        keys.erase(id);
+        staleIds.insert(id);
+    }
+
+    if (orders.empty() || (staleIds.empty() && storedIds.empty()))
+    {
+        storedIds.clear();
+        staleIds.clear();
+        return;
+    }
+
+    // the stored tracks that are still there, each once
+    std::sort(storedIds.begin(), storedIds.end());
+    storedIds.erase(std::unique(storedIds.begin(), storedIds.end()), storedIds.end());
+    storedIds.erase(std::remove_if(storedIds.begin(), storedIds.end(), [this](TrackId id) { return keys.count(id) == 0; }),
+        storedIds.end());
+
+    for (auto& item : orders)
+    {
+        int column{ item.first };
+        std::vector<TrackId>& order{ item.second };
+
+        // only changes and removals need a pass over the order, additions are merged
+        if (!staleIds.empty())
+        {
+            order.erase(std::remove_if(order.begin(), order.end(), [this](TrackId id) { return staleIds.count(id) > 0; }),
+                order.end());
+        }
+
+        auto before = [this, column](TrackId a, TrackId b) { return isBefore(column, keys[a], a, keys[b], b); };
+
+        std::vector<TrackId> added{ storedIds };
+        std::sort(added.begin(), added.end(), before);
+
+        // find where each one goes by binary search and copy the runs in between
+        std::vector<TrackId> merged;
+        merged.reserve(order.size() + added.size());
+        auto from = order.begin();
+        for (TrackId id : added)
+        {
+            auto at = std::upper_bound(from, order.end(), id, before);
+            merged.insert(merged.end(), from, at);
+            merged.push_back(id);
+            from = at;
+        }
+        merged.insert(merged.end(), from, order.end());
+        order.swap(merged);
+    }
+
+    storedIds.clear();
+    staleIds.clear();
+}
+
+void LibraryView::rebuildRows()
+{
+    updateOrders();
+
+    if (filtered)
+    {
+        filter.erase(std::remove_if(filter.begin(), filter.end(), [this](TrackId id) { return removedIds.count(id) > 0; }),
+            filter.end());
+        rows = filter;
+
+        if (sortColumn != libraryOrder)
+        {
+            buildKeys();
+            int column{ sortColumn };
+            bool forwards{ sortForwards };
+            std::stable_sort(rows.begin(), rows.end(), [this, column, forwards](TrackId a, TrackId b)
+            {
+                return forwards ? isBefore(column, keys[a], a, keys[b], b) : isBefore(column, keys[b], b, keys[a], a);
+            });
+        }
+    }
+    else if (sortColumn == libraryOrder)
+    {
+        rows = store.getTrackIds();
+        if (!sortForwards)
+        {
+            std::reverse(rows.begin(), rows.end());
+        }
+    }
+    else
+    {
+        const std::vector<TrackId>& order{ getOrder(sortColumn) };
+        if (sortForwards)
+        {
+            rows.assign(order.begin(), order.end());
+        }
+        else
+        {
+            rows.assign(order.rbegin(), order.rend());
+        }
+    }
+
+    removedIds.clear();
+}
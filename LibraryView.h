@@ -0,0 +1,137 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "LibraryStore.h"
+#include "KeyIndex.h"
+
+// LibraryView maps the rows of the library table to track ids, so the table only ever
+// asks for the rows it shows and every row keeps pointing at the same track.
+// The rows are the whole library or a search result, in library order or sorted by a
+// column. The order of each column is sorted once and cached, later changes are merged
+// into it. Changes are collected and the rows rebuilt once per message loop turn, so
+// removing or adding many tracks costs one pass over the rows, not one per track.
+class LibraryView : private juce::AsyncUpdater
+{
+public:
+
+    // sortable columns, the same ids as the table columns
+    enum SortColumn
+    {
+        libraryOrder = 0,
+        byTitle = 1,
+        byLength = 2,
+        byArtist = 4,
+        byBpm = 5,
+        byKey = 6
+    };
+
+    LibraryView(LibraryStore& store);
+
+    ~LibraryView() override;
+
+    // purpose : get the number of rows
+    // input : none
+    // output : number of rows
+    int getNumRows();
+
+    // purpose : get the track of a row
+    // input : row
+    // output : id of the track, 0 if the row is out of range or its track was removed
+    TrackId getTrackId(int row);
+
+    // purpose : show only some tracks, or every track again
+    // input : ids of the tracks in their ranked order
+    // output : void
+    void setFilter(std::vector<TrackId> ids);
+    void clearFilter();
+
+    // purpose : sort the rows by a column
+    // input : column, libraryOrder for no sorting, and the direction
+    // output : void
+    void setSort(int column, bool forwards);
+
+    // purpose : follow the changes of the store
+    // input : added or changed track, or the id of a removed one
+    // output : void
+    void songStored(const Song& song);
+    void songRemoved(TrackId id);
+
+    // called on the message thread once the rows were rebuilt after changes
+    std::function<void()> onRowsChanged;
+
+private:
+
+    struct SortKeys
+    {
+        juce::String title;
+        juce::String artist;
+        double lengthInSeconds{ 0.0 };
+        double bpm{ 0.0 };
+        // place on the Camelot wheel, minor before major, -1 without a key
+        int key{ -1 };
+    };
+
+    LibraryStore& store;
+
+    std::vector<TrackId> rows;
+
+    bool filtered{ false };
+    std::vector<TrackId> filter;
+
+    int sortColumn{ libraryOrder };
+    bool sortForwards{ true };
+
+    // sort keys of every track, decoded on the first sort and kept up to date after that
+    std::unordered_map<TrackId, SortKeys> keys;
+    bool keysBuilt{ false };
+
+    // cached orders, ascending, by column
+    std::map<int, std::vector<TrackId>> orders;
+
+    // changes since the rows were rebuilt
+    std::unordered_set<TrackId> removedIds;
+    std::unordered_set<TrackId> staleIds;
+    std::vector<TrackId> storedIds;
+
+    // purpose : rebuild the rows after the changes of this message loop turn
+    // input : none
+    // output : void
+    void handleAsyncUpdate() override;
+
+    // purpose : decode the sort keys of every track
+    // input : none
+    // output : void
+    void buildKeys();
+
+    // purpose : get the sort keys of a track
+    // input : track
+    // output : sort keys
+    static SortKeys getSortKeys(const Song& song);
+
+    // purpose : compare two tracks by a column, ties broken by id
+    // input : column, keys of the tracks and their ids
+    // output : true if a comes first
+    static bool isBefore(int column, const SortKeys& a, TrackId idA, const SortKeys& b, TrackId idB);
+
+    // purpose : get the cached order of a column, sorting it the first time
+    // input : column
+    // output : ids in ascending order
+    const std::vector<TrackId>& getOrder(int column);
+
+    // purpose : bring the changes into the cached orders
+    // input : none
+    // output : void
+    void updateOrders();
+
+    // purpose : rebuild the rows from the filter and the order
+    // input : none
+    // output : void
+    void rebuildRows();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LibraryView)
+};
@@ -0,0 +1,156 @@
+#include "LoudnessAnalyzer.h"
+#include <cmath>
+
+// gating as in BS.1770-4
+static constexpr double absoluteGate = -70.0;
+static constexpr double relativeGate = -10.0;
+static constexpr int stepsPerBlock = 4;
+
+// purpose : turn a power into LUFS
+// input : mean square power
+// output : loudness
+static double powerToLoudness(double power)
+{
+    return power > 0.0 ? -0.691 + 10.0 * std::log10(power) : absoluteGate;
+}
+
+LoudnessAnalyzer::LoudnessAnalyzer(double sampleRate, int _numChannels, int maxBlockSize)
+    : numChannels(juce::jmax(1, _numChannels)),
+    stepSize(juce::jmax(1, (int) std::round(sampleRate / 10.0))),
+    weighted(juce::jmax(1, _numChannels), maxBlockSize),
+    oversampling((size_t) juce::jmax(1, _numChannels), 2, juce::dsp::Oversampling<float>::filterHalfBandFIREquiripple, true, false)
+{
+    // pre-filter, a high shelf of about +4 dB above 1.5 kHz
+    double k{ std::tan(juce::MathConstants<double>::pi * 1681.974450955533 / sampleRate) };
+    double q{ 0.7071752369554196 };
+    double vh{ std::pow(10.0, 3.999843853973347 / 20.0) };
+    double vb{ std::pow(vh, 0.4996667741545416) };
+    juce::IIRCoefficients shelf{ vh + vb * k / q + k * k, 2.0 * (k * k - vh), vh - vb * k / q + k * k,
+                                 1.0 + k / q + k * k, 2.0 * (k * k - 1.0), 1.0 - k / q + k * k };
+
+    // RLB weighting, a high pass at about 38 Hz
+    k = std::tan(juce::MathConstants<double>::pi * 38.13547087602444 / sampleRate);
+    q = 0.5003270373238773;
+    juce::IIRCoefficients highPass{ 1.0, -2.0, 1.0, 1.0 + k / q + k * k, 2.0 * (k * k - 1.0), 1.0 - k / q + k * k };
+
+    shelfFilters.resize((size_t) numChannels);
+    highPassFilters.resize((size_t) numChannels);
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        shelfFilters[(size_t) channel].setCoefficients(shelf);
+        highPassFilters[(size_t) channel].setCoefficients(highPass);
+
+        // L R C LFE Ls Rs
+        bool surround{ numChannels >= 6 && channel >= 4 };
+        bool lfe{ numChannels >= 6 && channel == 3 };
+        channelWeights.push_back(lfe ? 0.0 : (surround ? 1.41 : 1.0));
+    }
+
+    oversampling.initProcessing((size_t) maxBlockSize);
+}
+
+LoudnessAnalyzer::~LoudnessAnalyzer()
+{
+}
+
+void LoudnessAnalyzer::process(const juce::AudioBuffer<float>& buffer, int numSamples)
+{
+    int channels{ juce::jmin(numChannels, buffer.getNumChannels()) };
+    numSamples = juce::jmin(numSamples, weighted.getNumSamples());
+
+    // true peak from the oversampled signal
+    {
+        juce::dsp::AudioBlock<const float> block{ buffer.getArrayOfReadPointers(), (size_t) channels, (size_t) numSamples };
+        juce::dsp::AudioBlock<float> upsampled{ oversampling.processSamplesUp(block) };
+        for (size_t channel = 0; channel < upsampled.getNumChannels(); ++channel)
+        {
+            auto range{ juce::FloatVectorOperations::findMinAndMax(upsampled.getChannelPointer(channel), (int) upsampled.getNumSamples()) };
+            peak = juce::jmax(peak, -range.getStart(), range.getEnd());
+        }
+    }
+
+    for (int channel = 0; channel < channels; ++channel)
+    {
+        float* samples{ weighted.getWritePointer(channel) };
+        juce::FloatVectorOperations::copy(samples, buffer.getReadPointer(channel), numSamples);
+        shelfFilters[(size_t) channel].processSamples(samples, numSamples);
+        highPassFilters[(size_t) channel].processSamples(samples, numSamples);
+    }
+
+    // sum the weighted squares a step at a time
+    int position{ 0 };
+    while (position < numSamples)
+    {
+        int length{ juce::jmin(stepSize - stepFill, numSamples - position) };
+        for (int channel = 0; channel < channels; ++channel)
+        {
+            const float* samples{ weighted.getReadPointer(channel) + position };
+            double sum{ 0.0 };
+            for (int i = 0; i < length; ++i)
+            {
+                sum += samples[i] * samples[i];
+            }
+            stepSum += channelWeights[(size_t) channel] * sum;
+        }
+
+        position += length;
+        stepFill += length;
+        if (stepFill == stepSize)
+        {
+            stepPowers.push_back(stepSum / stepSize);
+            stepSum = 0.0;
+            stepFill = 0;
+        }
+    }
+}
+
+double LoudnessAnalyzer::getLoudness()
+{
+    // 400 ms blocks overlapping by 75 %
+    std::vector<double> blockPowers;
+    for (size_t step = stepsPerBlock - 1; step < stepPowers.size(); ++step)
+    {
+        double power{ 0.0 };
+        for (size_t i = 0; i < stepsPerBlock; ++i)
+        {
+            power += stepPowers[step - i];
+        }
+        power /= stepsPerBlock;
+
+        if (powerToLoudness(power) > absoluteGate)
+        {
+            blockPowers.push_back(power);
+        }
+    }
+
+    if (blockPowers.empty())
+    {
+        return absoluteGate;
+    }
+
+    double mean{ 0.0 };
+    for (double power : blockPowers)
+    {
+        mean += power;
+    }
+    mean /= blockPowers.size();
+
+    double gate{ powerToLoudness(mean) + relativeGate };
+    double gatedSum{ 0.0 };
+    int gatedBlocks{ 0 };
+    for (double power : blockPowers)
+    {
+        if (powerToLoudness(power) > gate)
+        {
+            gatedSum += power;
+            ++gatedBlocks;
+        }
+    }
+
+    return gatedBlocks > 0 ? powerToLoudness(gatedSum / gatedBlocks) : absoluteGate;
+}
+
+double LoudnessAnalyzer::getTruePeak()
+{
+    return peak > 0.0f ? juce::jmax(absoluteGate, 20.0 * std::log10((double) peak)) : absoluteGate;
+}
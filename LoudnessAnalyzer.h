@@ -0,0 +1,58 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+// LoudnessAnalyzer measures the integrated loudness and true peak of a track as in
+// EBU R128 / ITU-R BS.1770, fed block by block with every channel while the track is decoded.
+// Each channel is K-weighted and its mean square taken every 100 ms, the 400 ms gating blocks
+// are made of four of those, and the loudness is the mean of the blocks that pass the
+// absolute gate at -70 LUFS and the relative gate 10 LU below the mean of those.
+// The true peak is the highest sample after four times oversampling.
+class LoudnessAnalyzer
+{
+public:
+
+    LoudnessAnalyzer(double sampleRate, int numChannels, int maxBlockSize);
+
+    ~LoudnessAnalyzer();
+
+    // purpose : add the next samples of the track
+    // input : samples of every channel, number of samples
+    // output : void
+    void process(const juce::AudioBuffer<float>& buffer, int numSamples);
+
+    // purpose : get the integrated loudness of everything processed
+    // input : none
+    // output : LUFS, -70 for silence or a track shorter than one gating block
+    double getLoudness();
+
+    // purpose : get the true peak of everything processed
+    // input : none
+    // output : dBTP, -70 for silence
+    double getTruePeak();
+
+private:
+
+    int numChannels;
+    int stepSize;
+
+    // weight of every channel, the LFE channel of a 5.1 track counts for nothing
+    std::vector<double> channelWeights;
+
+    // K-weighting, a high shelf and a high pass per channel
+    std::vector<juce::IIRFilter> shelfFilters;
+    std::vector<juce::IIRFilter> highPassFilters;
+
+    juce::AudioBuffer<float> weighted;
+    juce::dsp::Oversampling<float> oversampling;
+
+    // weighted mean square of the current 100 ms step, and the samples in it
+    double stepSum{ 0.0 };
+    int stepFill{ 0 };
+
+    // power of every 100 ms step
+    std::vector<double> stepPowers;
+
+    float peak{ 0.0f };
+};
@@ -1,5 +1,7 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "MainComponent.h"
+#include "LibraryBenchmark.h"
+#include "ResamplerCheck.h"
 
 //==============================================================================
 class OtoDecksApplication  : public JUCEApplication
@@ -16,6 +18,14 @@ public:
     {
         // This method is where you should put your application's initialisation code..
 
+        // benchmarks run without a window and quit when they are done
+        if (LibraryBenchmark::runFromCommandLine (commandLine)
+            || ResamplerCheck::runFromCommandLine (commandLine))
+        {
+            quit();
+            return;
+        }
+
         mainWindow.reset (new MainWindow (getApplicationName()));
     }
 
@@ -15,48 +15,90 @@ MainComponent::MainComponent()
     // you add any child components.
     setSize (800, 700);
 
+    // the decks are in the mixer before the device prepares it
+    deckMixer.addDeck(&player1);
+    deckMixer.addDeck(&player2);
+    deckMixer.setCueChannels(appSettings.getProperties().getIntValue("cue.firstChannel", 2));
+
     // Some platforms require permissions to open input channels so request that here
     if (RuntimePermissions::isRequired (RuntimePermissions::recordAudio)
         && ! RuntimePermissions::isGranted (RuntimePermissions::recordAudio))
     {
         RuntimePermissions::request (RuntimePermissions::recordAudio,
-                                     [&] (bool granted) { if (granted)  setAudioChannels (2, 2); });
+                                     [&] (bool granted) { if (granted)  setAudioChannels (2, 4); });
     }  
     else
     {
         // Specify the number of input and output channels that we want to open
-        setAudioChannels (0, 2);
+        // outputs 1-2 carry the master bus, 3-4 the cue bus
+        setAudioChannels (0, 4);
     }  
 
+    addAndMakeVisible(cueMixSlider);
+    cueMixSlider.setRange(0.0, 1.0, 0.01);
+    cueMixSlider.setValue(0.0);
+    cueMixSlider.setTextBoxStyle(Slider::NoTextBox, false, 0, 0);
+    cueMixSlider.onValueChange = [this] { deckMixer.setCueMix(cueMixSlider.getValue()); };
+
+    addAndMakeVisible(cueMixLabel);
+    cueMixLabel.setText("Cue / Master", dontSendNotification);
+    cueMixLabel.setJustificationType(Justification::centredRight);
+
+    addAndMakeVisible(crossfaderSlider);
+    crossfaderSlider.setRange(0.0, 1.0, 0.01);
+    crossfaderSlider.setValue(0.5);
+    crossfaderSlider.setTextBoxStyle(Slider::NoTextBox, false, 0, 0);
+    crossfaderSlider.onValueChange = [this] { deckMixer.setCrossfader(crossfaderSlider.getValue()); };
+
+    addAndMakeVisible(crossfaderLabel);
+    crossfaderLabel.setText("Crossfader", dontSendNotification);
+    crossfaderLabel.setJustificationType(Justification::centredRight);
+
+    addAndMakeVisible(midiLearnButton);
+    midiLearnButton.onClick = [this] { showMidiLearnMenu(); };
+    midiController.onLearned = [this] { midiLearnButton.setButtonText("MIDI LEARN"); };
+
     addAndMakeVisible(deckGUI1); 
     addAndMakeVisible(deckGUI2);
+
+    // paint time of the waveforms, for finding slow drawing
+    bool showPaintTime{ appSettings.getProperties().getBoolValue("debug.paintTimes", false) };
+    deckGUI1.setShowPaintTime(showPaintTime);
+    deckGUI2.setShowPaintTime(showPaintTime);
     addAndMakeVisible(playlistComponent);
 
-    formatManager.registerBasicFormats();
+    // the overlay goes on top, it shows itself when profiling
+    addChildComponent(profilerOverlay);
+    profilerOverlay.setProfiling(appSettings.getProperties().getBoolValue("debug.frameProfiler", false));
+
+    deckWorkerThread.startThread(Thread::Priority::high);
 }
 
 MainComponent::~MainComponent()
 {
     // This shuts down the audio device and clears the audio source.
     shutdownAudio();
+    deckWorkerThread.stopThread(500);
 }
 
 //==============================================================================
 void MainComponent::prepareToPlay (int samplesPerBlockExpected, double sampleRate)
 {
-    mixerSource.addInputSource(&player1, false);
-    mixerSource.addInputSource(&player2, false);
-    player1.prepareToPlay(samplesPerBlockExpected, sampleRate);
-    player2.prepareToPlay(samplesPerBlockExpected, sampleRate);
-    
-    mixerSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
-
-    
+    // prepares both decks as well
+    deckMixer.prepareToPlay(samplesPerBlockExpected, sampleRate);
 
+    AudioIODevice* device{ deviceManager.getCurrentAudioDevice() };
+    midiController.prepareToPlay(samplesPerBlockExpected, sampleRate,
+                                 device != nullptr ? device->getOutputLatencyInSamples() : 0);
  }
 void MainComponent::getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill)
 {
-    mixerSource.getNextAudioBlock(bufferToFill);
+    // only does work the first time the device's callback thread gets here
+    threadConfig.applyToCurrentThread(ThreadConfig::Role::audio);
+
+    // controller moves since the last block, before the decks render
+    midiController.processEvents();
+    deckMixer.getNextAudioBlock(bufferToFill);
 }
 
 void MainComponent::releaseResources()
@@ -65,9 +107,7 @@ void MainComponent::releaseResources()
     // restarted due to a setting change.
 
     // For more details, see the help for AudioProcessor::releaseResources()
-    player1.releaseResources();
-    player2.releaseResources();
-    mixerSource.releaseResources();
+    deckMixer.releaseResources();
 }
 
 //==============================================================================
@@ -84,10 +124,49 @@ void MainComponent::paint (Graphics& g)
 
 void MainComponent::resized()
 {
+    int cueRowH = 24;
     deckGUI1.setBounds(0, 0, getWidth()/2, getHeight() *0.6);
     deckGUI2.setBounds(getWidth()/2, 0, getWidth()/2, getHeight() *0.6);
-    playlistComponent.setBounds(0, getHeight()*0.6, getWidth(), getHeight()*0.4);
+    cueMixLabel.setBounds(0, getHeight()*0.6, getWidth()/8, cueRowH);
+    cueMixSlider.setBounds(getWidth()/8, getHeight()*0.6, getWidth()/4, cueRowH);
+    crossfaderLabel.setBounds(getWidth()*3/8, getHeight()*0.6, getWidth()/8, cueRowH);
+    crossfaderSlider.setBounds(getWidth()/2, getHeight()*0.6, getWidth()*3/8, cueRowH);
+    midiLearnButton.setBounds(getWidth()*7/8, getHeight()*0.6, getWidth()/8, cueRowH);
+    playlistComponent.setBounds(0, getHeight()*0.6 + cueRowH, getWidth(), getHeight()*0.4 - cueRowH);
+    profilerOverlay.setBounds(getWidth() / 2, getHeight() * 0.6 + cueRowH, getWidth() / 2, getHeight() * 0.4 - cueRowH);
    
 }
 
-
+void MainComponent::showMidiLearnMenu()
+{
+    if (midiController.isLearning())
+    {
+        midiController.cancelLearning();
+        midiLearnButton.setButtonText("MIDI LEARN");
+        return;
+    }
+
+    // item ids are control numbers plus one, 0 is taken by a dismissed menu
+    const int clearId{ MidiController::numControls + 1 };
+    PopupMenu menu;
+    for (int control = 0; control < MidiController::numControls; ++control)
+    {
+        menu.addItem(control + 1, MidiController::getControlName(control));
+    }
+    menu.addSeparator();
+    menu.addItem(clearId, "Clear mappings");
+
+    menu.showMenuAsync(PopupMenu::Options().withTargetComponent(&midiLearnButton),
+        [this, clearId](int result)
+        {
+            if (result == clearId)
+            {
+                midiController.clearMappings();
+            }
+            else if (result > 0)
+            {
+                midiController.learn(result - 1);
+                midiLearnButton.setButtonText("MOVE A CONTROL");
+            }
+        });
+}
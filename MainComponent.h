@@ -12,6 +12,14 @@
 #include "DJAudioPlayer.h"
 #include "DeckGUI.h"
 #include "PlaylistComponent.h"
+#include "AppSettings.h"
+#include "ThreadConfig.h"
+#include "DeckMixer.h"
+#include "AnalysisStore.h"
+#include "DiskThumbnailCache.h"
+#include "WaveformLoader.h"
+#include "FrameProfilerOverlay.h"
+#include "MidiController.h"
 
 
 //==============================================================================
@@ -39,18 +47,37 @@ private:
     //==============================================================================
     // Your private member variables go here...
      
-    AudioFormatManager formatManager;
-    AudioThumbnailCache thumbCache{100};
+    // user settings and the thread priorities/cpu sets they ask for
+    AppSettings appSettings;
+    ThreadConfig threadConfig{ appSettings };
+
+    // reads the decks' files ahead of the audio thread
+    ConfiguredTimeSliceThread deckWorkerThread{ "Deck read-ahead", threadConfig, ThreadConfig::Role::deckWorker };
+
+    // the formats are registered before any member below asks for them, the folder watcher
+    // takes its file extensions when it is made
+    struct BasicFormatManager : public AudioFormatManager
+    {
+        BasicFormatManager() { registerBasicFormats(); }
+    };
+    BasicFormatManager formatManager;
+
+    // results of the analyzers and waveform overviews, keyed by file content
+    AnalysisStore analysisStore{ appSettings.getDataDirectory().getChildFile("analysis"),
+                                 (juce::int64) appSettings.getProperties().getIntValue("analysis.maxSizeMB", 2048) * 1024 * 1024 };
+    DiskThumbnailCache thumbCache{ analysisStore, 100 };
+
+    // detailed waveforms of the decks for zooming
+    WaveformLoader waveformLoader{ formatManager, threadConfig, analysisStore };
 
     FilterController soundController;
 
-    DJAudioPlayer player1{ formatManager };
-    DJAudioPlayer player2{ formatManager };
-    DJAudioPlayer playerForParsingMetaData{ formatManager };
+    DJAudioPlayer player1{ formatManager, deckWorkerThread };
+    DJAudioPlayer player2{ formatManager, deckWorkerThread };
 
-    DeckGUI deckGUI1{ 1, &player1, formatManager, thumbCache,soundController };
-    DeckGUI deckGUI2{ 2, &player2, formatManager, thumbCache,soundController };
-    PlaylistComponent playlistComponent{ &deckGUI1, &deckGUI2, &playerForParsingMetaData };
+    DeckGUI deckGUI1{ 1, &player1, formatManager, thumbCache, waveformLoader, soundController };
+    DeckGUI deckGUI2{ 2, &player2, formatManager, thumbCache, waveformLoader, soundController };
+    PlaylistComponent playlistComponent{ &deckGUI1, &deckGUI2, formatManager, threadConfig, analysisStore, appSettings };
 
    /* DJAudioPlayer player1{formatManager};
     DeckGUI deckGUI1{&player1, formatManager, thumbCache}; 
@@ -58,6 +85,27 @@ private:
     DJAudioPlayer player2{formatManager};
     DeckGUI deckGUI2{&player2, formatManager, thumbCache}; */
 
-    MixerAudioSource mixerSource;
+    // master and cue buses
+    DeckMixer deckMixer;
+
+    // blend of the cue bus between the cued decks and the master mix
+    Slider cueMixSlider;
+    Label cueMixLabel;
+
+    // blend of the decks on the master bus
+    Slider crossfaderSlider;
+    Label crossfaderLabel;
+
+    // controllers play the decks and the mixer straight from the audio thread
+    MidiController midiController{ player1, player2, deckMixer, appSettings };
+    TextButton midiLearnButton{ "MIDI LEARN" };
+
+    // purpose : choose a control to learn from a controller, or stop learning
+    // input : none
+    // output : void
+    void showMidiLearnMenu();
+
+    // paint times and message thread load, shown over everything when profiling
+    FrameProfilerOverlay profilerOverlay;
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainComponent)
 };
@@ -0,0 +1,130 @@
+#include "MetadataCache.h"
+#include <cstring>
+
+static constexpr int cacheVersion = 1;
+
+MetadataCache::MetadataCache(const juce::File& cacheFile)
+    : file(cacheFile)
+{
+}
+
+MetadataCache::~MetadataCache()
+{
+    save();
+}
+
+bool MetadataCache::lookup(const juce::File& audioFile, juce::int64 size, juce::int64 modificationTime, TrackMetadata& metadata)
+{
+    const juce::ScopedLock scopedLock(lock);
+    loadIfNeeded();
+
+    auto it = entries.find(audioFile.getFullPathName());
+    if (it == entries.end() || it->second.size != size || it->second.modificationTime != modificationTime)
+    {
+        return false;
+    }
+
+    metadata = it->second.metadata;
+    return true;
+}
+
+void MetadataCache::store(const juce::File& audioFile, juce::int64 size, juce::int64 modificationTime, const TrackMetadata& metadata)
+{
+    const juce::ScopedLock scopedLock(lock);
+    loadIfNeeded();
+
+    Entry& entry{ entries[audioFile.getFullPathName()] };
+    entry.size = size;
+    entry.modificationTime = modificationTime;
+    entry.metadata = metadata;
+    dirty = true;
+}
+
+void MetadataCache::save()
+{
+    const juce::ScopedLock scopedLock(lock);
+    if (!dirty)
+    {
+        return;
+    }
+
+    juce::TemporaryFile temp{ file };
+    {
+        juce::FileOutputStream out{ temp.getFile() };
+        if (out.failedToOpen())
+        {
+            std::cerr << "MetadataCache: can't write " << file.getFullPathName() << std::endl;
+            return;
+        }
+
+        out.write("OTMC", 4);
+        out.writeInt(cacheVersion);
+        out.writeInt64((juce::int64) entries.size());
+
+        for (const auto& item : entries)
+        {
+            const Entry& entry{ item.second };
+            out.writeString(item.first);
+            out.writeInt64(entry.size);
+            out.writeInt64(entry.modificationTime);
+            out.writeDouble(entry.metadata.lengthInSeconds);
+            out.writeDouble(entry.metadata.sampleRate);
+            out.writeInt(entry.metadata.numChannels);
+            out.writeInt(entry.metadata.bitrate);
+            out.writeString(entry.metadata.title);
+            out.writeString(entry.metadata.artist);
+            out.writeString(entry.metadata.album);
+        }
+    }
+
+    if (temp.overwriteTargetFileWithTemporary())
+    {
+        dirty = false;
+    }
+}
+
+void MetadataCache::loadIfNeeded()
+{
+    if (loaded)
+    {
+        return;
+    }
+    loaded = true;
+
+    juce::FileInputStream in{ file };
+    if (in.failedToOpen())
+    {
+        return;
+    }
+
+    char magic[4] = {};
+    if (in.read(magic, 4) != 4 || std::memcmp(magic, "OTMC", 4) != 0 || in.readInt() != cacheVersion)
+    {
+        std::cerr << "MetadataCache: ignoring " << file.getFullPathName() << ", unknown format" << std::endl;
+        return;
+    }
+
+    // a damaged count can't ask for more entries than the rest of the file could hold, the
+    // smallest entry is four empty strings and the six numbers
+    const juce::int64 minEntrySize{ 4 + 4 * 8 + 2 * 4 };
+    juce::int64 count{ in.readInt64() };
+    count = juce::jlimit((juce::int64) 0, in.getNumBytesRemaining() / minEntrySize, count);
+    entries.reserve((size_t) count);
+
+    for (juce::int64 i = 0; i < count && !in.isExhausted(); ++i)
+    {
+        juce::String path{ in.readString() };
+        Entry entry;
+        entry.size = in.readInt64();
+        entry.modificationTime = in.readInt64();
+        entry.metadata.lengthInSeconds = in.readDouble();
+        entry.metadata.sampleRate = in.readDouble();
+        entry.metadata.numChannels = in.readInt();
+        entry.metadata.bitrate = in.readInt();
+        entry.metadata.title = in.readString();
+        entry.metadata.artist = in.readString();
+        entry.metadata.album = in.readString();
+        entry.metadata.valid = true;
+        entries[path] = std::move(entry);
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <unordered_map>
+#include "MetadataProbe.h"
+
+// MetadataCache remembers the probed metadata of files, keyed by path and checked
+// against the size and modification time, so unchanged files are never probed twice.
+// It is safe to use from the import threads.
+class MetadataCache
+{
+public:
+
+    MetadataCache(const juce::File& cacheFile);
+
+    ~MetadataCache();
+
+    // purpose : get the cached metadata of a file
+    // input : file, its current size and modification time (ms), metadata to fill
+    // output : true if the file is cached and unchanged
+    bool lookup(const juce::File& file, juce::int64 size, juce::int64 modificationTime, TrackMetadata& metadata);
+
+    // purpose : cache the metadata of a file
+    // input : file, its size and modification time (ms), metadata
+    // output : void
+    void store(const juce::File& file, juce::int64 size, juce::int64 modificationTime, const TrackMetadata& metadata);
+
+    // purpose : write the cache to disk if it changed
+    // input : none
+    // output : void
+    void save();
+
+private:
+
+    struct Entry
+    {
+        juce::int64 size{ 0 };
+        juce::int64 modificationTime{ 0 };
+        TrackMetadata metadata;
+    };
+
+    struct StringHash
+    {
+        size_t operator()(const juce::String& text) const noexcept { return (size_t) text.hashCode64(); }
+    };
+
+    juce::File file;
+    juce::CriticalSection lock;
+    std::unordered_map<juce::String, Entry, StringHash> entries;
+    bool loaded{ false };
+    bool dirty{ false };
+
+    // purpose : read the cache file on first use
+    // input : none
+    // output : void
+    void loadIfNeeded();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MetadataCache)
+};
@@ -0,0 +1,692 @@
+#include "MetadataProbe.h"
+#include <cmath>
+#include <cstring>
+
+// the largest tag block or frame that is read, anything bigger is cover art
+static constexpr size_t maxTagBlockSize = 1 << 20;
+
+// purpose : read an unsigned 24 bit big endian size
+// input : 3 bytes
+// output : value
+static juce::int64 bigEndian24(const void* data)
+{
+    const juce::uint8* bytes{ static_cast<const juce::uint8*>(data) };
+    return (bytes[0] << 16) | (bytes[1] << 8) | bytes[2];
+}
+
+// purpose : read text that may be utf-8 or latin-1
+// input : bytes, stops at the first zero
+// output : text
+static juce::String textFromBytes(const char* data, size_t size)
+{
+    size_t length{ 0 };
+    while (length < size && data[length] != 0)
+    {
+        ++length;
+    }
+
+    if (juce::CharPointer_UTF8::isValidString(data, (int) length))
+    {
+        return juce::String::fromUTF8(data, (int) length).trim();
+    }
+
+    juce::String text;
+    for (size_t i = 0; i < length; ++i)
+    {
+        text += (juce::juce_wchar) (juce::uint8) data[i];
+    }
+    return text.trim();
+}
+
+// purpose : read utf-16 text
+// input : bytes, byte order
+// output : text
+static juce::String textFromUtf16(const char* data, size_t size, bool bigEndian)
+{
+    const juce::uint8* bytes{ reinterpret_cast<const juce::uint8*>(data) };
+    auto unitAt = [&](size_t i) { return bigEndian ? (juce::uint32) (bytes[i] << 8 | bytes[i + 1])
+                                                   : (juce::uint32) (bytes[i + 1] << 8 | bytes[i]); };
+
+    juce::String text;
+    for (size_t i = 0; i + 1 < size; i += 2)
+    {
+        juce::uint32 unit{ unitAt(i) };
+        if (unit == 0)
+        {
+            break;
+        }
+        if (unit >= 0xd800 && unit < 0xdc00 && i + 3 < size)
+        {
+            juce::uint32 low{ unitAt(i + 2) };
+            unit = 0x10000 + ((unit - 0xd800) << 10) + (low - 0xdc00);
+            i += 2;
+        }
+        text += (juce::juce_wchar) unit;
+    }
+    return text.trim();
+}
+
+TrackMetadata MetadataProbe::probe(const juce::File& file)
+{
+    TrackMetadata metadata;
+
+    juce::FileInputStream in{ file };
+    if (in.failedToOpen())
+    {
+        return metadata;
+    }
+
+    char magic[12] = {};
+    in.read(magic, 12);
+    in.setPosition(0);
+
+    // an id3v2 tag can sit in front of mp3 and flac data
+    if (std::memcmp(magic, "ID3", 3) == 0)
+    {
+        juce::int64 audioStart{ readId3v2(in, metadata) };
+        in.setPosition(audioStart);
+        std::memset(magic, 0, sizeof(magic));
+        in.read(magic, 12);
+        in.setPosition(audioStart);
+    }
+
+    if (std::memcmp(magic, "RIFF", 4) == 0 && std::memcmp(magic + 8, "WAVE", 4) == 0)
+    {
+        metadata.valid = probeWav(in, metadata);
+    }
+    else if (std::memcmp(magic, "FORM", 4) == 0
+             && (std::memcmp(magic + 8, "AIFF", 4) == 0 || std::memcmp(magic + 8, "AIFC", 4) == 0))
+    {
+        metadata.valid = probeAiff(in, metadata);
+    }
+    else if (std::memcmp(magic, "fLaC", 4) == 0)
+    {
+        metadata.valid = probeFlac(in, metadata);
+    }
+    else if (std::memcmp(magic, "OggS", 4) == 0)
+    {
+        metadata.valid = probeOgg(in, metadata);
+    }
+    else
+    {
+        metadata.valid = probeMp3(in, metadata);
+    }
+
+    metadata.valid = metadata.valid && metadata.sampleRate > 0 && metadata.lengthInSeconds > 0;
+    if (metadata.valid)
+    {
+        estimateBitrate(in.getTotalLength(), metadata);
+    }
+    return metadata;
+}
+
+bool MetadataProbe::probeWav(juce::FileInputStream& in, TrackMetadata& metadata)
+{
+    int blockAlign{ 0 };
+    juce::int64 dataSize{ -1 };
+    char header[8];
+
+    in.setPosition(in.getPosition() + 12);
+    while (in.read(header, 8) == 8)
+    {
+        juce::int64 chunkSize{ (juce::int64) juce::ByteOrder::littleEndianInt(header + 4) };
+        juce::int64 chunkStart{ in.getPosition() };
+
+        if (std::memcmp(header, "fmt ", 4) == 0 && chunkSize >= 16)
+        {
+            char format[16];
+            in.read(format, 16);
+            metadata.numChannels = juce::ByteOrder::littleEndianShort(format + 2);
+            metadata.sampleRate = juce::ByteOrder::littleEndianInt(format + 4);
+            metadata.bitrate = (int) (juce::ByteOrder::littleEndianInt(format + 8) * 8 / 1000);
+            blockAlign = juce::ByteOrder::littleEndianShort(format + 12);
+        }
+        else if (std::memcmp(header, "data", 4) == 0)
+        {
+            // streamed files leave the size at its maximum
+            dataSize = juce::jmin(chunkSize, in.getTotalLength() - chunkStart);
+        }
+        else if (std::memcmp(header, "LIST", 4) == 0 && chunkSize >= 4 && (size_t) chunkSize < maxTagBlockSize)
+        {
+            juce::MemoryBlock list;
+            in.readIntoMemoryBlock(list, (ssize_t) chunkSize);
+            const char* data{ static_cast<const char*>(list.getData()) };
+
+            if (list.getSize() >= 4 && std::memcmp(data, "INFO", 4) == 0)
+            {
+                size_t position{ 4 };
+                while (position + 8 <= list.getSize())
+                {
+                    size_t size{ juce::ByteOrder::littleEndianInt(data + position + 4) };
+                    const char* text{ data + position + 8 };
+                    size = juce::jmin(size, list.getSize() - position - 8);
+
+                    if (std::memcmp(data + position, "INAM", 4) == 0)
+                    {
+                        metadata.title = textFromBytes(text, size);
+                    }
+                    else if (std::memcmp(data + position, "IART", 4) == 0)
+                    {
+                        metadata.artist = textFromBytes(text, size);
+                    }
+                    else if (std::memcmp(data + position, "IPRD", 4) == 0)
+                    {
+                        metadata.album = textFromBytes(text, size);
+                    }
+                    position += 8 + size + (size & 1);
+                }
+            }
+        }
+
+        // chunks are padded to an even size
+        if (!in.setPosition(chunkStart + chunkSize + (chunkSize & 1)))
+        {
+            break;
+        }
+    }
+
+    if (blockAlign <= 0 || dataSize < 0 || metadata.sampleRate <= 0)
+    {
+        return false;
+    }
+
+    metadata.lengthInSeconds = (dataSize / blockAlign) / metadata.sampleRate;
+    return true;
+}
+
+bool MetadataProbe::probeAiff(juce::FileInputStream& in, TrackMetadata& metadata)
+{
+    juce::uint32 numFrames{ 0 };
+    int bitsPerSample{ 0 };
+    char header[8];
+
+    in.setPosition(in.getPosition() + 12);
+    while (in.read(header, 8) == 8)
+    {
+        juce::int64 chunkSize{ (juce::int64) juce::ByteOrder::bigEndianInt(header + 4) };
+        juce::int64 chunkStart{ in.getPosition() };
+
+        if (std::memcmp(header, "COMM", 4) == 0 && chunkSize >= 18)
+        {
+            char common[18];
+            in.read(common, 18);
+            metadata.numChannels = juce::ByteOrder::bigEndianShort(common);
+            numFrames = juce::ByteOrder::bigEndianInt(common + 2);
+            bitsPerSample = juce::ByteOrder::bigEndianShort(common + 6);
+            metadata.sampleRate = readExtended(common + 8);
+        }
+        else if ((std::memcmp(header, "NAME", 4) == 0 || std::memcmp(header, "AUTH", 4) == 0)
+                 && (size_t) chunkSize < maxTagBlockSize)
+        {
+            juce::MemoryBlock text;
+            in.readIntoMemoryBlock(text, (ssize_t) chunkSize);
+            juce::String value{ textFromBytes(static_cast<const char*>(text.getData()), text.getSize()) };
+
+            if (header[0] == 'N')
+            {
+                metadata.title = value;
+            }
+            else
+            {
+                metadata.artist = value;
+            }
+        }
+
+        if (!in.setPosition(chunkStart + chunkSize + (chunkSize & 1)))
+        {
+            break;
+        }
+    }
+
+    if (metadata.sampleRate <= 0)
+    {
+        return false;
+    }
+
+    metadata.lengthInSeconds = numFrames / metadata.sampleRate;
+    metadata.bitrate = (int) (metadata.sampleRate * metadata.numChannels * bitsPerSample / 1000);
+    return true;
+}
+
+bool MetadataProbe::probeFlac(juce::FileInputStream& in, TrackMetadata& metadata)
+{
+    juce::uint64 totalSamples{ 0 };
+    bool lastBlock{ false };
+
+    in.setPosition(in.getPosition() + 4);
+    while (!lastBlock)
+    {
+        char header[4];
+        if (in.read(header, 4) != 4)
+        {
+            break;
+        }
+
+        lastBlock = (header[0] & 0x80) != 0;
+        int type{ header[0] & 0x7f };
+        juce::int64 size{ bigEndian24(header + 1) };
+        juce::int64 blockStart{ in.getPosition() };
+
+        if (type == 0 && size >= 18)
+        {
+            // STREAMINFO
+            juce::uint8 info[18];
+            in.read(info, 18);
+            metadata.sampleRate = (info[10] << 12) | (info[11] << 4) | (info[12] >> 4);
+            metadata.numChannels = ((info[12] >> 1) & 7) + 1;
+            totalSamples = ((juce::uint64) (info[13] & 0x0f) << 32) | juce::ByteOrder::bigEndianInt(info + 14);
+        }
+        else if (type == 4 && (size_t) size < maxTagBlockSize)
+        {
+            // VORBIS_COMMENT
+            juce::MemoryBlock comment;
+            in.readIntoMemoryBlock(comment, (ssize_t) size);
+            parseVorbisComment(static_cast<const char*>(comment.getData()), comment.getSize(), metadata);
+        }
+
+        if (!in.setPosition(blockStart + size))
+        {
+            break;
+        }
+    }
+
+    if (metadata.sampleRate <= 0)
+    {
+        return false;
+    }
+
+    metadata.lengthInSeconds = totalSamples / metadata.sampleRate;
+    return true;
+}
+
+bool MetadataProbe::probeOgg(juce::FileInputStream& in, TrackMetadata& metadata)
+{
+    juce::int64 fileSize{ in.getTotalLength() };
+
+    // the identification and comment packets are in the first pages
+    juce::MemoryBlock head;
+    in.readIntoMemoryBlock(head, (ssize_t) juce::jmin((juce::int64) maxTagBlockSize, fileSize));
+    const char* data{ static_cast<const char*>(head.getData()) };
+    size_t size{ head.getSize() };
+
+    std::vector<juce::MemoryBlock> packets;
+    juce::MemoryOutputStream packet;
+    size_t position{ 0 };
+
+    while (packets.size() < 2 && position + 27 <= size && std::memcmp(data + position, "OggS", 4) == 0)
+    {
+        int numSegments{ (juce::uint8) data[position + 26] };
+        const char* segments{ data + position + 27 };
+        size_t payload{ position + 27 + numSegments };
+
+        if (payload > size)
+        {
+            break;
+        }
+
+        for (int i = 0; i < numSegments && packets.size() < 2; ++i)
+        {
+            size_t lacing{ (juce::uint8) segments[i] };
+            if (payload + lacing > size)
+            {
+                break;
+            }
+            packet.write(data + payload, lacing);
+            payload += lacing;
+
+            // a lacing value under 255 ends the packet
+            if (lacing < 255)
+            {
+                packets.push_back(packet.getMemoryBlock());
+                packet.reset();
+            }
+        }
+        position = payload;
+    }
+
+    if (packets.empty() || packets[0].getSize() < 28 || std::memcmp(packets[0].getData(), "\x01vorbis", 7) != 0)
+    {
+        return false;
+    }
+
+    const char* identification{ static_cast<const char*>(packets[0].getData()) };
+    metadata.numChannels = (juce::uint8) identification[11];
+    metadata.sampleRate = juce::ByteOrder::littleEndianInt(identification + 12);
+    int nominalBitrate{ (int) juce::ByteOrder::littleEndianInt(identification + 20) };
+    if (nominalBitrate > 0)
+    {
+        metadata.bitrate = nominalBitrate / 1000;
+    }
+
+    if (packets.size() > 1 && packets[1].getSize() > 7 && std::memcmp(packets[1].getData(), "\x03vorbis", 7) == 0)
+    {
+        parseVorbisComment(static_cast<const char*>(packets[1].getData()) + 7, packets[1].getSize() - 7, metadata);
+    }
+
+    // the granule position of the last page is the number of samples
+    juce::int64 tailStart{ juce::jmax((juce::int64) 0, fileSize - 65536) };
+    juce::MemoryBlock tail;
+    in.setPosition(tailStart);
+    in.readIntoMemoryBlock(tail, (ssize_t) (fileSize - tailStart));
+    const char* tailData{ static_cast<const char*>(tail.getData()) };
+
+    for (juce::int64 i = (juce::int64) tail.getSize() - 27; i >= 0; --i)
+    {
+        if (std::memcmp(tailData + i, "OggS", 4) == 0)
+        {
+            juce::int64 granule{ (juce::int64) juce::ByteOrder::littleEndianInt64(tailData + i + 6) };
+            if (granule > 0 && metadata.sampleRate > 0)
+            {
+                metadata.lengthInSeconds = granule / metadata.sampleRate;
+            }
+            break;
+        }
+    }
+
+    return metadata.sampleRate > 0;
+}
+
+bool MetadataProbe::probeMp3(juce::FileInputStream& in, TrackMetadata& metadata)
+{
+    static const int bitrates[5][15] = {
+        { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 }, // mpeg 1 layer 1
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },    // mpeg 1 layer 2
+        { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 },     // mpeg 1 layer 3
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },    // mpeg 2 layer 1
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 }          // mpeg 2 layers 2 and 3
+    };
+    static const int sampleRates[3][3] = {
+        { 44100, 48000, 32000 }, // mpeg 1
+        { 22050, 24000, 16000 }, // mpeg 2
+        { 11025, 12000, 8000 }   // mpeg 2.5
+    };
+
+    juce::int64 start{ in.getPosition() };
+    juce::int64 fileSize{ in.getTotalLength() };
+
+    juce::MemoryBlock block;
+    in.readIntoMemoryBlock(block, 65536);
+    const juce::uint8* data{ static_cast<const juce::uint8*>(block.getData()) };
+    size_t size{ block.getSize() };
+
+    // purpose : decode a frame header
+    // output : frame length in bytes, 0 if the header isn't valid
+    auto parseHeader = [&](size_t i, int& version, int& layer, int& bitrate, int& sampleRate, int& samplesPerFrame) -> int
+    {
+        if (i + 4 > size || data[i] != 0xff || (data[i + 1] & 0xe0) != 0xe0)
+        {
+            return 0;
+        }
+
+        int versionBits{ (data[i + 1] >> 3) & 3 };
+        int layerBits{ (data[i + 1] >> 1) & 3 };
+        int bitrateIndex{ data[i + 2] >> 4 };
+        int rateIndex{ (data[i + 2] >> 2) & 3 };
+        int padding{ (data[i + 2] >> 1) & 1 };
+
+        if (versionBits == 1 || layerBits == 0 || bitrateIndex == 0 || bitrateIndex == 15 || rateIndex == 3)
+        {
+            return 0;
+        }
+
+        version = versionBits == 3 ? 1 : (versionBits == 2 ? 2 : 3); // 3 is mpeg 2.5
+        layer = 4 - layerBits;
+        bitrate = bitrates[version == 1 ? layer - 1 : (layer == 1 ? 3 : 4)][bitrateIndex];
+        sampleRate = sampleRates[version - 1][rateIndex];
+        samplesPerFrame = layer == 1 ? 384 : (layer == 2 || version == 1 ? 1152 : 576);
+
+        if (layer == 1)
+        {
+            return (12 * bitrate * 1000 / sampleRate + padding) * 4;
+        }
+        return samplesPerFrame / 8 * bitrate * 1000 / sampleRate + padding;
+    };
+
+    for (size_t i = 0; i + 4 <= size; ++i)
+    {
+        int version{ 0 }, layer{ 0 }, bitrate{ 0 }, sampleRate{ 0 }, samplesPerFrame{ 0 };
+        int frameLength{ parseHeader(i, version, layer, bitrate, sampleRate, samplesPerFrame) };
+        if (frameLength <= 0)
+        {
+            continue;
+        }
+
+        // a real frame is followed by another one, a random 0xff byte isn't
+        int nextVersion{ 0 }, nextLayer{ 0 }, nextBitrate{ 0 }, nextRate{ 0 }, nextSamples{ 0 };
+        if (i + frameLength + 4 <= size
+            && parseHeader(i + frameLength, nextVersion, nextLayer, nextBitrate, nextRate, nextSamples) == 0)
+        {
+            continue;
+        }
+
+        metadata.sampleRate = sampleRate;
+        metadata.numChannels = (data[i + 3] >> 6) == 3 ? 1 : 2;
+
+        // vbr files carry the number of frames in a Xing/Info or VBRI header
+        juce::uint32 numFrames{ 0 };
+        size_t sideInfo{ version == 1 ? (metadata.numChannels == 1 ? 17u : 32u) : (metadata.numChannels == 1 ? 9u : 17u) };
+        size_t xing{ i + 4 + sideInfo };
+        size_t vbri{ i + 4 + 32 };
+
+        if (xing + 12 <= size && (std::memcmp(data + xing, "Xing", 4) == 0 || std::memcmp(data + xing, "Info", 4) == 0)
+            && (juce::ByteOrder::bigEndianInt(data + xing + 4) & 1) != 0)
+        {
+            numFrames = juce::ByteOrder::bigEndianInt(data + xing + 8);
+        }
+        else if (vbri + 18 <= size && std::memcmp(data + vbri, "VBRI", 4) == 0)
+        {
+            numFrames = juce::ByteOrder::bigEndianInt(data + vbri + 14);
+        }
+
+        if (metadata.title.isEmpty())
+        {
+            readId3v1(in, metadata);
+        }
+
+        if (numFrames > 0)
+        {
+            metadata.lengthInSeconds = (double) numFrames * samplesPerFrame / sampleRate;
+        }
+        else
+        {
+            // constant bitrate, the length follows from the size of the audio data
+            juce::int64 audioBytes{ fileSize - start - (juce::int64) i };
+            in.setPosition(fileSize - 128);
+            char tag[3] = {};
+            if (in.read(tag, 3) == 3 && std::memcmp(tag, "TAG", 3) == 0)
+            {
+                audioBytes -= 128;
+            }
+            metadata.bitrate = bitrate;
+            metadata.lengthInSeconds = audioBytes * 8.0 / (bitrate * 1000.0);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+juce::int64 MetadataProbe::readId3v2(juce::FileInputStream& in, TrackMetadata& metadata)
+{
+    juce::int64 tagStart{ in.getPosition() };
+    juce::uint8 header[10];
+    if (in.read(header, 10) != 10 || std::memcmp(header, "ID3", 3) != 0)
+    {
+        return tagStart;
+    }
+
+    auto syncSafe = [](const juce::uint8* bytes) { return (bytes[0] << 21) | (bytes[1] << 14) | (bytes[2] << 7) | bytes[3]; };
+
+    int version{ header[3] };
+    int flags{ header[5] };
+    juce::int64 tagSize{ syncSafe(header + 6) };
+    juce::int64 tagEnd{ tagStart + 10 + tagSize + ((flags & 0x10) != 0 ? 10 : 0) };
+
+    if (version < 2 || version > 4)
+    {
+        return tagEnd;
+    }
+
+    juce::int64 position{ tagStart + 10 };
+
+    // extended header
+    if ((flags & 0x40) != 0 && version > 2)
+    {
+        juce::uint8 extended[4];
+        in.read(extended, 4);
+        position += version == 3 ? 4 + (juce::int64) juce::ByteOrder::bigEndianInt(extended) : syncSafe(extended);
+    }
+
+    const int frameHeaderSize{ version == 2 ? 6 : 10 };
+    while (position + frameHeaderSize <= tagStart + 10 + tagSize)
+    {
+        in.setPosition(position);
+        juce::uint8 frame[10];
+        if (in.read(frame, frameHeaderSize) != frameHeaderSize || frame[0] == 0)
+        {
+            break; // padding
+        }
+
+        juce::String id{ juce::String::fromUTF8(reinterpret_cast<const char*>(frame), version == 2 ? 3 : 4) };
+        juce::int64 frameSize{ version == 2 ? bigEndian24(frame + 3)
+                               : (version == 3 ? (juce::int64) juce::ByteOrder::bigEndianInt(frame + 4) : syncSafe(frame + 4)) };
+
+        juce::String* target{ nullptr };
+        if (id == "TIT2" || id == "TT2")
+        {
+            target = &metadata.title;
+        }
+        else if (id == "TPE1" || id == "TP1")
+        {
+            target = &metadata.artist;
+        }
+        else if (id == "TALB" || id == "TAL")
+        {
+            target = &metadata.album;
+        }
+
+        if (target != nullptr && frameSize > 1 && (size_t) frameSize < maxTagBlockSize)
+        {
+            juce::MemoryBlock text;
+            in.readIntoMemoryBlock(text, (ssize_t) frameSize);
+            *target = decodeId3Text(static_cast<const char*>(text.getData()), text.getSize());
+        }
+
+        position += frameHeaderSize + frameSize;
+    }
+
+    return tagEnd;
+}
+
+bool MetadataProbe::readId3v1(juce::FileInputStream& in, TrackMetadata& metadata)
+{
+    juce::int64 position{ in.getPosition() };
+    char tag[128];
+
+    in.setPosition(in.getTotalLength() - 128);
+    bool found{ in.read(tag, 128) == 128 && std::memcmp(tag, "TAG", 3) == 0 };
+    if (found)
+    {
+        metadata.title = textFromBytes(tag + 3, 30);
+        metadata.artist = textFromBytes(tag + 33, 30);
+        metadata.album = textFromBytes(tag + 63, 30);
+    }
+
+    in.setPosition(position);
+    return found;
+}
+
+void MetadataProbe::parseVorbisComment(const char* data, size_t size, TrackMetadata& metadata)
+{
+    if (size < 8)
+    {
+        return;
+    }
+
+    size_t position{ 4 + (size_t) juce::ByteOrder::littleEndianInt(data) };
+    if (position + 4 > size)
+    {
+        return;
+    }
+
+    juce::uint32 count{ juce::ByteOrder::littleEndianInt(data + position) };
+    position += 4;
+
+    for (juce::uint32 i = 0; i < count && position + 4 <= size; ++i)
+    {
+        size_t length{ juce::ByteOrder::littleEndianInt(data + position) };
+        position += 4;
+        if (position + length > size)
+        {
+            break;
+        }
+
+        juce::String comment{ juce::String::fromUTF8(data + position, (int) length) };
+        juce::String key{ comment.upToFirstOccurrenceOf("=", false, false).toUpperCase() };
+        juce::String value{ comment.fromFirstOccurrenceOf("=", false, false).trim() };
+
+        if (key == "TITLE")
+        {
+            metadata.title = value;
+        }
+        else if (key == "ARTIST")
+        {
+            metadata.artist = value;
+        }
+        else if (key == "ALBUM")
+        {
+            metadata.album = value;
+        }
+        position += length;
+    }
+}
+
+juce::String MetadataProbe::decodeId3Text(const char* data, size_t size)
+{
+    if (size < 2)
+    {
+        return {};
+    }
+
+    const char* text{ data + 1 };
+    size_t length{ size - 1 };
+
+    switch (data[0])
+    {
+        case 1:
+            // utf-16 with a byte order mark
+            if (length >= 2)
+            {
+                bool bigEndian{ (juce::uint8) text[0] == 0xfe && (juce::uint8) text[1] == 0xff };
+                return textFromUtf16(text + 2, length - 2, bigEndian);
+            }
+            return {};
+        case 2:
+            return textFromUtf16(text, length, true);
+        default:
+            // latin-1 or utf-8
+            return textFromBytes(text, length);
+    }
+}
+
+double MetadataProbe::readExtended(const char* bytes)
+{
+    int exponent{ ((bytes[0] & 0x7f) << 8) | (juce::uint8) bytes[1] };
+    juce::uint64 mantissa{ juce::ByteOrder::bigEndianInt64(bytes + 2) };
+
+    if (exponent == 0 && mantissa == 0)
+    {
+        return 0.0;
+    }
+
+    double value{ std::ldexp((double) mantissa, exponent - 16383 - 63) };
+    return (bytes[0] & 0x80) != 0 ? -value : value;
+}
+
+void MetadataProbe::estimateBitrate(juce::int64 fileSize, TrackMetadata& metadata)
+{
+    if (metadata.bitrate <= 0 && metadata.lengthInSeconds > 0)
+    {
+        metadata.bitrate = (int) (fileSize * 8 / metadata.lengthInSeconds / 1000);
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// what can be read about a track without decoding any audio
+struct TrackMetadata
+{
+    double lengthInSeconds{ 0.0 };
+    double sampleRate{ 0.0 };
+    int numChannels{ 0 };
+    int bitrate{ 0 }; // kbit/s
+    juce::String title;
+    juce::String artist;
+    juce::String album;
+    bool valid{ false };
+};
+
+// MetadataProbe reads the container headers and tags of WAV, AIFF, FLAC, Ogg Vorbis and
+// MP3 files. It only reads the first blocks of the file (and the last one for Ogg), so
+// probing a long MP3 costs the same as probing a short one.
+class MetadataProbe
+{
+public:
+
+    // purpose : read the metadata of a file
+    // input : audio file
+    // output : metadata, not valid if the format is unknown or the headers are damaged
+    static TrackMetadata probe(const juce::File& file);
+
+private:
+
+    static bool probeWav(juce::FileInputStream& in, TrackMetadata& metadata);
+    static bool probeAiff(juce::FileInputStream& in, TrackMetadata& metadata);
+    static bool probeFlac(juce::FileInputStream& in, TrackMetadata& metadata);
+    static bool probeOgg(juce::FileInputStream& in, TrackMetadata& metadata);
+    static bool probeMp3(juce::FileInputStream& in, TrackMetadata& metadata);
+
+    // purpose : read the id3v2 tag at the start of the stream
+    // input : stream at the tag, metadata to fill
+    // output : size of the tag including its header, 0 if there is none
+    static juce::int64 readId3v2(juce::FileInputStream& in, TrackMetadata& metadata);
+
+    // purpose : read the id3v1 tag at the end of the file
+    // input : stream and metadata to fill
+    // output : true if there was a tag
+    static bool readId3v1(juce::FileInputStream& in, TrackMetadata& metadata);
+
+    // purpose : parse a vorbis comment block (FLAC and Ogg)
+    // input : block data and metadata to fill
+    // output : void
+    static void parseVorbisComment(const char* data, size_t size, TrackMetadata& metadata);
+
+    // purpose : decode an id3v2 text frame
+    // input : frame data
+    // output : text
+    static juce::String decodeId3Text(const char* data, size_t size);
+
+    // purpose : convert the 80 bit float used for the AIFF sample rate
+    // input : 10 bytes of the number
+    // output : value
+    static double readExtended(const char* bytes);
+
+    // purpose : fill in the bitrate from the size of the file when the header has none
+    // input : file size and metadata
+    // output : void
+    static void estimateBitrate(juce::int64 fileSize, TrackMetadata& metadata);
+};
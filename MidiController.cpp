@@ -0,0 +1,375 @@
+#include "MidiController.h"
+#include <algorithm>
+#include <cmath>
+
+// timer period, and its ticks between looking for new inputs and between latency logs
+static constexpr int timerInterval = 100;
+static constexpr int ticksPerInputScan = 20;
+static constexpr int ticksPerLog = 100;
+
+// latencies kept for the percentiles
+static constexpr size_t latencyHistoryLength = 256;
+
+// seconds the jog moves the track per tick
+static constexpr double jogSeconds = 0.01;
+
+MidiController::MidiController(DJAudioPlayer& deck1, DJAudioPlayer& deck2, DeckMixer& _mixer, AppSettings& _settings)
+    : decks{ &deck1, &deck2 },
+    mixer(_mixer),
+    settings(_settings)
+{
+    for (std::atomic<int>& mapping : mappings)
+    {
+        mapping = -1;
+    }
+    loadMappings();
+
+#if JUCE_LINUX || JUCE_MAC
+    virtualInput = juce::MidiInput::createNewDevice("OtoDecks", this);
+    if (virtualInput != nullptr)
+    {
+        virtualInput->start();
+    }
+#endif
+
+    openInputs();
+    startTimer(timerInterval);
+}
+
+MidiController::~MidiController()
+{
+    stopTimer();
+    for (auto& input : inputs)
+    {
+        if (input.second != nullptr)
+        {
+            input.second->stop();
+        }
+    }
+    if (virtualInput != nullptr)
+    {
+        virtualInput->stop();
+    }
+}
+
+juce::String MidiController::getControlName(int control)
+{
+    static const char* const names[]{ "play", "cue", "jog", "low pass", "high pass",
+                                      "reverb X (damping)", "reverb Y (room size)", "mix X (dry)", "mix Y (wet)", "volume" };
+    if (control == crossfader)
+    {
+        return "Crossfader";
+    }
+    if (control < 0 || control > crossfader)
+    {
+        return {};
+    }
+    return "Deck " + juce::String(control / (int) Control::count + 1) + " " + names[control % (int) Control::count];
+}
+
+void MidiController::learn(int control)
+{
+    if (control < 0 || control >= numControls)
+    {
+        std::cout << "MidiController::learn control should be between 0 and " << numControls - 1 << std::endl;
+        return;
+    }
+    learning = control;
+}
+
+void MidiController::cancelLearning()
+{
+    learning = -1;
+}
+
+bool MidiController::isLearning() const
+{
+    return learning >= 0;
+}
+
+void MidiController::clearMappings()
+{
+    for (std::atomic<int>& mapping : mappings)
+    {
+        mapping = -1;
+    }
+    saveMappings();
+}
+
+void MidiController::prepareToPlay(int samplesPerBlock, double sampleRate, int outputLatency)
+{
+    outputDelay = sampleRate > 0.0 ? (samplesPerBlock + outputLatency) / sampleRate * 1000.0 : 0.0;
+}
+
+int MidiController::getKey(const juce::MidiMessage& message)
+{
+    if (message.isController())
+    {
+        return (message.getChannel() - 1) * 128 + message.getControllerNumber();
+    }
+    if (message.isNoteOnOrOff())
+    {
+        return 16 * 128 + (message.getChannel() - 1) * 128 + message.getNoteNumber();
+    }
+    return -1;
+}
+
+void MidiController::handleIncomingMidiMessage(juce::MidiInput*, const juce::MidiMessage& message)
+{
+    double now{ juce::Time::getMillisecondCounterHiRes() };
+    int key{ getKey(message) };
+    if (key < 0)
+    {
+        return;
+    }
+
+    // a control being learned takes the first controller or key pressed, away from any other
+    if (message.isController() || message.isNoteOn())
+    {
+        int control{ learning.exchange(-1) };
+        if (control >= 0)
+        {
+            for (std::atomic<int>& mapping : mappings)
+            {
+                if (mapping == control)
+                {
+                    mapping = -1;
+                }
+            }
+            mappings[(size_t) key] = control;
+            learned = true;
+            return;
+        }
+    }
+
+    int control{ mappings[(size_t) key] };
+    if (control < 0)
+    {
+        return;
+    }
+
+    Event event;
+    event.control = control;
+    event.value = message.isController() ? message.getControllerValue() : (message.isNoteOn() ? 127 : 0);
+    event.time = now;
+
+    // a full queue drops the message, the audio thread has stopped taking them
+    const juce::SpinLock::ScopedLockType lock(writeLock);
+    int start1, size1, start2, size2;
+    eventFifo.prepareToWrite(1, start1, size1, start2, size2);
+    if (size1 + size2 > 0)
+    {
+        events[(size_t) (size1 > 0 ? start1 : start2)] = event;
+        eventFifo.finishedWrite(1);
+    }
+}
+
+void MidiController::processEvents()
+{
+    int start1, size1, start2, size2;
+    eventFifo.prepareToRead(eventFifo.getNumReady(), start1, size1, start2, size2);
+    if (size1 + size2 == 0)
+    {
+        return;
+    }
+
+    double now{ juce::Time::getMillisecondCounterHiRes() };
+    int lStart1, lSize1, lStart2, lSize2;
+    latencyFifo.prepareToWrite(size1 + size2, lStart1, lSize1, lStart2, lSize2);
+    int latencyIndex{ 0 };
+
+    for (int i = 0; i < size1 + size2; ++i)
+    {
+        const Event& event{ events[(size_t) (i < size1 ? start1 + i : start2 + i - size1)] };
+        applyEvent(event);
+
+        if (latencyIndex < lSize1 + lSize2)
+        {
+            size_t index{ (size_t) (latencyIndex < lSize1 ? lStart1 + latencyIndex : lStart2 + latencyIndex - lSize1) };
+            latencies[index] = (float) (now - event.time + outputDelay);
+            ++latencyIndex;
+        }
+    }
+
+    eventFifo.finishedRead(size1 + size2);
+    latencyFifo.finishedWrite(latencyIndex);
+}
+
+// purpose : get the filter cutoff of a controller position, kept inside the range of the
+//           filters so they never complain from the audio thread
+// input : position from 0 to 1
+// output : frequency from 20 Hz to 20 kHz
+static double getCutoff(float value)
+{
+    return juce::jlimit(20.0, 20000.0, 20.0 * std::pow(1000.0, (double) value));
+}
+
+void MidiController::applyEvent(const Event& event)
+{
+    // every call here only stores atomics the deck or the mixer take up in their own block
+    float value{ event.value / 127.0f };
+    if (event.control == crossfader)
+    {
+        mixer.setCrossfader(value);
+        return;
+    }
+
+    DJAudioPlayer& deck{ *decks[(size_t) (event.control / (int) Control::count)] };
+    switch ((Control) (event.control % (int) Control::count))
+    {
+        case Control::play:
+            // buttons act on the press
+            if (event.value >= 64)
+            {
+                if (deck.isPlaying())
+                {
+                    deck.stop();
+                }
+                else
+                {
+                    deck.start();
+                }
+            }
+            break;
+        case Control::cue:
+            if (event.value >= 64)
+            {
+                deck.setCueEnabled(!deck.isCueEnabled());
+            }
+            break;
+        case Control::jog:
+        {
+            // relative, 1 to 63 turns forward and 127 down to 65 back
+            int ticks{ event.value < 64 ? event.value : event.value - 128 };
+            deck.nudge(ticks * jogSeconds);
+            break;
+        }
+        case Control::lowPass:
+            deck.getSoundController().setLowPassFrequency(getCutoff(value));
+            break;
+        case Control::highPass:
+            deck.getSoundController().setHighPassFrequency(getCutoff(value));
+            break;
+        case Control::reverbX:
+            deck.setDamping(value);
+            break;
+        case Control::reverbY:
+            deck.setRoomSize(value);
+            break;
+        case Control::mixX:
+            deck.setDryLevel(value);
+            break;
+        case Control::mixY:
+            deck.setWetLevel(value);
+            break;
+        case Control::volume:
+            deck.setGain(value);
+            break;
+        case Control::count:
+            break;
+    }
+}
+
+void MidiController::openInputs()
+{
+    // an input that failed to open isn't tried again
+    for (const juce::MidiDeviceInfo& device : juce::MidiInput::getAvailableDevices())
+    {
+        if (inputs.count(device.identifier) == 0)
+        {
+            std::unique_ptr<juce::MidiInput> input{ juce::MidiInput::openDevice(device.identifier, this) };
+            if (input != nullptr)
+            {
+                input->start();
+                std::cout << "MidiController: opened " << device.name << std::endl;
+            }
+            else
+            {
+                std::cout << "MidiController: can't open " << device.name << std::endl;
+            }
+            inputs[device.identifier] = std::move(input);
+        }
+    }
+}
+
+void MidiController::loadMappings()
+{
+    // key:control pairs
+    juce::StringArray pairs{ juce::StringArray::fromTokens(settings.getProperties().getValue("midi.mappings"), ",", "") };
+    for (const juce::String& pair : pairs)
+    {
+        int key{ pair.upToFirstOccurrenceOf(":", false, false).getIntValue() };
+        int control{ pair.fromFirstOccurrenceOf(":", false, false).getIntValue() };
+        if (key >= 0 && key < numKeys && control >= 0 && control < numControls)
+        {
+            mappings[(size_t) key] = control;
+        }
+    }
+}
+
+void MidiController::saveMappings()
+{
+    juce::StringArray pairs;
+    for (int key = 0; key < numKeys; ++key)
+    {
+        int control{ mappings[(size_t) key] };
+        if (control >= 0)
+        {
+            pairs.add(juce::String(key) + ":" + juce::String(control));
+        }
+    }
+    settings.getProperties().setValue("midi.mappings", pairs.joinIntoString(","));
+}
+
+juce::String MidiController::getLatencyReport() const
+{
+    if (latencyHistory.empty())
+    {
+        return "no MIDI messages";
+    }
+
+    std::vector<float> sorted{ latencyHistory };
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&sorted](double fraction)
+    {
+        return sorted[juce::jmin(sorted.size() - 1, (size_t) (fraction * (double) sorted.size()))];
+    };
+    return "MIDI to audio out: p50 " + juce::String(percentile(0.5), 2) + " p95 " + juce::String(percentile(0.95), 2)
+         + " max " + juce::String(sorted.back(), 2) + " ms over " + juce::String((int) sorted.size()) + " messages";
+}
+
+void MidiController::timerCallback()
+{
+    if (learned.exchange(false))
+    {
+        saveMappings();
+        if (onLearned)
+        {
+            onLearned();
+        }
+    }
+
+    int start1, size1, start2, size2;
+    latencyFifo.prepareToRead(latencyFifo.getNumReady(), start1, size1, start2, size2);
+    for (int i = 0; i < size1 + size2; ++i)
+    {
+        latencyHistory.push_back(latencies[(size_t) (i < size1 ? start1 + i : start2 + i - size1)]);
+    }
+    latencyFifo.finishedRead(size1 + size2);
+    latenciesSinceLog += size1 + size2;
+    if (latencyHistory.size() > latencyHistoryLength)
+    {
+        latencyHistory.erase(latencyHistory.begin(), latencyHistory.end() - (std::ptrdiff_t) latencyHistoryLength);
+    }
+
+    ++ticks;
+    if (ticks % ticksPerInputScan == 0)
+    {
+        openInputs();
+    }
+    if (ticks % ticksPerLog == 0 && latenciesSinceLog > 0)
+    {
+        std::cout << "MidiController: " << getLatencyReport() << std::endl;
+        latenciesSinceLog = 0;
+    }
+}
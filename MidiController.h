@@ -0,0 +1,176 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <vector>
+#include "AppSettings.h"
+#include "DJAudioPlayer.h"
+#include "DeckMixer.h"
+
+// MidiController plays the decks from MIDI controllers. Controller messages are looked up in
+// a learned mapping on the MIDI thread and queued to the audio thread, which applies them at
+// the start of its next block, so they never wait on the message thread.
+// Every MIDI input is opened, new ones as they are plugged in. On Linux and macOS there is
+// also a virtual input named OtoDecks, on Linux a controller or a test sender is connected to
+// it with aconnect.
+// The latency from the MIDI callback to the audio leaving the device is measured for every
+// message, as the wait for the block plus the block and the output latency of the device. The
+// delay of the driver before the callback isn't seen.
+class MidiController : private juce::MidiInputCallback,
+                       private juce::Timer
+{
+public:
+
+    // controls of a deck
+    enum class Control
+    {
+        play,
+        cue,
+        jog,
+        lowPass,
+        highPass,
+        reverbX,
+        reverbY,
+        mixX,
+        mixY,
+        volume,
+        count
+    };
+
+    // controls are numbered deck by deck, the crossfader comes last
+    static constexpr int numDecks = 2;
+    static constexpr int crossfader = numDecks * (int) Control::count;
+    static constexpr int numControls = crossfader + 1;
+
+    MidiController(DJAudioPlayer& deck1, DJAudioPlayer& deck2, DeckMixer& mixer, AppSettings& settings);
+
+    ~MidiController() override;
+
+    // purpose : get the name of a control
+    // input : control number
+    // output : name
+    static juce::String getControlName(int control);
+
+    // purpose : map the next control moved on a controller to a control
+    // input : control number
+    // output : void
+    void learn(int control);
+
+    // purpose : stop waiting for a control to learn
+    // input : none
+    // output : void
+    void cancelLearning();
+
+    // purpose : check if waiting for a control to learn
+    // input : none
+    // output : true while waiting
+    bool isLearning() const;
+
+    // purpose : forget every mapping
+    // input : none
+    // output : void
+    void clearMappings();
+
+    // called on the message thread when a control was learned
+    std::function<void()> onLearned;
+
+    // purpose : get ready for the audio device, from prepareToPlay
+    // input : samples per block, sample rate, output latency of the device in samples
+    // output : void
+    void prepareToPlay(int samplesPerBlock, double sampleRate, int outputLatency);
+
+    // purpose : apply the messages queued since the last block, from the audio thread
+    // input : none
+    // output : void
+    void processEvents();
+
+    // purpose : describe the latency of the last messages
+    // input : none
+    // output : percentiles in milliseconds
+    juce::String getLatencyReport() const;
+
+private:
+
+    // mapped message on its way to the audio thread
+    struct Event
+    {
+        int control{ 0 };
+
+        // 0 to 127, note on is 127 and note off 0
+        int value{ 0 };
+
+        // Time::getMillisecondCounterHiRes of the MIDI callback
+        double time{ 0.0 };
+    };
+
+    static constexpr int queueSize = 1024;
+    static constexpr int numKeys = 2 * 16 * 128;
+
+    std::array<DJAudioPlayer*, numDecks> decks;
+    DeckMixer& mixer;
+    AppSettings& settings;
+
+    // control of every controller and note number on every channel, -1 for none
+    std::array<std::atomic<int>, numKeys> mappings;
+
+    // control waiting to be learned, -1 for none, and whether one was learned since the timer
+    std::atomic<int> learning{ -1 };
+    std::atomic<bool> learned{ false };
+
+    // MIDI threads to the audio thread, the inputs take turns writing, the audio thread reads
+    // without waiting
+    juce::AbstractFifo eventFifo{ queueSize };
+    std::array<Event, queueSize> events;
+    juce::SpinLock writeLock;
+
+    // latencies in milliseconds, from the audio thread to the timer
+    juce::AbstractFifo latencyFifo{ queueSize };
+    std::array<float, queueSize> latencies;
+
+    // latest latencies, on the message thread
+    std::vector<float> latencyHistory;
+    int latenciesSinceLog{ 0 };
+    int ticks{ 0 };
+
+    // time from the start of a block to its end leaving the device, in milliseconds
+    double outputDelay{ 0.0 };
+
+    std::map<juce::String, std::unique_ptr<juce::MidiInput>> inputs;
+    std::unique_ptr<juce::MidiInput> virtualInput;
+
+    // purpose : get the key of a message in the mapping
+    // input : message
+    // output : key, -1 for messages that aren't controllers or notes
+    static int getKey(const juce::MidiMessage& message);
+
+    // purpose : map and queue a message, on the MIDI thread
+    // input : input, message
+    // output : void
+    void handleIncomingMidiMessage(juce::MidiInput* source, const juce::MidiMessage& message) override;
+
+    // purpose : apply a message to the decks, on the audio thread
+    // input : message
+    // output : void
+    void applyEvent(const Event& event);
+
+    // purpose : open the inputs that aren't open yet
+    // input : none
+    // output : void
+    void openInputs();
+
+    // purpose : read and write the mapping in the settings
+    // input : none
+    // output : void
+    void loadMappings();
+    void saveMappings();
+
+    // purpose : open new inputs, keep learned mappings and gather the latencies
+    // input : none
+    // output : void
+    void timerCallback() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MidiController)
+};
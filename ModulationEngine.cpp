@@ -0,0 +1,244 @@
+#include "ModulationEngine.h"
+#include <algorithm>
+#include <cmath>
+
+// tempo the synced modulators follow on a track without a beatgrid
+static constexpr double defaultBpm = 120.0;
+
+// shortest cycle or step when synced, in beats
+static constexpr double minBeats = 1.0 / 64.0;
+
+// purpose : get the fractional part of a phase, also below 0
+// input : phase
+// output : 0 to 1
+static double wrapPhase(double phase)
+{
+    return phase - std::floor(phase);
+}
+
+ModulationEngine::ModulationEngine()
+{
+}
+
+ModulationEngine::~ModulationEngine()
+{
+}
+
+void ModulationEngine::setModulator(int index, const Settings& settings)
+{
+    if (index < 0 || index >= numSlots)
+    {
+        std::cout << "ModulationEngine::setModulator slot should be between 0 and " << numSlots - 1 << std::endl;
+        return;
+    }
+
+    // the slot is off while it is written, and on again once everything is in
+    Slot& slot{ slots[(size_t) index] };
+    slot.type.store((int) Type::off, std::memory_order_release);
+    slot.target = (int) settings.target;
+    slot.depth = settings.depth;
+    slot.shape = (int) settings.shape;
+    slot.sync = settings.sync;
+    slot.rate = juce::jmax(0.001f, settings.rate);
+    slot.attack = juce::jmax(0.1f, settings.attack);
+    slot.release = juce::jmax(0.1f, settings.release);
+    for (int i = 0; i < maxSteps; ++i)
+    {
+        slot.steps[(size_t) i] = juce::jlimit(-1.0f, 1.0f, settings.steps[(size_t) i]);
+    }
+    slot.numSteps = juce::jlimit(0, maxSteps, settings.numSteps);
+    slot.type.store((int) settings.type, std::memory_order_release);
+}
+
+void ModulationEngine::clear()
+{
+    for (Slot& slot : slots)
+    {
+        slot.type.store((int) Type::off, std::memory_order_release);
+    }
+}
+
+void ModulationEngine::setBeatGrid(const std::vector<BeatMarker>& grid)
+{
+    // the beats between two markers are rounded up as the waveform counts them, so every
+    // marker starts on a whole beat
+    std::vector<GridPoint> points;
+    points.reserve(grid.size());
+    for (const BeatMarker& marker : grid)
+    {
+        if (marker.bpm <= 0.0)
+        {
+            continue;
+        }
+
+        GridPoint point{ marker.time, marker.bpm, 0.0 };
+        if (!points.empty())
+        {
+            const GridPoint& previous{ points.back() };
+            if (marker.time <= previous.time)
+            {
+                continue;
+            }
+            point.beats = previous.beats + std::ceil((marker.time - previous.time) * previous.bpm / 60.0 - 1e-6);
+        }
+        points.push_back(point);
+    }
+
+    // the old grid is freed here, after the swap, not on the audio thread
+    {
+        const juce::SpinLock::ScopedLockType lock(gridLock);
+        gridPoints.swap(points);
+    }
+}
+
+void ModulationEngine::prepare(double _sampleRate)
+{
+    sampleRate = _sampleRate > 0.0 ? _sampleRate : 44100.0;
+    for (Slot& slot : slots)
+    {
+        slot.phase = 0.0;
+        slot.envelope = 0.0f;
+    }
+    offsets.fill(0.0f);
+}
+
+void ModulationEngine::advance(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples, double trackSeconds)
+{
+    offsets.fill(0.0f);
+
+    double seconds{ numSamples / sampleRate };
+
+    // find the last marker at or before the position, the first one runs backwards too
+    {
+        const juce::SpinLock::ScopedTryLockType lock(gridLock);
+        if (lock.isLocked())
+        {
+            if (gridPoints.empty())
+            {
+                currentPoint = GridPoint{ 0.0, defaultBpm, 0.0 };
+            }
+            else
+            {
+                auto next{ std::upper_bound(gridPoints.begin(), gridPoints.end(), trackSeconds,
+                                            [](double time, const GridPoint& point) { return time < point.time; }) };
+                currentPoint = next == gridPoints.begin() ? *next : *(next - 1);
+            }
+        }
+    }
+    double tempo{ currentPoint.bpm > 0.0 ? currentPoint.bpm : defaultBpm };
+    double beats{ currentPoint.beats + (trackSeconds - currentPoint.time) * tempo / 60.0 };
+
+    // peak level of the period, only measured for a follower
+    float level{ -1.0f };
+
+    for (Slot& slot : slots)
+    {
+        Type type{ (Type) slot.type.load(std::memory_order_acquire) };
+        int target{ slot.target };
+        if (type == Type::off || target <= (int) Target::none || target >= (int) Target::count)
+        {
+            continue;
+        }
+
+        float value{ 0.0f };
+        if (type == Type::lfo)
+        {
+            double phase;
+            if (slot.sync)
+            {
+                phase = wrapPhase(beats / juce::jmax(minBeats, (double) slot.rate));
+            }
+            else
+            {
+                slot.phase = wrapPhase(slot.phase + seconds * slot.rate);
+                phase = slot.phase;
+            }
+            value = evaluateShape((Shape) slot.shape.load(), phase);
+        }
+        else if (type == Type::envelope)
+        {
+            if (level < 0.0f)
+            {
+                level = 0.0f;
+                for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+                {
+                    juce::Range<float> range{ juce::FloatVectorOperations::findMinAndMax(buffer.getReadPointer(channel, startSample), numSamples) };
+                    level = juce::jmax(level, -range.getStart(), range.getEnd());
+                }
+            }
+
+            // one pole smoothing, quicker going up than coming down
+            float time{ level > slot.envelope ? slot.attack.load() : slot.release.load() };
+            slot.envelope += (level - slot.envelope) * (1.0f - std::exp(-1000.0f * (float) seconds / time));
+            value = juce::jlimit(0.0f, 1.0f, slot.envelope);
+        }
+        else if (type == Type::steps)
+        {
+            int numSteps{ slot.numSteps };
+            if (numSteps == 0)
+            {
+                continue;
+            }
+
+            double step;
+            if (slot.sync)
+            {
+                step = beats / juce::jmax(minBeats, (double) slot.rate);
+            }
+            else
+            {
+                slot.phase = std::fmod(slot.phase + seconds * slot.rate, (double) numSteps);
+                step = slot.phase;
+            }
+            int index{ (int) std::floor(step) % numSteps };
+            value = slot.steps[(size_t) (index < 0 ? index + numSteps : index)];
+        }
+
+        offsets[(size_t) target] += slot.depth * value;
+    }
+}
+
+bool ModulationEngine::isActive() const
+{
+    for (const Slot& slot : slots)
+    {
+        if ((Type) slot.type.load(std::memory_order_acquire) != Type::off && slot.target != (int) Target::none)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ModulationEngine::isModulated(Target target) const
+{
+    for (const Slot& slot : slots)
+    {
+        if ((Type) slot.type.load(std::memory_order_acquire) != Type::off && slot.target == (int) target)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+float ModulationEngine::getOffset(Target target) const
+{
+    return offsets[(size_t) target];
+}
+
+float ModulationEngine::evaluateShape(Shape shape, double phase)
+{
+    switch (shape)
+    {
+        case Shape::sine:
+            return (float) std::sin(phase * juce::MathConstants<double>::twoPi);
+        case Shape::triangle:
+            return (float) (phase < 0.5 ? phase * 4.0 - 1.0 : 3.0 - phase * 4.0);
+        case Shape::square:
+            return phase < 0.5 ? 1.0f : -1.0f;
+        case Shape::saw:
+            return (float) (1.0 - phase * 2.0);
+    }
+    return 0.0f;
+}
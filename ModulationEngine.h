@@ -0,0 +1,175 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <vector>
+#include "Song.h"
+
+// ModulationEngine moves deck parameters from the audio thread, with LFOs, envelope
+// followers and step sequencers in a few slots. The deck advances it once per control period
+// of 64 samples and applies the offsets it gives to its targets, so modulation takes no
+// message thread work.
+// Synced LFOs and sequences run in beats of the track, worked out from its position and
+// beatgrid, so they stay on the beat through seeks and speed changes. Every marker of the grid
+// counts, the beats go on from one marker to the next the way the waveform numbers them.
+// Settings are written from the message thread into atomics, a slot changed while the audio
+// thread reads it can mix old and new settings for one period. The beatgrid is swapped in under
+// a spin lock the audio thread only tries, a period that misses it keeps the last marker.
+class ModulationEngine
+{
+public:
+
+    // samples per control period, and the slots of a deck
+    static constexpr int controlInterval = 64;
+    static constexpr int numSlots = 4;
+    static constexpr int maxSteps = 16;
+
+    // parameters a slot can move
+    enum class Target
+    {
+        none,
+        lowPassCutoff,      // in octaves, an offset of 1 is 4 octaves
+        highPassCutoff,
+        roomSize,           // added to the parameter, 0 to 1
+        damping,
+        wetLevel,
+        dryLevel,
+        gain,               // added to a gain of 1, cut only
+        speed,              // in octaves of the speed
+        count
+    };
+
+    enum class Type
+    {
+        off,
+        lfo,
+        envelope,
+        steps
+    };
+
+    enum class Shape
+    {
+        sine,
+        triangle,
+        square,
+        saw
+    };
+
+    struct Settings
+    {
+        Type type{ Type::off };
+        Target target{ Target::none };
+
+        // offset at the full value of the modulator, negative to turn it around
+        float depth{ 0.0f };
+
+        // LFO shape, -1 to 1
+        Shape shape{ Shape::sine };
+
+        // LFOs and sequences: beats per cycle or step when synced, cycles or steps per
+        // second when not
+        bool sync{ true };
+        float rate{ 1.0f };
+
+        // envelope follower times in milliseconds, it follows the deck's level from 0 to 1
+        float attack{ 10.0f };
+        float release{ 200.0f };
+
+        // step values, -1 to 1
+        std::array<float, maxSteps> steps{};
+        int numSteps{ 0 };
+    };
+
+    ModulationEngine();
+
+    ~ModulationEngine();
+
+    // purpose : set up a slot, from the message thread
+    // input : slot, settings
+    // output : void
+    void setModulator(int slot, const Settings& settings);
+
+    // purpose : turn every slot off, from the message thread
+    // input : none
+    // output : void
+    void clear();
+
+    // purpose : set the beatgrid the synced modulators follow, from the message thread
+    // input : markers of the track in time order, empty if unknown
+    // output : void
+    void setBeatGrid(const std::vector<BeatMarker>& grid);
+
+    // purpose : set the rate of the audio, from the audio thread
+    // input : sample rate
+    // output : void
+    void prepare(double sampleRate);
+
+    // purpose : advance every slot by a control period, from the audio thread
+    // input : audio of the deck in the period, for the envelope followers, its first sample and
+    //         length, position of the track at its start in seconds
+    // output : void
+    void advance(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples, double trackSeconds);
+
+    // purpose : check if any slot is on
+    // input : none
+    // output : true if on
+    bool isActive() const;
+
+    // purpose : check if any slot that is on moves a target
+    // input : target
+    // output : true if moved
+    bool isModulated(Target target) const;
+
+    // purpose : get the offset of a target after the last advance, the sum of its slots
+    // input : target
+    // output : offset
+    float getOffset(Target target) const;
+
+private:
+
+    struct Slot
+    {
+        std::atomic<int> type{ (int) Type::off };
+        std::atomic<int> target{ (int) Target::none };
+        std::atomic<float> depth{ 0.0f };
+        std::atomic<int> shape{ (int) Shape::sine };
+        std::atomic<bool> sync{ true };
+        std::atomic<float> rate{ 1.0f };
+        std::atomic<float> attack{ 10.0f };
+        std::atomic<float> release{ 200.0f };
+        std::array<std::atomic<float>, maxSteps> steps{};
+        std::atomic<int> numSteps{ 0 };
+
+        // audio thread state
+        double phase{ 0.0 };
+        float envelope{ 0.0f };
+    };
+
+    std::array<Slot, numSlots> slots;
+
+    // a marker with the beats counted from the first marker to it
+    struct GridPoint
+    {
+        double time{ 0.0 };
+        double bpm{ 0.0 };
+        double beats{ 0.0 };
+    };
+
+    std::vector<GridPoint> gridPoints;
+    juce::SpinLock gridLock;
+
+    // audio thread state, the marker the last period was in
+    GridPoint currentPoint;
+
+    double sampleRate{ 44100.0 };
+
+    std::array<float, (size_t) Target::count> offsets{};
+
+    // purpose : get the value of an LFO shape
+    // input : shape, phase 0 to 1
+    // output : value, -1 to 1
+    static float evaluateShape(Shape shape, double phase);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ModulationEngine)
+};
@@ -0,0 +1,66 @@
+#include "PlayheadTelemetry.h"
+
+// longest a snapshot is moved on for, in milliseconds, a stalled audio thread doesn't run the
+// playhead away
+static constexpr double maxExtrapolation = 250.0;
+
+// age of the latest snapshot when the audio thread counts as stopped, in milliseconds
+static constexpr double maxSnapshotAge = 500.0;
+
+PlayheadTelemetry::PlayheadTelemetry()
+{
+}
+
+PlayheadTelemetry::~PlayheadTelemetry()
+{
+}
+
+void PlayheadTelemetry::publish(const Snapshot& snapshot)
+{
+    juce::uint32 current{ sequence.load(std::memory_order_relaxed) };
+    sequence.store(current + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    position.store(snapshot.position, std::memory_order_relaxed);
+    length.store(snapshot.length, std::memory_order_relaxed);
+    samplesPerMs.store(snapshot.samplesPerMs, std::memory_order_relaxed);
+    time.store(snapshot.time, std::memory_order_relaxed);
+
+    sequence.store(current + 2, std::memory_order_release);
+}
+
+PlayheadTelemetry::Snapshot PlayheadTelemetry::read() const
+{
+    for (;;)
+    {
+        juce::uint32 before{ sequence.load(std::memory_order_acquire) };
+        if ((before & 1) != 0)
+        {
+            continue;
+        }
+
+        Snapshot snapshot;
+        snapshot.position = position.load(std::memory_order_relaxed);
+        snapshot.length = length.load(std::memory_order_relaxed);
+        snapshot.samplesPerMs = samplesPerMs.load(std::memory_order_relaxed);
+        snapshot.time = time.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) == before)
+        {
+            return snapshot;
+        }
+    }
+}
+
+double PlayheadTelemetry::getPositionAt(const Snapshot& snapshot, double now)
+{
+    double elapsed{ juce::jlimit(0.0, maxExtrapolation, now - snapshot.time) };
+    double extrapolated{ snapshot.position + snapshot.samplesPerMs * elapsed };
+    return juce::jlimit(0.0, (double) juce::jmax(snapshot.position, snapshot.length), extrapolated);
+}
+
+bool PlayheadTelemetry::isLive(const Snapshot& snapshot, double now)
+{
+    return snapshot.time > 0.0 && now - snapshot.time < maxSnapshotAge;
+}
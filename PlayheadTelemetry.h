@@ -0,0 +1,64 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+
+// PlayheadTelemetry carries the playhead of a deck from the audio thread to the GUI without
+// locks. The audio thread publishes a snapshot once per block, the GUI reads the latest one
+// and moves it on by the time passed since, so the playhead is smooth between blocks of any
+// size.
+// The snapshot is guarded by a sequence number (a seqlock), the only writer never waits and
+// a reader tries again in the rare case it overlaps a write.
+class PlayheadTelemetry
+{
+public:
+
+    struct Snapshot
+    {
+        // position and length in samples of the file
+        juce::int64 position{ 0 };
+        juce::int64 length{ 0 };
+
+        // samples of the file played per millisecond, 0 while stopped
+        double samplesPerMs{ 0.0 };
+
+        // Time::getMillisecondCounterHiRes when the snapshot was taken, 0 before the first one
+        double time{ 0.0 };
+    };
+
+    PlayheadTelemetry();
+
+    ~PlayheadTelemetry();
+
+    // purpose : publish a snapshot, from the audio thread only
+    // input : snapshot
+    // output : void
+    void publish(const Snapshot& snapshot);
+
+    // purpose : read the latest snapshot, from any thread
+    // input : none
+    // output : snapshot
+    Snapshot read() const;
+
+    // purpose : work out the position at a time from a snapshot
+    // input : snapshot, Time::getMillisecondCounterHiRes of the time
+    // output : position in samples of the file
+    static double getPositionAt(const Snapshot& snapshot, double now);
+
+    // purpose : check if a snapshot is recent enough to move on from
+    // input : snapshot, Time::getMillisecondCounterHiRes of now
+    // output : false before the first snapshot or when the audio thread stopped publishing
+    static bool isLive(const Snapshot& snapshot, double now);
+
+private:
+
+    // odd while a snapshot is being written
+    std::atomic<juce::uint32> sequence{ 0 };
+
+    std::atomic<juce::int64> position{ 0 };
+    std::atomic<juce::int64> length{ 0 };
+    std::atomic<double> samplesPerMs{ 0.0 };
+    std::atomic<double> time{ 0.0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PlayheadTelemetry)
+};
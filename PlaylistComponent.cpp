@@ -1,13 +1,21 @@
 #include <JuceHeader.h>
 #include "PlaylistComponent.h"
+#include "FrameProfiler.h"
 
 PlaylistComponent::PlaylistComponent(DeckGUI* _deckGUI1,
     DeckGUI* _deckGUI2,
-    DJAudioPlayer* _playerForParsingMetaData
+    juce::AudioFormatManager& _formatManager,
+    ThreadConfig& _threadConfig,
+    AnalysisStore& _analysisStore,
+    AppSettings& _appSettings
 )
     : deckGUI1(_deckGUI1),
     deckGUI2(_deckGUI2),
-    metaDataPlayer(_playerForParsingMetaData)
+    appSettings(_appSettings),
+    importer(_formatManager, _threadConfig, _appSettings.getDataDirectory().getChildFile("metadata.cache")),
+    fingerprintIndex(_formatManager, _threadConfig, _appSettings.getDataDirectory().getChildFile("fingerprints.bin")),
+    trackAnalyzer(_formatManager, _threadConfig, _analysisStore),
+    folderWatcher(juce::StringArray::fromTokens(_formatManager.getWildcardForAllFormats().removeCharacters("*"), ";", ""), _threadConfig)
 {
     // Setup child components and initial settings
 
@@ -15,6 +23,10 @@ PlaylistComponent::PlaylistComponent(DeckGUI* _deckGUI1,
     addAndMakeVisible(importButton);
     importButton.addListener(this);
 
+    // Setup watch folder button
+    addAndMakeVisible(watchFolderButton);
+    watchFolderButton.addListener(this);
+
     // Setup buttons for adding tracks to decks
     addAndMakeVisible(addToPlayer1Button);
     addToPlayer1Button.addListener(this);
@@ -22,19 +34,95 @@ PlaylistComponent::PlaylistComponent(DeckGUI* _deckGUI1,
     addAndMakeVisible(addToPlayer2Button);
     addToPlayer2Button.addListener(this);
 
+    // Setup import progress, only shown while importing
+    addChildComponent(importProgressBar);
+    importer.onBatchReady = [this](std::vector<ImportResult>& batch) { addImportedSongs(batch); };
+    importer.onFinished = [this](bool cancelled)
+    {
+        DBG("import " << (cancelled ? "cancelled" : "finished"));
+        importButton.setButtonText("IMPORT TRACKS");
+        importProgressBar.setVisible(false);
+    };
+
+    // Setup search box
+    addAndMakeVisible(searchBox);
+    searchBox.setTextToShowWhenEmpty("Search title, artist, album or path", juce::Colours::grey);
+    searchBox.addListener(this);
+
+    // Setup compatible keys filter
+    addAndMakeVisible(compatibleKeysButton);
+    compatibleKeysButton.setClickingTogglesState(true);
+    compatibleKeysButton.addListener(this);
+    openKeyNotation = appSettings.getProperties().getValue("library.keyNotation") == "openkey";
+
+    // loudness normalisation of the decks
+    autoGain = appSettings.getProperties().getBoolValue("deck.autoGain", false);
+    targetLoudness = juce::jlimit(-40.0, 0.0, appSettings.getProperties().getDoubleValue("deck.targetLoudness", -14.0));
+
+    // keep the search and key indexes in step with the library once they are built
+    libraryStore.onSongStored = [this](const Song& song)
+    {
+        libraryView.songStored(song);
+        paintedTrackId = 0;
+        if (searchIndexBuilt)
+        {
+            searchIndex.addSong(song);
+        }
+        if (keyIndexBuilt)
+        {
+            keyIndex.addSong(song);
+        }
+    };
+    libraryStore.onSongRemoved = [this](TrackId id)
+    {
+        libraryView.songRemoved(id);
+        paintedTrackId = 0;
+        if (searchIndexBuilt)
+        {
+            searchIndex.removeSong(id);
+        }
+        if (keyIndexBuilt)
+        {
+            keyIndex.removeSong(id);
+        }
+    };
+
     // Setup table list
     addAndMakeVisible(library);
     library.getHeader().addColumn("Song Title", 1, 1);
+    library.getHeader().addColumn("Artist", 4, 1);
     library.getHeader().addColumn("Playing Time", 2, 1);
-    library.getHeader().addColumn("Remove?", 3, 1);
+    library.getHeader().addColumn("BPM", 5, 1);
+    library.getHeader().addColumn("Key", 6, 1);
+    library.getHeader().addColumn("Remove?", 3, 1, 30, -1, juce::TableHeaderComponent::visible | juce::TableHeaderComponent::resizable);
     library.setModel(this);
     loadPreviousLibrary();
+
+    // the view rebuilds its rows once per batch of changes
+    libraryView.onRowsChanged = [this]
+    {
+        library.updateContent();
+        library.repaint();
+    };
+    libraryView.clearFilter();
+
+    fingerprintIndex.onDuplicateFound = [this](TrackId id, TrackId original) { removeDuplicate(id, original); };
+    fingerprintMissingTracks();
+
+    trackAnalyzer.onResults = [this](std::vector<AnalysisResult>& results) { storeAnalysisResults(results); };
+    analyseMissingTracks();
+
+    folderWatcher.onChanges = [this](FolderChanges& changes) { applyFolderChanges(changes); };
+    loadWatchedFolders();
 }
 
 PlaylistComponent::~PlaylistComponent()
 {
-    // Destructor
-    savePlaylist();
+    stopTimer(keyFilterTimer);
+    stopTimer(missingFilesTimer);
+
+    // Destructor, every change is already journaled so closing only compacts
+    libraryStore.close();
 }
 
 void PlaylistComponent::paint(juce::Graphics& g)
@@ -50,26 +138,35 @@ void PlaylistComponent::paint(juce::Graphics& g)
 void PlaylistComponent::resized()
 {
     float rowButton = getHeight() * 0.15;
-    float colButton = getWidth() / 3;
+    float colButton = getWidth() / 4;
 
     // Set position and size of buttons
     importButton.setBounds(0, getHeight() - rowButton, colButton, rowButton);
-    addToPlayer1Button.setBounds(colButton, getHeight() - rowButton, colButton, rowButton);
-    addToPlayer2Button.setBounds(2 * colButton, getHeight() - rowButton, colButton, rowButton);
-
-    // Set position and size of library
-    library.setBounds(0, 0, getWidth(), getHeight() - rowButton);
+    watchFolderButton.setBounds(colButton, getHeight() - rowButton, colButton, rowButton);
+    addToPlayer1Button.setBounds(2 * colButton, getHeight() - rowButton, colButton, rowButton);
+    addToPlayer2Button.setBounds(3 * colButton, getHeight() - rowButton, colButton, rowButton);
+
+    // Set position and size of search box and library
+    int rowSearch{ 24 };
+    int colFilter{ 160 };
+    searchBox.setBounds(0, 0, getWidth() - colFilter, rowSearch);
+    compatibleKeysButton.setBounds(getWidth() - colFilter, 0, colFilter, rowSearch);
+    library.setBounds(0, rowSearch, getWidth(), getHeight() - rowButton - rowSearch);
+    importProgressBar.setBounds(0, getHeight() - 1.5 * rowButton, getWidth(), rowButton / 2);
 
     // Set column sizes of library
-    library.getHeader().setColumnWidth(1, 12.8 * getWidth() / 20);
-    library.getHeader().setColumnWidth(2, 5 * getWidth() / 20);
+    library.getHeader().setColumnWidth(1, 6 * getWidth() / 20);
+    library.getHeader().setColumnWidth(4, 4 * getWidth() / 20);
+    library.getHeader().setColumnWidth(2, 3 * getWidth() / 20);
+    library.getHeader().setColumnWidth(5, 2.3 * getWidth() / 20);
+    library.getHeader().setColumnWidth(6, 2.3 * getWidth() / 20);
     library.getHeader().setColumnWidth(3, 2 * getWidth() / 20);
 }
 
 int PlaylistComponent::getNumRows()
 {
-    // Return the number of tracks available
-    return tracks.size();
+    // Return the number of tracks shown
+    return libraryView.getNumRows();
 }
 
 void PlaylistComponent::paintRowBackground(juce::Graphics& g, int rowNumber, int width, int height, bool rowIsSelected)
@@ -87,16 +184,42 @@ void PlaylistComponent::paintRowBackground(juce::Graphics& g, int rowNumber, int
 
 void PlaylistComponent::paintCell(juce::Graphics& g, int rowNumber, int columnId, int width, int height, bool rowIsSelected)
 {
+    FrameProfiler::ScopedPaint profile{ "PlaylistComponent cell" };
+
     // Display track titles and lengths
     if (rowNumber < getNumRows())
     {
+        // only the visible rows are decoded from the store, once for all their cells
+        TrackId id{ getTrackIdAtRow(rowNumber) };
+        if (id == 0)
+        {
+            return;
+        }
+        if (id != paintedTrackId)
+        {
+            paintedTrack = libraryStore.getSong(id);
+            paintedTrackId = id;
+        }
+        const Song& track{ paintedTrack };
         if (columnId == 1)
         {
-            g.drawText(tracks[rowNumber].title, 2, 0, width - 4, height, juce::Justification::centredLeft, true);
+            g.drawText(track.title, 2, 0, width - 4, height, juce::Justification::centredLeft, true);
         }
         if (columnId == 2)
         {
-            g.drawText(tracks[rowNumber].length, 2, 0, width - 4, height, juce::Justification::centred, true);
+            g.drawText(secondsToMinutes(track.lengthInSeconds), 2, 0, width - 4, height, juce::Justification::centred, true);
+        }
+        if (columnId == 4)
+        {
+            g.drawText(track.artist, 2, 0, width - 4, height, juce::Justification::centredLeft, true);
+        }
+        if (columnId == 5 && track.bpm > 0.0)
+        {
+            g.drawText(juce::String(track.bpm, 1), 2, 0, width - 4, height, juce::Justification::centred, true);
+        }
+        if (columnId == 6)
+        {
+            g.drawText(KeyIndex::getKeyName(track.key, openKeyNotation), 2, 0, width - 4, height, juce::Justification::centred, true);
         }
     }
 }
@@ -109,15 +232,25 @@ juce::Component* PlaylistComponent::refreshComponentForCell(int rowNumber, int c
         if (existingComponentToUpdate == nullptr)
         {
             juce::TextButton* btn = new juce::TextButton{ "Remove" };
-            juce::String id{ std::to_string(rowNumber) };
-            btn->setComponentID(id);
             btn->addListener(this);
             existingComponentToUpdate = btn;
         }
+
+        // buttons are reused for other rows as the table scrolls, so the track they remove
+        // is set every time
+        existingComponentToUpdate->setComponentID(juce::String{ (juce::int64) getTrackIdAtRow(rowNumber) });
     }
     return existingComponentToUpdate;
 }
 
+// Sort the table by the clicked column
+void PlaylistComponent::sortOrderChanged(int newSortColumnId, bool isForwards)
+{
+    libraryView.setSort(newSortColumnId, isForwards);
+    library.updateContent();
+    library.repaint();
+}
+
 // Callback for when any button in the playlist component is clicked.
 void PlaylistComponent::buttonClicked(juce::Button* button)
 {
@@ -126,6 +259,11 @@ void PlaylistComponent::buttonClicked(juce::Button* button)
     {
         addSongsToPlaylist();
     }
+    // Watch folder button clicked
+    else if (button == &watchFolderButton)
+    {
+        addWatchedFolder();
+    }
     // Add to player 1 button clicked
     else if (button == &addToPlayer1Button)
     {
@@ -136,128 +274,534 @@ void PlaylistComponent::buttonClicked(juce::Button* button)
     {
         loadSongToPlayer(deckGUI2);
     }
+    // Compatible keys filter toggled
+    else if (button == &compatibleKeysButton)
+    {
+        if (compatibleKeysButton.getToggleState())
+        {
+            compatibleKey = getPlayingKey();
+            startTimer(keyFilterTimer, 500);
+        }
+        else
+        {
+            stopTimer(keyFilterTimer);
+        }
+        refreshTable();
+        library.scrollToEnsureRowIsOnscreen(0);
+    }
     // Other buttons (Remove button)
     else
     {
-        int id = std::stoi(button->getComponentID().toStdString());
-        deleteSongFromPlaylist(id);
+        removeTrack((TrackId) button->getComponentID().getLargeIntValue());
+        refreshTable();
+    }
+}
+
+// Filter the table on every keystroke
+void PlaylistComponent::textEditorTextChanged(juce::TextEditor& editor)
+{
+    if (&editor == &searchBox)
+    {
+        updateFilter();
         library.updateContent();
+        library.scrollToEnsureRowIsOnscreen(0);
+        library.repaint();
     }
 }
 
+// Get the track of a row, through the search results while filtering
+TrackId PlaylistComponent::getTrackIdAtRow(int row)
+{
+    return libraryView.getTrackId(row);
+}
+
+// Run the query of the search box and keep the compatible keys, the indexes are built from
+// the store on first use
+void PlaylistComponent::updateFilter()
+{
+    juce::String query{ searchBox.getText().trim() };
+    bool filterByKey{ compatibleKeysButton.getToggleState() && compatibleKey >= 0 };
+    if (query.isEmpty() && !filterByKey)
+    {
+        libraryView.clearFilter();
+        return;
+    }
+
+    std::vector<TrackId> compatible;
+    if (filterByKey)
+    {
+        if (!keyIndexBuilt)
+        {
+            for (TrackId id : libraryStore.getTrackIds())
+            {
+                keyIndex.addSong(libraryStore.getSong(id));
+            }
+            keyIndexBuilt = true;
+        }
+
+        compatible = keyIndex.getCompatibleTracks(compatibleKey);
+        if (query.isEmpty())
+        {
+            libraryView.setFilter(std::move(compatible));
+            return;
+        }
+    }
+
+    if (!searchIndexBuilt)
+    {
+        for (TrackId id : libraryStore.getTrackIds())
+        {
+            searchIndex.addSong(libraryStore.getSong(id));
+        }
+        searchIndexBuilt = true;
+    }
+
+    // the search results keep their ranking, the compatible tracks are sorted by id
+    std::vector<TrackId> results{ searchIndex.search(query) };
+    if (filterByKey)
+    {
+        results.erase(std::remove_if(results.begin(), results.end(), [&compatible](TrackId id)
+        {
+            return !std::binary_search(compatible.begin(), compatible.end(), id);
+        }), results.end());
+    }
+    libraryView.setFilter(std::move(results));
+}
+
+// Find the key of the playing track, the first deck wins when both play
+int PlaylistComponent::getPlayingKey()
+{
+    for (DeckGUI* deckGUI : { deckGUI1, deckGUI2 })
+    {
+        juce::URL url{ deckGUI->getLoadedURL() };
+        if (!deckGUI->isPlaying() || !url.isLocalFile())
+        {
+            continue;
+        }
+
+        TrackId id{ libraryStore.findByPath(url.getLocalFile()) };
+        if (id != 0)
+        {
+            return libraryStore.getSong(id).key;
+        }
+    }
+    return -1;
+}
+
+// Filter again when another key starts playing, a stopped deck keeps its key
+void PlaylistComponent::timerCallback(int timerID)
+{
+    if (timerID == missingFilesTimer)
+    {
+        sweepMissingFiles();
+        return;
+    }
+
+    int key{ getPlayingKey() };
+    if (key >= 0 && key != compatibleKey)
+    {
+        compatibleKey = key;
+        refreshTable();
+        library.scrollToEnsureRowIsOnscreen(0);
+    }
+}
+
+// Update the table, a running search or key filter is run again so it sees the change
+void PlaylistComponent::refreshTable()
+{
+    if (searchBox.getText().trim().isNotEmpty() || compatibleKeysButton.getToggleState())
+    {
+        updateFilter();
+    }
+    library.updateContent();
+    library.repaint();
+}
+
 // Load a selected track into a specified player.
 void PlaylistComponent::loadSongToPlayer(DeckGUI* deckGUI)
 {
     int selectedRow{ library.getSelectedRow() };
     if (selectedRow != -1)
     {
-        DBG("Adding: " << tracks[selectedRow].title << " to Player");
-        deckGUI->loadTrack(tracks[selectedRow].URL);
+        Song track{ libraryStore.getSong(getTrackIdAtRow(selectedRow)) };
+        DBG("Adding: " << track.title << " to Player");
+        deckGUI->loadTrack(track.URL);
+        deckGUI->setTrackGain(getAutoGain(track));
+        deckGUI->setBeatGrid(track.beatGrid);
+
+        // a track loaded before its analysis ran gets analysed first
+        if (!trackAnalyzer.isAnalysed(track))
+        {
+            trackAnalyzer.analyze(track.id, track.file, true);
+        }
     }
 }
 
-// Add songs to the playlist from file chooser
+// Add songs to the playlist from file chooser, the import button cancels a running import
 void PlaylistComponent::addSongsToPlaylist()
 {
+    if (importer.isImporting())
+    {
+        importer.cancel();
+        return;
+    }
+
     fChooser.launchAsync(FileBrowserComponent::openMode | FileBrowserComponent::canSelectMultipleItems, [this](const FileChooser& chooser)
     {
+        if (chooser.getResults().isEmpty())
+        {
+            return;
+        }
+
+        importProgress = 0.0;
+        importProgressBar.setVisible(true);
+        importButton.setButtonText("CANCEL IMPORT");
+        importer.importFiles(chooser.getResults());
+    });
+}
+
+// Add the files read by the importer, one table update per batch
+void PlaylistComponent::addImportedSongs(std::vector<ImportResult>& batch)
+{
+    for (ImportResult& result : batch)
+    {
+        if (!result.readable)
+        {
+            std::cout << "PlaylistComponent: can't read " << result.file.getFullPathName() << std::endl;
+            continue;
+        }
 
-            for (const juce::File& file : chooser.getResults())
+        // one file has one path, however it was reached
+        Song newTrack{ juce::File{ LibraryStore::getCanonicalPath(result.file) } };
+        const TrackMetadata& metadata{ result.metadata };
+        if (metadata.title.isNotEmpty())
+        {
+            newTrack.title = metadata.title;
+        }
+
+        // a file that is already stored was rewritten, refresh it and keep its id
+        TrackId existing{ libraryStore.findByPath(newTrack.file) };
+        if (existing != 0)
+        {
+            Song stored{ libraryStore.getSong(existing) };
+            if (stored.fileSize != result.fileSize || stored.modificationTime != result.modificationTime)
             {
-                juce::String fileNameWithoutExtension{ file.getFileNameWithoutExtension() };
-                if (!checkSongExistance(fileNameWithoutExtension)) // if not already loaded
-                {
-                    Song newTrack{ file };
-                    juce::URL audioURL{ file };
-                    newTrack.length = getLength(audioURL);
-                    tracks.push_back(newTrack);
+                newTrack.id = existing;
+                newTrack.artist = metadata.artist;
+                newTrack.album = metadata.album;
+                newTrack.lengthInSeconds = metadata.lengthInSeconds;
+                newTrack.sampleRate = metadata.sampleRate;
+                newTrack.numChannels = metadata.numChannels;
+                newTrack.bitrate = metadata.bitrate;
+                newTrack.fileSize = result.fileSize;
+                newTrack.modificationTime = result.modificationTime;
+                libraryStore.updateSong(newTrack);
+                fingerprintIndex.queue(existing, newTrack.file, newTrack.lengthInSeconds, false);
+                trackAnalyzer.analyze(existing, newTrack.file, false);
+            }
+            continue;
+        }
 
+        // a copy that was turned away before and hasn't changed since
+        if (fingerprintIndex.isKnownDuplicate(newTrack.file.getFullPathName(), result.fileSize, result.modificationTime))
+        {
+            continue;
+        }
 
-                    DBG("loaded file: " << newTrack.title);
-                }
-                library.updateContent();
+        newTrack.artist = metadata.artist;
+        newTrack.album = metadata.album;
+        newTrack.lengthInSeconds = metadata.lengthInSeconds;
+        newTrack.sampleRate = metadata.sampleRate;
+        newTrack.numChannels = metadata.numChannels;
+        newTrack.bitrate = metadata.bitrate;
+        newTrack.fileSize = result.fileSize;
+        newTrack.modificationTime = result.modificationTime;
+        libraryStore.addSong(newTrack);
+
+        // copies under another name or in another format are found once it is fingerprinted
+        fingerprintIndex.queue(newTrack.id, newTrack.file, newTrack.lengthInSeconds, true);
+        trackAnalyzer.analyze(newTrack.id, newTrack.file, false);
+
+        DBG("loaded file: " << newTrack.title);
+    }
+
+    importProgress = importer.getProgress();
+    refreshTable();
+}
+
+// Store the tempo, beatgrid, key and loudness of the analysed tracks, removed tracks are skipped
+void PlaylistComponent::storeAnalysisResults(std::vector<AnalysisResult>& results)
+{
+    for (const AnalysisResult& result : results)
+    {
+        if (!result.analysed || !libraryStore.contains(result.id))
+        {
+            continue;
+        }
+
+        Song track{ libraryStore.getSong(result.id) };
+        track.bpm = result.bpm;
+        track.beatGrid = result.beatGrid;
+        track.key = result.key;
+        track.loudness = result.loudness;
+        track.truePeak = result.truePeak;
+        track.analysisVersion = trackAnalyzer.getAnalysisVersion();
+        libraryStore.updateSong(track);
+
+        // a track loaded before its analysis gets its beatgrid drawn now
+        for (DeckGUI* deckGUI : { deckGUI1, deckGUI2 })
+        {
+            if (deckGUI->getLoadedURL().isLocalFile() && deckGUI->getLoadedURL().getLocalFile() == track.file)
+            {
+                deckGUI->setBeatGrid(track.beatGrid);
             }
-    });
+        }
+    }
+    refreshTable();
 }
 
-// Check if a song with a given filename exists in the playlist
-bool PlaylistComponent::checkSongExistance(juce::String fileNameWithoutExtension)
+// Analyse the tracks stored before the current analysis, results the analysis store already
+// holds for their content are taken from it without decoding. The versions come from the
+// library index, only the tracks to analyse are read.
+void PlaylistComponent::analyseMissingTracks()
 {
-    return (std::find(tracks.begin(), tracks.end(), fileNameWithoutExtension) != tracks.end());
+    int version{ trackAnalyzer.getAnalysisVersion() };
+    for (TrackId id : libraryStore.getTrackIds())
+    {
+        if (libraryStore.getAnalysisVersion(id) != version)
+        {
+            trackAnalyzer.analyze(id, juce::File{ libraryStore.getPath(id) }, false);
+        }
+    }
 }
 
-// Delete a song from the playlist
-void PlaylistComponent::deleteSongFromPlaylist(int id)
+// Gain toward the target loudness, a quiet track is only raised as far as its peaks allow
+double PlaylistComponent::getAutoGain(const Song& track)
 {
-    tracks.erase(tracks.begin() + id);
+    if (!autoGain || track.loudness >= 0.0)
+    {
+        return 0.0;
+    }
+
+    double gain{ targetLoudness - track.loudness };
+    gain = juce::jmin(gain, -1.0 - track.truePeak);
+    return juce::jlimit(-24.0, 12.0, gain);
 }
 
-// Get the length of a song from its URL
-juce::String PlaylistComponent::getLength(juce::URL audioURL)
+// Fingerprint the tracks stored before fingerprints existed, they are only indexed
+void PlaylistComponent::fingerprintMissingTracks()
 {
-    metaDataPlayer->loadURL(audioURL);
-    double seconds{ metaDataPlayer->getLengthInSeconds() };
-    juce::String minutes{ secondsToMinutes(seconds) };
-    return minutes;
+    for (TrackId id : libraryStore.getTrackIds())
+    {
+        if (!fingerprintIndex.contains(id))
+        {
+            Song track{ libraryStore.getSong(id) };
+            fingerprintIndex.queue(id, track.file, track.lengthInSeconds, false);
+        }
+    }
 }
 
-// Convert seconds to minutes:seconds format
-juce::String PlaylistComponent::secondsToMinutes(double seconds)
+// Let the user pick a folder that is scanned now and followed from then on
+void PlaylistComponent::addWatchedFolder()
 {
-    int secondsRounded{ int(std::round(seconds)) };
-    juce::String min{ std::to_string(secondsRounded / 60) };
-    juce::String sec{ std::to_string(secondsRounded % 60) };
+    fChooser.launchAsync(FileBrowserComponent::openMode | FileBrowserComponent::canSelectDirectories, [this](const FileChooser& chooser)
+    {
+        juce::File folder{ LibraryStore::getCanonicalPath(chooser.getResult()) };
+        if (!folder.isDirectory() || watchedFolders.contains(folder.getFullPathName()))
+        {
+            return;
+        }
 
-    if (sec.length() < 2)
+        watchedFolders.add(folder.getFullPathName());
+        appSettings.getProperties().setValue("library.watchedFolders", watchedFolders.joinIntoString("\n"));
+        folderWatcher.addFolder(folder, true);
+    });
+}
+
+// Watch the folders of the previous sessions again
+void PlaylistComponent::loadWatchedFolders()
+{
+    watchedFolders = juce::StringArray::fromLines(appSettings.getProperties().getValue("library.watchedFolders"));
+    watchedFolders.removeEmptyStrings();
+
+    for (const juce::String& path : watchedFolders)
     {
-        sec = sec.paddedLeft('0', 2);
+        // files changed while the app was closed come back as imports, unchanged ones are
+        // answered by the metadata cache and skipped
+        folderWatcher.addFolder(juce::File{ path }, true);
+        sweepFolders.add(path + juce::File::getSeparatorString());
+    }
+
+    // deleted files are looked for after startup, a few milliseconds at a time
+    if (!sweepFolders.isEmpty())
+    {
+        sweepIds = libraryStore.getTrackIds();
+        sweepPosition = 0;
+        startTimer(missingFilesTimer, 50);
+    }
+}
+
+// Drop the tracks whose files left a watched folder, as many as fit in a few milliseconds
+void PlaylistComponent::sweepMissingFiles()
+{
+    const double sliceMs{ 4.0 };
+    double end{ juce::Time::getMillisecondCounterHiRes() + sliceMs };
+    std::vector<TrackId> missing;
+
+    while (sweepPosition < sweepIds.size() && juce::Time::getMillisecondCounterHiRes() < end)
+    {
+        TrackId id{ sweepIds[sweepPosition++] };
+
+        // a track removed since the sweep started has no path anymore
+        juce::String path{ libraryStore.getPath(id) };
+        for (const juce::String& folder : sweepFolders)
+        {
+            if (path.startsWith(folder))
+            {
+                if (!juce::File{ path }.existsAsFile())
+                {
+                    missing.push_back(id);
+                }
+                break;
+            }
+        }
+    }
+
+    for (TrackId id : missing)
+    {
+        removeTrack(id);
+    }
+    if (!missing.empty())
+    {
+        refreshTable();
+    }
+
+    if (sweepPosition >= sweepIds.size())
+    {
+        stopTimer(missingFilesTimer);
+        sweepIds = {};
+        sweepFolders.clear();
     }
-    return juce::String{ min + ":" + sec };
 }
 
-// Find a song in the playlist based on a search string
-int PlaylistComponent::findInPlaylist(juce::String searchText)
+// Apply the changes in the watched folders, one table update per batch
+void PlaylistComponent::applyFolderChanges(FolderChanges& changes)
 {
-    auto it = find_if(tracks.begin(), tracks.end(),
-        [&searchText](const Song& obj) {return obj.title.contains(searchText); });
-    int i = -1;
+    // in the order they happened, a track moved to a name that was deleted later is removed
+    for (const FolderChange& step : changes.steps)
+    {
+        if (step.type == FolderChange::removedFolder)
+        {
+            for (TrackId id : libraryStore.findInFolder(step.file))
+            {
+                removeTrack(id);
+            }
+            continue;
+        }
 
-    if (it != tracks.end())
+        TrackId id{ libraryStore.findByPath(step.file) };
+        if (step.type == FolderChange::removedFile)
+        {
+            removeTrack(id);
+            continue;
+        }
+
+        if (id != 0)
+        {
+            moveSong(id, step.to);
+            continue;
+        }
+
+        // a renamed folder moves every track below it
+        for (TrackId trackInFolder : libraryStore.findInFolder(step.file))
+        {
+            juce::String oldPath{ libraryStore.getSong(trackInFolder).file.getFullPathName() };
+            moveSong(trackInFolder, juce::File{ step.to.getFullPathName() + oldPath.substring(step.file.getFullPathName().length()) });
+        }
+    }
+
+    if (!changes.added.isEmpty())
+    {
+        importer.importFiles(changes.added);
+    }
+
+    refreshTable();
+}
+
+// Keep the id, metadata and analysis of a track whose file was moved or renamed
+void PlaylistComponent::moveSong(TrackId id, const juce::File& newFile)
+{
+    Song stored{ libraryStore.getSong(id) };
+    Song moved{ newFile };
+
+    moved.id = id;
+    moved.artist = stored.artist;
+    moved.album = stored.album;
+    moved.lengthInSeconds = stored.lengthInSeconds;
+    moved.sampleRate = stored.sampleRate;
+    moved.numChannels = stored.numChannels;
+    moved.bitrate = stored.bitrate;
+    moved.fileSize = stored.fileSize;
+    moved.modificationTime = stored.modificationTime;
+    moved.bpm = stored.bpm;
+    moved.beatGrid = stored.beatGrid;
+    moved.key = stored.key;
+    moved.loudness = stored.loudness;
+    moved.truePeak = stored.truePeak;
+    moved.analysisVersion = stored.analysisVersion;
+
+    // a title taken from the file name follows the new name, a tagged title stays
+    if (stored.title != stored.file.getFileNameWithoutExtension())
     {
-        i = std::distance(tracks.begin(), it);
+        moved.title = stored.title;
     }
 
-    return i;
+    libraryStore.updateSong(moved);
 }
 
-// Save the playlist to a file
-void PlaylistComponent::savePlaylist()
+// Drop a track that turned out to be a copy of one already in the library
+void PlaylistComponent::removeDuplicate(TrackId id, TrackId original)
 {
-    std::ofstream myLibrary("my-library.csv");
+    std::cout << "PlaylistComponent: " << libraryStore.getSong(id).file.getFullPathName()
+              << " is a copy of " << libraryStore.getSong(original).file.getFullPathName() << std::endl;
+
+    libraryStore.removeSong(id);
+    refreshTable();
+}
 
-    for (Song& t : tracks)
+// Remove a track from the library and its fingerprint from the index
+void PlaylistComponent::removeTrack(TrackId id)
+{
+    if (id == 0)
     {
-        myLibrary << t.file.getFullPathName() << "," << t.length << "\n";
+        return;
     }
+
+    fingerprintIndex.remove(id);
+    libraryStore.removeSong(id);
 }
 
-// Load the playlist from a file
-void PlaylistComponent::loadPreviousLibrary()
+// Convert seconds to minutes:seconds format
+juce::String PlaylistComponent::secondsToMinutes(double seconds)
 {
-    std::ifstream myLibrary("my-library.csv");
-    std::string filePath;
-    std::string length;
+    int secondsRounded{ int(std::round(seconds)) };
+    juce::String min{ std::to_string(secondsRounded / 60) };
+    juce::String sec{ std::to_string(secondsRounded % 60) };
 
-    if (myLibrary.is_open())
+    if (sec.length() < 2)
     {
-        while (getline(myLibrary, filePath, ',')) {
-            juce::File file{ filePath };
-            Song newTrack{ file };
+        sec = sec.paddedLeft('0', 2);
+    }
+    return juce::String{ min + ":" + sec };
+}
 
-            getline(myLibrary, length);
-            newTrack.length = length;
-            tracks.push_back(newTrack);
-        }
+// Open the library saved by the previous sessions
+void PlaylistComponent::loadPreviousLibrary()
+{
+    // the old text library was kept in the working directory
+    juce::File legacyCsv{ juce::File::getCurrentWorkingDirectory().getChildFile("my-library.csv") };
+    if (!libraryStore.open(appSettings.getDataDirectory(), legacyCsv))
+    {
+        std::cerr << "PlaylistComponent: the library can't be saved in " << appSettings.getDataDirectory().getFullPathName() << std::endl;
     }
-    myLibrary.close();
 }
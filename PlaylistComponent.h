@@ -5,21 +5,35 @@
 #include <vector>
 #include <algorithm>
 #include <string>
-#include <fstream>
 #include "Song.h"
 #include "DeckGUI.h"
 #include "DJAudioPlayer.h"
+#include "AppSettings.h"
+#include "LibraryStore.h"
+#include "LibraryImporter.h"
+#include "FolderWatcher.h"
+#include "FingerprintIndex.h"
+#include "SearchIndex.h"
+#include "LibraryView.h"
+#include "TrackAnalyzer.h"
+#include "AnalysisStore.h"
+#include "KeyIndex.h"
+#include "ThreadConfig.h"
 
 
 class PlaylistComponent : public juce::Component,
     public juce::TableListBoxModel,
     public juce::Button::Listener,
-    public juce::TextEditor::Listener
+    public juce::TextEditor::Listener,
+    private juce::MultiTimer
 {
 public:
     PlaylistComponent(DeckGUI* _deckGUI1,
         DeckGUI* _deckGUI2,
-        DJAudioPlayer* _playerForParsingMetaData
+        juce::AudioFormatManager& _formatManager,
+        ThreadConfig& _threadConfig,
+        AnalysisStore& _analysisStore,
+        AppSettings& _appSettings
     );
     ~PlaylistComponent() override;
 
@@ -44,14 +58,37 @@ public:
         int columnId,
         bool isRowSelected,
         Component* existingComponentToUpdate) override;
+    void sortOrderChanged(int newSortColumnId, bool isForwards) override;
     void buttonClicked(juce::Button* button) override;
+    void textEditorTextChanged(juce::TextEditor& editor) override;
 private:
-    // Table list box
-    std::vector<Song> tracks;
+    // Table list box, backed by the library store through a view of its rows
+    LibraryStore libraryStore;
+    LibraryView libraryView{ libraryStore };
     juce::TableListBox library;
+
+    // the last track decoded for painting, its cells are painted one after the other
+    TrackId paintedTrackId{ 0 };
+    Song paintedTrack{ juce::File{} };
+
+    // search box filtering the table as you type
+    juce::TextEditor searchBox;
+    SearchIndex searchIndex;
+    bool searchIndexBuilt{ false };
+
+    // filter keeping the tracks that mix in key with the playing deck, the key is the one
+    // of the deck that played last
+    juce::TextButton compatibleKeysButton{ "COMPATIBLE KEYS" };
+    KeyIndex keyIndex;
+    bool keyIndexBuilt{ false };
+    int compatibleKey{ -1 };
+
+    // keys are shown in the Open Key notation instead of Camelot
+    bool openKeyNotation{ false };
        
     // buttons
     juce::TextButton importButton{ "IMPORT TRACKS" };
+    juce::TextButton watchFolderButton{ "WATCH FOLDER" };
     juce::TextButton addToPlayer1Button{ "LOAD TO DECK 1" };
     juce::TextButton addToPlayer2Button{ "LOAD TO DECK 2" };
        
@@ -59,18 +96,136 @@ private:
     DeckGUI* deckGUI1;
     DeckGUI* deckGUI2;
 
-    // dj player
-    DJAudioPlayer* metaDataPlayer;
+    // settings, for the folder of the library
+    AppSettings& appSettings;
+
+    // reads imported files in the background
+    LibraryImporter importer;
+    double importProgress{ 0.0 };
+    juce::ProgressBar importProgressBar{ importProgress };
+
+    // finds copies of a track under another name or in another format
+    FingerprintIndex fingerprintIndex;
+
+    // tempo, beatgrid, key and loudness of the tracks, found in the background or taken from
+    // the analysis store
+    TrackAnalyzer trackAnalyzer;
+
+    // decks even out the loudness of the tracks they load toward the target, in LUFS
+    bool autoGain{ false };
+    double targetLoudness{ -14.0 };
+
+    // keeps the library in sync with the watched folders
+    FolderWatcher folderWatcher;
+    juce::StringArray watchedFolders;
+
+    // timers of the key filter and of the missing files sweep
+    enum TimerId
+    {
+        keyFilterTimer,
+        missingFilesTimer
+    };
+
+    // tracks of the watched folders whose files were deleted while the app was closed, looked
+    // for a slice at a time after startup
+    juce::StringArray sweepFolders;
+    std::vector<TrackId> sweepIds;
+    size_t sweepPosition{ 0 };
+
+    // purpose : add a batch of imported files to the library
+    // input : results of the importer
+    // output : void
+    void addImportedSongs(std::vector<ImportResult>& batch);
+
+    // purpose : get the track shown in a row of the table
+    // input : row
+    // output : id of the track
+    TrackId getTrackIdAtRow(int row);
+
+    // purpose : filter the table by the text of the search box and the compatible keys,
+    //           building each index on its first use
+    // input : none
+    // output : void
+    void updateFilter();
+
+    // purpose : get the key of the track on the playing deck
+    // input : none
+    // output : key, -1 if no deck plays a track of the library with a known key
+    int getPlayingKey();
+
+    // purpose : follow the key of the playing deck while filtering by it, and sweep for
+    //           missing files
+    // input : timer
+    // output : void
+    void timerCallback(int timerID) override;
+
+    // purpose : drop the tracks of the next slice of the library whose files are missing from
+    //           a watched folder
+    // input : none
+    // output : void
+    void sweepMissingFiles();
+
+    // purpose : update the table after the library changed, keeping the filter
+    // input : none
+    // output : void
+    void refreshTable();
+
+    // purpose : store what the analysis found out
+    // input : finished tracks
+    // output : void
+    void storeAnalysisResults(std::vector<AnalysisResult>& results);
+
+    // purpose : queue the tracks analysed before every analysis existed
+    // input : none
+    // output : void
+    void analyseMissingTracks();
+
+    // purpose : get the gain bringing a track to the target loudness, kept below the
+    //           true peak ceiling
+    // input : track
+    // output : gain in decibels, 0 when auto gain is off or the loudness isn't known
+    double getAutoGain(const Song& track);
+
+    // purpose : queue the tracks without a fingerprint
+    // input : none
+    // output : void
+    void fingerprintMissingTracks();
+
+    // purpose : drop a track found to be a copy of another
+    // input : id of the copy, id of the original
+    // output : void
+    void removeDuplicate(TrackId id, TrackId original);
+
+    // purpose : remove a track from the library and the fingerprint index
+    // input : id of the track
+    // output : void
+    void removeTrack(TrackId id);
+
+    // purpose : let the user pick a folder to watch
+    // input : none
+    // output : void
+    void addWatchedFolder();
+
+    // purpose : start watching the folders of the previous sessions, the tracks that were
+    //           deleted while the app was closed are dropped by the sweep after startup
+    // input : none
+    // output : void
+    void loadWatchedFolders();
+
+    // purpose : bring a batch of changes in the watched folders into the library
+    // input : changes found by the folder watcher
+    // output : void
+    void applyFolderChanges(FolderChanges& changes);
+
+    // purpose : point a stored track to the new path of its file
+    // input : id of the track, new file
+    // output : void
+    void moveSong(TrackId id, const juce::File& newFile);
 
-    juce::String getLength(juce::URL audioURL);
     juce::String secondsToMinutes(double seconds);
 
     void addSongsToPlaylist();
-    void savePlaylist();
     void loadPreviousLibrary();
-    void deleteSongFromPlaylist(int id);
-    bool checkSongExistance(juce::String fileNameWithoutExtension);
-    int findInPlaylist(juce::String searchText);
     void loadSongToPlayer(DeckGUI* deckGUI);
 
     FileChooser fChooser{ "Select Track" };
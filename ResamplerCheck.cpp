@@ -0,0 +1,239 @@
+#include "ResamplerCheck.h"
+#include <cmath>
+#include <limits>
+
+// the tones of the synthetic files, kept well below the device Nyquist at every speed
+static constexpr double toneFrequencies[] = { 220.0, 440.0, 1000.0, 2500.0 };
+static constexpr float toneLevel = 0.2f;
+static constexpr double toneSeconds = 4.0;
+
+// device rates and speeds rendered
+static constexpr double deviceRates[] = { 44100.0, 48000.0 };
+static constexpr double speeds[] = { 0.5, 0.94, 1.0, 1.06, 1.5 };
+
+// seconds rendered, the start is left out of the comparison while the filters settle
+static constexpr double renderSeconds = 2.0;
+static constexpr double settleSeconds = 0.1;
+
+// the chains can be a few samples apart, the comparison looks for the lag that fits best
+static constexpr int maxLag = 8;
+
+static constexpr int blockSize = 512;
+
+// purpose : render the first channel of a file through one of the chains
+// input : format manager, file, device rate, speed, whether to use the single stage, samples
+//         to render, time taken to fill
+// output : samples, empty if the file can't be read
+static std::vector<float> render(juce::AudioFormatManager& formatManager, const juce::File& file, double deviceRate,
+                                 double speed, bool singleStage, int numSamples, double& ms)
+{
+    juce::AudioFormatReader* reader{ formatManager.createReaderFor(file) };
+    if (reader == nullptr)
+    {
+        return {};
+    }
+
+    double fileRate{ reader->sampleRate };
+    juce::AudioFormatReaderSource source{ reader, true };
+
+    // set up the way DJAudioPlayer prepares its chain, before and after the fused stage
+    juce::AudioTransportSource transport;
+    transport.setSource(&source, 0, nullptr, singleStage ? 0.0 : fileRate);
+    juce::ResamplingAudioSource resampler{ &transport, false, 2 };
+
+    transport.prepareToPlay(blockSize, deviceRate);
+    if (singleStage)
+    {
+        resampler.setResamplingRatio(speed * fileRate / deviceRate);
+        resampler.prepareToPlay(blockSize, deviceRate);
+    }
+    else
+    {
+        resampler.prepareToPlay(blockSize, deviceRate);
+        resampler.setResamplingRatio(speed);
+    }
+    transport.start();
+
+    juce::AudioBuffer<float> buffer{ 2, blockSize };
+    std::vector<float> samples;
+    samples.reserve((size_t) numSamples);
+
+    double start{ juce::Time::getMillisecondCounterHiRes() };
+    for (int position = 0; position < numSamples; position += blockSize)
+    {
+        int count{ juce::jmin(blockSize, numSamples - position) };
+        resampler.getNextAudioBlock(juce::AudioSourceChannelInfo(&buffer, 0, count));
+        samples.insert(samples.end(), buffer.getReadPointer(0), buffer.getReadPointer(0) + count);
+    }
+    ms = juce::Time::getMillisecondCounterHiRes() - start;
+
+    transport.stop();
+    transport.setSource(nullptr);
+    return samples;
+}
+
+// purpose : get the exact tones as played at a speed
+// input : device rate, speed, samples
+// output : samples
+static std::vector<float> renderTones(double deviceRate, double speed, int numSamples)
+{
+    std::vector<float> samples((size_t) numSamples);
+    for (int i = 0; i < numSamples; ++i)
+    {
+        double time{ i * speed / deviceRate };
+        double value{ 0.0 };
+        for (double frequency : toneFrequencies)
+        {
+            value += toneLevel * std::sin(juce::MathConstants<double>::twoPi * frequency * time);
+        }
+        samples[(size_t) i] = (float) value;
+    }
+    return samples;
+}
+
+// purpose : get the level of the difference between two renders, at the lag that fits best
+// input : reference, render, samples left out at the start
+// output : level in dB relative to the reference
+static double getDifferenceDb(const std::vector<float>& reference, const std::vector<float>& other, int skip)
+{
+    int end{ (int) juce::jmin(reference.size(), other.size()) - maxLag };
+    double best{ std::numeric_limits<double>::max() };
+    double referenceEnergy{ 0.0 };
+
+    for (int i = skip; i < end; ++i)
+    {
+        referenceEnergy += (double) reference[(size_t) i] * reference[(size_t) i];
+    }
+
+    for (int lag = -maxLag; lag <= maxLag; ++lag)
+    {
+        double energy{ 0.0 };
+        for (int i = skip; i < end; ++i)
+        {
+            double difference{ (double) reference[(size_t) i] - other[(size_t) (i + lag)] };
+            energy += difference * difference;
+        }
+        best = juce::jmin(best, energy);
+    }
+
+    if (referenceEnergy <= 0.0)
+    {
+        return 0.0;
+    }
+    return 10.0 * std::log10(juce::jmax(best, 1.0e-20) / referenceEnergy);
+}
+
+bool ResamplerCheck::runFromCommandLine(const juce::String& commandLine)
+{
+    if (!commandLine.contains("--check-resampler"))
+    {
+        return false;
+    }
+
+    juce::StringArray arguments{ juce::StringArray::fromTokens(commandLine, true) };
+    juce::Array<juce::File> files;
+    for (int i = arguments.indexOf("--check-resampler") + 1; i < arguments.size() && !arguments[i].startsWith("--"); ++i)
+    {
+        files.add(juce::File::getCurrentWorkingDirectory().getChildFile(arguments[i].unquoted()));
+    }
+
+    bool passed{ true };
+    if (files.isEmpty())
+    {
+        juce::File scratch{ juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile("OtoDecks resampler check") };
+        std::cout << checkFiles(generateTones(scratch, { 44100.0, 48000.0, 96000.0 }), true, passed);
+        scratch.deleteRecursively();
+    }
+    else
+    {
+        std::cout << checkFiles(files, false, passed);
+    }
+
+    std::cout << (passed ? "resampler check passed" : "resampler check FAILED") << std::endl;
+    juce::JUCEApplicationBase::getInstance()->setApplicationReturnValue(passed ? 0 : 1);
+    return true;
+}
+
+juce::Array<juce::File> ResamplerCheck::generateTones(const juce::File& folder, const std::vector<double>& sampleRates)
+{
+    folder.createDirectory();
+    juce::WavAudioFormat wav;
+    juce::Array<juce::File> files;
+
+    for (double sampleRate : sampleRates)
+    {
+        juce::File file{ folder.getChildFile("tones " + juce::String((int) sampleRate) + ".wav") };
+        file.deleteFile();
+
+        std::unique_ptr<juce::OutputStream> stream{ file.createOutputStream() };
+        std::unique_ptr<juce::AudioFormatWriter> writer;
+        if (stream != nullptr)
+        {
+            writer.reset(wav.createWriterFor(stream.get(), sampleRate, 2, 24, {}, 0));
+        }
+        if (writer == nullptr)
+        {
+            std::cerr << "ResamplerCheck: can't write " << file.getFullPathName() << std::endl;
+            continue;
+        }
+        stream.release();
+
+        int numSamples{ (int) (toneSeconds * sampleRate) };
+        std::vector<float> tones{ renderTones(sampleRate, 1.0, numSamples) };
+        const float* channels[]{ tones.data(), tones.data() };
+        writer->writeFromFloatArrays(channels, 2, numSamples);
+        files.add(file);
+    }
+    return files;
+}
+
+juce::String ResamplerCheck::checkFiles(const juce::Array<juce::File>& files, bool areTones, bool& passed)
+{
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    juce::String report;
+    for (const juce::File& file : files)
+    {
+        for (double deviceRate : deviceRates)
+        {
+            for (double speed : speeds)
+            {
+                int numSamples{ (int) (renderSeconds * deviceRate) };
+                int skip{ (int) (settleSeconds * deviceRate) };
+                double singleMs{ 0.0 };
+                double twoStageMs{ 0.0 };
+                std::vector<float> single{ render(formatManager, file, deviceRate, speed, true, numSamples, singleMs) };
+                std::vector<float> twoStage{ render(formatManager, file, deviceRate, speed, false, numSamples, twoStageMs) };
+                if (single.empty() || twoStage.empty())
+                {
+                    report << file.getFileName() << ": can't be read" << juce::newLine;
+                    passed = false;
+                    break;
+                }
+
+                double differenceDb{ getDifferenceDb(twoStage, single, skip) };
+                bool ok{ differenceDb <= maxDifferenceDb };
+
+                report << file.getFileName() << " at " << (int) deviceRate << " Hz, speed " << juce::String(speed, 2)
+                       << ": chains differ by " << juce::String(differenceDb, 1) << " dB";
+
+                // against the exact tones the single stage has to be at least as close
+                if (areTones)
+                {
+                    std::vector<float> exact{ renderTones(deviceRate, speed, numSamples) };
+                    double singleErrorDb{ getDifferenceDb(exact, single, skip) };
+                    double twoStageErrorDb{ getDifferenceDb(exact, twoStage, skip) };
+                    ok = ok && singleErrorDb <= twoStageErrorDb + 0.5;
+                    report << ", error " << juce::String(singleErrorDb, 1) << " dB single, "
+                           << juce::String(twoStageErrorDb, 1) << " dB two stages";
+                }
+
+                report << ", " << juce::String(singleMs, 2) << " ms single, " << juce::String(twoStageMs, 2)
+                       << " ms two stages" << (ok ? "" : "  FAILED") << juce::newLine;
+                passed = passed && ok;
+            }
+        }
+    }
+    return report;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+// ResamplerCheck renders files whose sample rate differs from the device through the single
+// resampling stage of the decks and through the two-stage chain it replaced, where the
+// transport converted the file rate and a second resampler applied the speed. It is run from
+// the command line instead of opening the window:
+//
+//   OtoDecks --check-resampler [file ...]      files to check, synthetic tones at 44.1, 48 and
+//                                              96 kHz when none are given
+//
+// Every file is rendered at 44.1 and 48 kHz device rates and at several speeds. The report gives
+// the level of the difference between the two chains and the time each took. Synthetic files
+// are also compared with the exact tones, and the check fails if the single stage is more than
+// half a dB further from them than the two stages, or if the chains differ by more than maxDifferenceDb.
+class ResamplerCheck
+{
+public:
+
+    // the chains agree within this, in dB relative to the signal
+    static constexpr double maxDifferenceDb = -30.0;
+
+    // purpose : run the check if it is asked for on the command line
+    // input : command line of the app
+    // output : true if the check was run and the app should quit
+    static bool runFromCommandLine(const juce::String& commandLine);
+
+    // purpose : write files of a few steady tones at a sample rate
+    // input : folder, sample rates
+    // output : the files written
+    static juce::Array<juce::File> generateTones(const juce::File& folder, const std::vector<double>& sampleRates);
+
+    // purpose : compare the two chains on files
+    // input : files, whether they hold the synthetic tones, set to false if a comparison fails
+    // output : report
+    static juce::String checkFiles(const juce::Array<juce::File>& files, bool areTones, bool& passed);
+};
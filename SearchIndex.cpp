@@ -0,0 +1,314 @@
+#include "SearchIndex.h"
+#include <algorithm>
+#include <cctype>
+
+// word starts get their own keys, apart from the trigrams
+static constexpr juce::uint32 prefixKeyFlag = 0x80000000u;
+
+// weight of a hit in title, artist, album and path
+static constexpr int fieldWeights[4] = { 8, 6, 4, 1 };
+
+// highest score, scores are bucketed to rank without a comparison sort
+static constexpr int maxScore = 255;
+
+static juce::uint32 trigramKey(const char* text)
+{
+    return ((juce::uint32) (juce::uint8) text[0] << 16) | ((juce::uint32) (juce::uint8) text[1] << 8) | (juce::uint32) (juce::uint8) text[2];
+}
+
+static juce::uint32 prefixKey(const char* text, size_t length)
+{
+    juce::uint32 key{ prefixKeyFlag | ((juce::uint32) (juce::uint8) text[0] << 8) };
+    if (length > 1)
+    {
+        key |= (juce::uint32) (juce::uint8) text[1];
+    }
+    return key;
+}
+
+static bool isWordStart(const std::string& text, size_t position)
+{
+    return position == 0 || text[position - 1] == ' ' || text[position - 1] == '\n' || text[position - 1] == '/';
+}
+
+SearchIndex::SearchIndex()
+{
+}
+
+SearchIndex::~SearchIndex()
+{
+}
+
+void SearchIndex::addSong(const Song& song)
+{
+    removeSong(song.id);
+
+    Document document;
+    document.id = song.id;
+    document.text = normalize(song.title) + "\n" + normalize(song.artist) + "\n" + normalize(song.album) + "\n"
+        + normalize(song.file.getFullPathName());
+
+    juce::uint32 index{ (juce::uint32) documents.size() };
+    documents.push_back(std::move(document));
+    documentOfTrack[song.id] = index;
+    indexDocument(index);
+}
+
+void SearchIndex::removeSong(TrackId id)
+{
+    auto it = documentOfTrack.find(id);
+    if (it == documentOfTrack.end())
+    {
+        return;
+    }
+
+    Document& document{ documents[it->second] };
+    document.live = false;
+    document.text.clear();
+    document.text.shrink_to_fit();
+    documentOfTrack.erase(it);
+
+    // removed documents are skipped until they outnumber the live ones
+    if (++numDeleted > 1024 && numDeleted > (int) documentOfTrack.size())
+    {
+        compact();
+    }
+}
+
+void SearchIndex::clear()
+{
+    documents.clear();
+    documentOfTrack.clear();
+    postings.clear();
+    numDeleted = 0;
+}
+
+int SearchIndex::getNumTracks()
+{
+    return (int) documentOfTrack.size();
+}
+
+std::vector<TrackId> SearchIndex::search(const juce::String& query)
+{
+    std::vector<TrackId> results;
+
+    std::vector<std::string> terms;
+    juce::StringArray tokens{ juce::StringArray::fromTokens(juce::String{ juce::CharPointer_UTF8(normalize(query).c_str()) }, " ", "") };
+    tokens.removeEmptyStrings();
+    for (const juce::String& token : tokens)
+    {
+        terms.push_back(token.toStdString());
+    }
+    if (terms.empty())
+    {
+        return results;
+    }
+
+    // the posting lists of every key of every term, shortest first
+    std::vector<const std::vector<juce::uint32>*> lists;
+    for (const std::string& term : terms)
+    {
+        for (juce::uint32 key : keysOfTerm(term))
+        {
+            auto it = postings.find(key);
+            if (it == postings.end())
+            {
+                return results;
+            }
+            lists.push_back(&it->second);
+        }
+    }
+    std::sort(lists.begin(), lists.end(), [](const auto* a, const auto* b) { return a->size() < b->size(); });
+
+    // posting lists are sorted by document, intersect them by galloping through the longer ones
+    std::vector<juce::uint32> candidates{ *lists.front() };
+    for (size_t i = 1; i < lists.size() && !candidates.empty(); ++i)
+    {
+        const std::vector<juce::uint32>& list{ *lists[i] };
+        auto position = list.begin();
+        size_t kept{ 0 };
+        for (juce::uint32 candidate : candidates)
+        {
+            position = std::lower_bound(position, list.end(), candidate);
+            if (position == list.end())
+            {
+                break;
+            }
+            if (*position == candidate)
+            {
+                candidates[kept++] = candidate;
+            }
+        }
+        candidates.resize(kept);
+    }
+
+    // trigrams can match apart from each other, the text decides, then bucket by score
+    std::vector<std::vector<TrackId>> buckets((size_t) maxScore + 1);
+    for (juce::uint32 candidate : candidates)
+    {
+        const Document& document{ documents[candidate] };
+        if (!document.live)
+        {
+            continue;
+        }
+
+        int points{ score(document.text, terms) };
+        if (points > 0)
+        {
+            buckets[(size_t) juce::jmin(points, maxScore)].push_back(document.id);
+        }
+    }
+
+    for (int points = maxScore; points > 0; --points)
+    {
+        results.insert(results.end(), buckets[(size_t) points].begin(), buckets[(size_t) points].end());
+    }
+    return results;
+}
+
+std::string SearchIndex::normalize(const juce::String& text)
+{
+    std::string normalized{ text.toLowerCase().toStdString() };
+    for (char& c : normalized)
+    {
+        // only ascii punctuation, the bytes of other characters are kept as they are
+        if ((juce::uint8) c < 0x80 && !std::isalnum((unsigned char) c))
+        {
+            c = ' ';
+        }
+    }
+    return normalized;
+}
+
+std::vector<juce::uint32> SearchIndex::keysOfTerm(const std::string& term)
+{
+    std::vector<juce::uint32> keys;
+
+    if (term.size() < 3)
+    {
+        if (!term.empty())
+        {
+            keys.push_back(prefixKey(term.data(), term.size()));
+        }
+        return keys;
+    }
+
+    for (size_t i = 0; i + 3 <= term.size(); ++i)
+    {
+        keys.push_back(trigramKey(term.data() + i));
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+void SearchIndex::indexDocument(juce::uint32 index)
+{
+    const std::string& text{ documents[index].text };
+
+    std::vector<juce::uint32> keys;
+    keys.reserve(text.size() + 16);
+
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        if (text[i] == ' ' || text[i] == '\n')
+        {
+            continue;
+        }
+
+        if (isWordStart(text, i))
+        {
+            keys.push_back(prefixKey(text.data() + i, 1));
+            if (i + 1 < text.size() && text[i + 1] != ' ' && text[i + 1] != '\n')
+            {
+                keys.push_back(prefixKey(text.data() + i, 2));
+            }
+        }
+
+        if (i + 3 <= text.size())
+        {
+            keys.push_back(trigramKey(text.data() + i));
+        }
+    }
+
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    // documents are only ever appended, so the posting lists stay sorted
+    for (juce::uint32 key : keys)
+    {
+        postings[key].push_back(index);
+    }
+}
+
+int SearchIndex::score(const std::string& text, const std::vector<std::string>& terms)
+{
+    // the fields start after each newline
+    size_t fieldStarts[4] = { 0, 0, 0, 0 };
+    int field{ 1 };
+    for (size_t i = 0; i < text.size() && field < 4; ++i)
+    {
+        if (text[i] == '\n')
+        {
+            fieldStarts[field++] = i + 1;
+        }
+    }
+
+    int total{ 0 };
+    for (const std::string& term : terms)
+    {
+        int best{ 0 };
+        for (size_t position = text.find(term); position != std::string::npos; position = text.find(term, position + 1))
+        {
+            int fieldIndex{ 3 };
+            while (fieldIndex > 0 && position < fieldStarts[fieldIndex])
+            {
+                --fieldIndex;
+            }
+
+            // a whole word beats a word start beats the middle of a word
+            int points{ fieldWeights[fieldIndex] };
+            if (isWordStart(text, position))
+            {
+                size_t end{ position + term.size() };
+                bool wholeWord{ end == text.size() || text[end] == ' ' || text[end] == '\n' };
+                points *= wholeWord ? 4 : 2;
+            }
+
+            best = juce::jmax(best, points);
+        }
+
+        if (best == 0)
+        {
+            return 0;
+        }
+        total += best;
+    }
+
+    // earlier terms count the same as later ones, keep the total in range
+    return juce::jmax(1, total * 8 / (int) terms.size());
+}
+
+void SearchIndex::compact()
+{
+    std::vector<Document> live;
+    live.reserve(documentOfTrack.size());
+    for (Document& document : documents)
+    {
+        if (document.live)
+        {
+            live.push_back(std::move(document));
+        }
+    }
+
+    documents = std::move(live);
+    documentOfTrack.clear();
+    postings.clear();
+    numDeleted = 0;
+
+    for (juce::uint32 index = 0; index < (juce::uint32) documents.size(); ++index)
+    {
+        documentOfTrack[documents[index].id] = index;
+        indexDocument(index);
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Song.h"
+
+// SearchIndex answers search-as-you-type queries over title, artist, album and path.
+// Every track is lowercased into one searchable text and each distinct trigram of that text
+// points to the tracks holding it, together with the one and two letter word starts for
+// queries that are too short for a trigram. A query intersects the posting lists of its
+// terms, shortest first, checks the few remaining tracks against the text and ranks them
+// by the field and place each term was found in.
+// Tracks are added, changed and removed one at a time, removed tracks are skipped until
+// enough of them piled up to rebuild the posting lists.
+class SearchIndex
+{
+public:
+
+    SearchIndex();
+
+    ~SearchIndex();
+
+    // purpose : add a track, or replace it if it is already indexed
+    // input : track with a valid id
+    // output : void
+    void addSong(const Song& song);
+
+    // purpose : remove a track
+    // input : id of the track
+    // output : void
+    void removeSong(TrackId id);
+
+    // purpose : forget every track
+    // input : none
+    // output : void
+    void clear();
+
+    // purpose : get the number of indexed tracks
+    // input : none
+    // output : number of tracks
+    int getNumTracks();
+
+    // purpose : find the tracks matching every term of a query
+    // input : query, terms split by spaces
+    // output : ids of the matching tracks, best match first
+    std::vector<TrackId> search(const juce::String& query);
+
+private:
+
+    struct Document
+    {
+        TrackId id{ 0 };
+        // title \n artist \n album \n path, lowercased
+        std::string text;
+        bool live{ true };
+    };
+
+    std::vector<Document> documents;
+    std::unordered_map<TrackId, juce::uint32> documentOfTrack;
+    std::unordered_map<juce::uint32, std::vector<juce::uint32>> postings;
+    int numDeleted{ 0 };
+
+    // purpose : lowercase and turn punctuation into spaces
+    // input : text
+    // output : normalized utf-8 text
+    static std::string normalize(const juce::String& text);
+
+    // purpose : get the posting list keys of a term, trigrams or a word start
+    // input : term
+    // output : keys, empty if the term has no characters
+    static std::vector<juce::uint32> keysOfTerm(const std::string& term);
+
+    // purpose : add the keys of a document to the posting lists
+    // input : index of the document
+    // output : void
+    void indexDocument(juce::uint32 document);
+
+    // purpose : score how well a document matches the terms
+    // input : document text, terms
+    // output : score, 0 if a term is missing
+    static int score(const std::string& text, const std::vector<std::string>& terms);
+
+    // purpose : rebuild the posting lists without the removed documents
+    // input : none
+    // output : void
+    void compact();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SearchIndex)
+};
@@ -1,15 +1,52 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include <vector>
+
+// stable identifier of a track in the library, 0 means not stored yet
+using TrackId = juce::uint64;
+
+// a beat from which the grid runs at a steady tempo, until the next marker
+struct BeatMarker
+{
+    double time{ 0.0 };
+    double bpm{ 0.0 };
+};
 
 class Song
 {
 public:
     Song(juce::File _file);
+    TrackId id{ 0 };
     juce::File file;
     juce::URL URL;
     juce::String title;
-    juce::String length;
+    juce::String artist;
+    juce::String album;
+    double lengthInSeconds{ 0.0 };
+    double sampleRate{ 0.0 };
+    int numChannels{ 0 };
+    int bitrate{ 0 };
+
+    // identity of the file when it was read, to spot changes
+    juce::int64 fileSize{ 0 };
+    juce::int64 modificationTime{ 0 };
+
+    // tempo and beatgrid found by the analysis, 0 and empty until then. The first marker is
+    // the first downbeat, a track that drifts gets a marker where its tempo changed
+    double bpm{ 0.0 };
+    std::vector<BeatMarker> beatGrid;
+
+    // musical key found by the analysis, 0 to 11 for the major keys from C, 12 to 23 for the
+    // minor keys from C, -1 until then
+    int key{ -1 };
+
+    // integrated loudness in LUFS and true peak in dBTP, loudness is 0 until analysed
+    double loudness{ 0.0 };
+    double truePeak{ 0.0 };
+
+    // version of the analysis the results above came from, 0 before the first
+    int analysisVersion{ 0 };
 
     bool operator==(const juce::String& other) const;
 };
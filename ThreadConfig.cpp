@@ -0,0 +1,348 @@
+#include "ThreadConfig.h"
+
+#if JUCE_LINUX
+ #include <pthread.h>
+ #include <sched.h>
+ #include <sys/resource.h>
+ #include <sys/syscall.h>
+ #include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+
+// read the settings of every role, background work gets a lower priority by default
+ThreadConfig::ThreadConfig(AppSettings& settings)
+{
+    auto& props = settings.getProperties();
+
+    roles[(size_t) Role::audio] = readRole(props, Role::audio, Policy::unchanged, 0);
+    roles[(size_t) Role::deckWorker] = readRole(props, Role::deckWorker, Policy::unchanged, 0);
+    roles[(size_t) Role::loader] = readRole(props, Role::loader, Policy::unchanged, 5);
+    roles[(size_t) Role::analysis] = readRole(props, Role::analysis, Policy::batch, 10);
+}
+
+ThreadConfig::~ThreadConfig()
+{
+    cancelPendingUpdate();
+}
+
+void ThreadConfig::applyToCurrentThread(Role role)
+{
+    // a thread keeps its settings, so only apply them on the first call
+    thread_local int currentRole = -1;
+    if (currentRole == (int) role)
+    {
+        return;
+    }
+    currentRole = (int) role;
+
+    const RoleSettings& settings = roles[(size_t) role];
+    int schedulingError = 0;
+    int affinityError = 0;
+    int niceError = 0;
+
+#if JUCE_LINUX
+    if (settings.policy != Policy::unchanged)
+    {
+        sched_param param{};
+        int policy = SCHED_OTHER;
+
+        switch (settings.policy)
+        {
+            case Policy::fifo:
+                policy = SCHED_FIFO;
+                param.sched_priority = settings.priority;
+                break;
+            case Policy::roundRobin:
+                policy = SCHED_RR;
+                param.sched_priority = settings.priority;
+                break;
+            case Policy::batch:
+                policy = SCHED_BATCH;
+                break;
+            case Policy::idle:
+                policy = SCHED_IDLE;
+                break;
+            default:
+                break;
+        }
+
+        // pthread functions return the error number instead of setting errno
+        schedulingError = pthread_setschedparam(pthread_self(), policy, &param);
+    }
+
+    if (!settings.cpus.empty())
+    {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        for (int cpu : settings.cpus)
+        {
+            if (cpu < CPU_SETSIZE)
+            {
+                CPU_SET(cpu, &cpuSet);
+            }
+        }
+        affinityError = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+    }
+
+    // on Linux the nice value is per thread when addressed by the thread id
+    if (settings.changeNice
+        && setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), settings.niceValue) != 0)
+    {
+        niceError = errno;
+    }
+#else
+    if (!settings.cpus.empty())
+    {
+        juce::uint32 mask = 0;
+        for (int cpu : settings.cpus)
+        {
+            if (cpu < 32)
+            {
+                mask |= (1u << cpu);
+            }
+        }
+        juce::Thread::setCurrentThreadAffinityMask(mask);
+    }
+
+    if (settings.policy != Policy::unchanged)
+    {
+        schedulingError = ENOTSUP;
+    }
+    if (settings.changeNice)
+    {
+        niceError = ENOTSUP;
+    }
+#endif
+
+    RoleResult& result = results[(size_t) role];
+    result.schedulingError = schedulingError;
+    result.affinityError = affinityError;
+    result.niceError = niceError;
+    result.applied = true;
+
+    // safe from the audio thread, the message is preallocated
+    triggerAsyncUpdate();
+}
+
+juce::String ThreadConfig::getReport()
+{
+    juce::String report;
+
+    for (int i = 0; i < numRoles; ++i)
+    {
+        const RoleSettings& settings = roles[(size_t) i];
+        const RoleResult& result = results[(size_t) i];
+
+        report << getRoleName(Role(i)) << ": " << getPolicyName(settings.policy);
+        if (settings.policy == Policy::fifo || settings.policy == Policy::roundRobin)
+        {
+            report << " priority " << settings.priority;
+        }
+        if (settings.changeNice)
+        {
+            report << ", nice " << settings.niceValue;
+        }
+        if (!settings.cpus.empty())
+        {
+            report << ", cpus " << settings.cpuText;
+        }
+
+        if (!result.applied)
+        {
+            report << " -> no thread started yet\n";
+            continue;
+        }
+
+        juce::StringArray problems;
+        if (int error = result.schedulingError.load())
+        {
+            juce::String problem{ "scheduling policy denied (" + juce::String(std::strerror(error)) + ")" };
+#if JUCE_LINUX
+            if (error == EPERM && (settings.policy == Policy::fifo || settings.policy == Policy::roundRobin))
+            {
+                rlimit limit{};
+                getrlimit(RLIMIT_RTPRIO, &limit);
+                problem << ": realtime priority " << settings.priority << " needs CAP_SYS_NICE or an rtprio limit of at least "
+                        << settings.priority << " (current RLIMIT_RTPRIO is " << (int) limit.rlim_cur
+                        << "), e.g. add the user to the audio group with '@audio - rtprio 95' in /etc/security/limits.d/";
+            }
+#endif
+            problems.add(problem);
+        }
+        if (int error = result.affinityError.load())
+        {
+            problems.add("cpu pinning denied (" + juce::String(std::strerror(error)) + "), check that cpus "
+                         + settings.cpuText + " exist and are not excluded by a cgroup cpuset");
+        }
+        if (int error = result.niceError.load())
+        {
+            juce::String problem{ "nice value denied (" + juce::String(std::strerror(error)) + ")" };
+            if (error == EPERM)
+            {
+                problem << ": a negative nice value needs CAP_SYS_NICE or a nice limit in /etc/security/limits.d/";
+            }
+            problems.add(problem);
+        }
+
+        if (problems.isEmpty())
+        {
+            report << " -> granted\n";
+        }
+        else
+        {
+            report << " -> " << problems.joinIntoString("; ") << "\n";
+        }
+    }
+
+    return report;
+}
+
+ThreadConfig::RoleSettings ThreadConfig::readRole(juce::PropertiesFile& props, Role role, Policy defaultPolicy, int defaultNice)
+{
+    RoleSettings settings;
+    juce::String prefix{ getRoleName(role) + "." };
+
+    juce::String policyText{ props.getValue(prefix + "policy").trim().toLowerCase() };
+    if (policyText == "fifo")
+    {
+        settings.policy = Policy::fifo;
+    }
+    else if (policyText == "rr")
+    {
+        settings.policy = Policy::roundRobin;
+    }
+    else if (policyText == "batch")
+    {
+        settings.policy = Policy::batch;
+    }
+    else if (policyText == "idle")
+    {
+        settings.policy = Policy::idle;
+    }
+    else if (policyText.isEmpty())
+    {
+        settings.policy = defaultPolicy;
+    }
+    else if (policyText != "default")
+    {
+        std::cerr << "ThreadConfig: unknown policy '" << policyText << "' for " << getRoleName(role) << std::endl;
+    }
+
+    settings.priority = juce::jlimit(1, 99, props.getIntValue(prefix + "priority", 70));
+
+    if (props.containsKey(prefix + "nice"))
+    {
+        settings.niceValue = juce::jlimit(-20, 19, props.getIntValue(prefix + "nice"));
+        settings.changeNice = true;
+    }
+    else if (defaultNice != 0)
+    {
+        settings.niceValue = defaultNice;
+        settings.changeNice = true;
+    }
+
+    settings.cpuText = props.getValue(prefix + "cpus").trim();
+    settings.cpus = parseCpuList(settings.cpuText);
+
+    return settings;
+}
+
+std::vector<int> ThreadConfig::parseCpuList(const juce::String& text)
+{
+    std::vector<int> cpus;
+
+    for (const juce::String& item : juce::StringArray::fromTokens(text, ",", ""))
+    {
+        juce::String range{ item.trim() };
+        if (range.isEmpty())
+        {
+            continue;
+        }
+
+        int first = range.upToFirstOccurrenceOf("-", false, false).getIntValue();
+        int last = range.contains("-") ? range.fromFirstOccurrenceOf("-", false, false).getIntValue() : first;
+
+        for (int cpu = juce::jmax(0, first); cpu <= last; ++cpu)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+
+    return cpus;
+}
+
+juce::String ThreadConfig::getRoleName(Role role)
+{
+    switch (role)
+    {
+        case Role::audio: return "audio";
+        case Role::deckWorker: return "deckWorker";
+        case Role::loader: return "loader";
+        case Role::analysis: return "analysis";
+    }
+    return {};
+}
+
+juce::String ThreadConfig::getPolicyName(Policy policy)
+{
+    switch (policy)
+    {
+        case Policy::unchanged: return "default";
+        case Policy::fifo: return "fifo";
+        case Policy::roundRobin: return "rr";
+        case Policy::batch: return "batch";
+        case Policy::idle: return "idle";
+    }
+    return {};
+}
+
+void ThreadConfig::handleAsyncUpdate()
+{
+    juce::StringArray failures;
+
+    for (int i = 0; i < numRoles; ++i)
+    {
+        const RoleResult& result = results[(size_t) i];
+        if (!result.applied || reported[(size_t) i])
+        {
+            continue;
+        }
+        reported[(size_t) i] = true;
+
+        if (result.schedulingError != 0 || result.affinityError != 0 || result.niceError != 0)
+        {
+            failures.add(getRoleName(Role(i)));
+        }
+    }
+
+    // every pool thread applies its role when it starts, only print what is new
+    juce::String report{ getReport() };
+    if (report != printedReport)
+    {
+        printedReport = report;
+        std::cout << "ThreadConfig:\n" << report << std::endl;
+    }
+
+    if (!failures.isEmpty())
+    {
+        std::cerr << "ThreadConfig: requested thread settings not available for " << failures.joinIntoString(", ") << std::endl;
+        juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon,
+            "Thread settings not available",
+            "Some of the requested thread priorities or CPU sets could not be applied:\n\n" + report);
+    }
+}
+
+ConfiguredTimeSliceThread::ConfiguredTimeSliceThread(const juce::String& name, ThreadConfig& threadConfig, ThreadConfig::Role role)
+    : juce::TimeSliceThread(name),
+    config(threadConfig),
+    threadRole(role)
+{
+}
+
+void ConfiguredTimeSliceThread::run()
+{
+    config.applyToCurrentThread(threadRole);
+    juce::TimeSliceThread::run();
+}
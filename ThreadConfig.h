@@ -0,0 +1,115 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <vector>
+#include "AppSettings.h"
+
+// ThreadConfig applies the scheduling policy, priority and CPU pinning chosen in the
+// settings file to the threads of the app. Each thread type has its own role, read
+// from the keys "<role>.policy" (default, fifo, rr, batch, idle), "<role>.priority"
+// (1-99 for fifo/rr), "<role>.cpus" (e.g. "2,3" or "4-7") and "<role>.nice" (-20..19).
+// The realtime part is only implemented on Linux, other platforms only get the pinning.
+class ThreadConfig : private juce::AsyncUpdater
+{
+public:
+
+    // the kinds of threads that can be configured
+    enum class Role
+    {
+        audio = 0,
+        deckWorker,
+        loader,
+        analysis
+    };
+
+    static constexpr int numRoles = 4;
+
+    ThreadConfig(AppSettings& settings);
+
+    ~ThreadConfig() override;
+
+    // purpose : apply the settings of a role to the calling thread. It does not allocate or
+    //           lock so it can be called at the top of the audio callback, and it does nothing
+    //           when the thread already runs with that role
+    // input : role of the calling thread
+    // output : void
+    void applyToCurrentThread(Role role);
+
+    // purpose : describe what was requested for each role and whether it was granted
+    // input : none
+    // output : human readable report
+    juce::String getReport();
+
+private:
+
+    enum class Policy
+    {
+        unchanged,
+        fifo,
+        roundRobin,
+        batch,
+        idle
+    };
+
+    struct RoleSettings
+    {
+        Policy policy{ Policy::unchanged };
+        int priority{ 0 };
+        int niceValue{ 0 };
+        bool changeNice{ false };
+        std::vector<int> cpus;
+        juce::String cpuText;
+    };
+
+    // outcome of the last apply for a role, stored as errno values (0 = granted)
+    struct RoleResult
+    {
+        std::atomic<bool> applied{ false };
+        std::atomic<int> schedulingError{ 0 };
+        std::atomic<int> affinityError{ 0 };
+        std::atomic<int> niceError{ 0 };
+    };
+
+    std::array<RoleSettings, numRoles> roles;
+    std::array<RoleResult, numRoles> results;
+
+    // purpose : read the settings of one role, falling back to the given defaults
+    // input : properties file, role, default policy and nice value
+    // output : parsed settings
+    static RoleSettings readRole(juce::PropertiesFile& props, Role role, Policy defaultPolicy, int defaultNice);
+
+    // purpose : parse a cpu list like "0,2,4-7"
+    // input : text of the list
+    // output : cpu numbers
+    static std::vector<int> parseCpuList(const juce::String& text);
+
+    static juce::String getRoleName(Role role);
+    static juce::String getPolicyName(Policy policy);
+
+    // reports failures on the message thread, as the audio thread can't log or show dialogs
+    void handleAsyncUpdate() override;
+
+    // failures already shown to the user, so each one is only reported once
+    std::array<bool, numRoles> reported{};
+
+    // report last printed, it is printed again only when it changes
+    juce::String printedReport;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ThreadConfig)
+};
+
+// a TimeSliceThread that applies the settings of its role as soon as it starts running
+class ConfiguredTimeSliceThread : public juce::TimeSliceThread
+{
+public:
+
+    ConfiguredTimeSliceThread(const juce::String& name, ThreadConfig& threadConfig, ThreadConfig::Role role);
+
+    void run() override;
+
+private:
+    ThreadConfig& config;
+    ThreadConfig::Role threadRole;
+};
@@ -0,0 +1,373 @@
+#include "TrackAnalyzer.h"
+#include "BeatAnalyzer.h"
+#include "KeyAnalyzer.h"
+#include "LoudnessAnalyzer.h"
+#include <algorithm>
+
+// samples decoded at a time
+static constexpr int blockSize = 65536;
+
+// names of the built in analyzers in the analysis store
+static const char* const beatsAnalyzer = "beats";
+static const char* const keyAnalyzer = "key";
+static const char* const loudnessAnalyzer = "loudness";
+
+// tempo and beatgrid: bpm, number of markers and the time and bpm of every marker
+class BeatsTask : public AnalysisTask
+{
+public:
+    BeatsTask(double sampleRate) : beats(sampleRate) {}
+
+    void process(const juce::AudioBuffer<float>&, const float* mono, int numSamples) override
+    {
+        beats.process(mono, numSamples);
+    }
+
+    juce::MemoryBlock getResult() override
+    {
+        juce::MemoryOutputStream out;
+        std::vector<BeatMarker> beatGrid{ beats.getBeatGrid() };
+        out.writeDouble(beats.getBpm());
+        out.writeInt((int) beatGrid.size());
+        for (const BeatMarker& marker : beatGrid)
+        {
+            out.writeDouble(marker.time);
+            out.writeDouble(marker.bpm);
+        }
+        return out.getMemoryBlock();
+    }
+
+private:
+    BeatAnalyzer beats;
+};
+
+// key: the key as numbered in Song
+class KeyTask : public AnalysisTask
+{
+public:
+    KeyTask(double sampleRate) : key(sampleRate) {}
+
+    void process(const juce::AudioBuffer<float>&, const float* mono, int numSamples) override
+    {
+        key.process(mono, numSamples);
+    }
+
+    juce::MemoryBlock getResult() override
+    {
+        juce::MemoryOutputStream out;
+        out.writeInt(key.getKey());
+        return out.getMemoryBlock();
+    }
+
+private:
+    KeyAnalyzer key;
+};
+
+// loudness: integrated loudness and true peak
+class LoudnessTask : public AnalysisTask
+{
+public:
+    LoudnessTask(double sampleRate, int numChannels) : loudness(sampleRate, numChannels, blockSize) {}
+
+    void process(const juce::AudioBuffer<float>& buffer, const float*, int numSamples) override
+    {
+        loudness.process(buffer, numSamples);
+    }
+
+    juce::MemoryBlock getResult() override
+    {
+        juce::MemoryOutputStream out;
+        out.writeDouble(loudness.getLoudness());
+        out.writeDouble(loudness.getTruePeak());
+        return out.getMemoryBlock();
+    }
+
+private:
+    LoudnessAnalyzer loudness;
+};
+
+class TrackAnalyzer::Worker : public juce::ThreadPoolJob
+{
+public:
+    Worker(TrackAnalyzer& _owner)
+        : juce::ThreadPoolJob("Analysis"),
+        owner(_owner)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        owner.threadConfig.applyToCurrentThread(ThreadConfig::Role::analysis);
+
+        Request request;
+        while (!shouldExit() && owner.takeRequest(request))
+        {
+            AnalysisResult result{ owner.analyzeFile(request, *this) };
+
+            const juce::ScopedLock lock(owner.resultsLock);
+            owner.pendingResults.push_back(std::move(result));
+        }
+        return jobHasFinished;
+    }
+
+private:
+    TrackAnalyzer& owner;
+};
+
+TrackAnalyzer::TrackAnalyzer(juce::AudioFormatManager& _formatManager, ThreadConfig& _threadConfig, AnalysisStore& _analysisStore)
+    : formatManager(_formatManager),
+    threadConfig(_threadConfig),
+    analysisStore(_analysisStore),
+    numWorkers(juce::jmax(1, juce::SystemStats::getNumCpus() - 1)),
+    pool(numWorkers, 0, juce::Thread::Priority::low)
+{
+    registerAnalyzer(beatsAnalyzer, 1, [](double sampleRate, int, juce::int64) { return std::make_unique<BeatsTask>(sampleRate); });
+    registerAnalyzer(keyAnalyzer, 1, [](double sampleRate, int, juce::int64) { return std::make_unique<KeyTask>(sampleRate); });
+    registerAnalyzer(loudnessAnalyzer, 1, [](double sampleRate, int numChannels, juce::int64) { return std::make_unique<LoudnessTask>(sampleRate, numChannels); });
+}
+
+TrackAnalyzer::~TrackAnalyzer()
+{
+    stopTimer();
+    {
+        const juce::ScopedLock lock(queueLock);
+        queue.clear();
+        queuedIds.clear();
+    }
+    pool.removeAllJobs(true, 5000);
+}
+
+void TrackAnalyzer::registerAnalyzer(const juce::String& name, int version, TaskFactory createTask)
+{
+    jassert(activeWorkers == 0);
+    analyzers.push_back({ name, version, std::move(createTask) });
+}
+
+int TrackAnalyzer::getAnalysisVersion()
+{
+    // a hash of every name and version, so no other set of analyzers gives the same number
+    juce::StringArray pairs;
+    for (const Analyzer& analyzer : analyzers)
+    {
+        pairs.add(analyzer.name + ":" + juce::String(analyzer.version));
+    }
+    pairs.sort(false);
+
+    // tracks never analysed are stored as 0
+    int version{ pairs.joinIntoString(",").hashCode() & 0x7fffffff };
+    return version != 0 ? version : 1;
+}
+
+bool TrackAnalyzer::isAnalysed(const Song& song)
+{
+    return song.analysisVersion == getAnalysisVersion();
+}
+
+void TrackAnalyzer::analyze(TrackId id, const juce::File& file, bool urgent)
+{
+    bool startWorker{ false };
+    {
+        const juce::ScopedLock lock(queueLock);
+
+        if (queuedIds.count(id) > 0)
+        {
+            auto it = std::find_if(queue.begin(), queue.end(), [id](const Request& request) { return request.id == id; });
+            if (!urgent || it == queue.end())
+            {
+                return;
+            }
+            queue.erase(it);
+        }
+
+        if (urgent)
+        {
+            queue.push_front({ id, file });
+        }
+        else
+        {
+            queue.push_back({ id, file });
+        }
+        queuedIds.insert(id);
+
+        if (activeWorkers < numWorkers)
+        {
+            ++activeWorkers;
+            startWorker = true;
+        }
+    }
+
+    if (startWorker)
+    {
+        pool.addJob(new Worker(*this), true);
+    }
+    startTimer(250);
+}
+
+bool TrackAnalyzer::takeRequest(Request& request)
+{
+    const juce::ScopedLock lock(queueLock);
+
+    if (queue.empty())
+    {
+        --activeWorkers;
+        return false;
+    }
+
+    request = std::move(queue.front());
+    queue.pop_front();
+    queuedIds.erase(request.id);
+    return true;
+}
+
+AnalysisResult TrackAnalyzer::analyzeFile(const Request& request, juce::ThreadPoolJob& job)
+{
+    AnalysisResult result;
+    result.id = request.id;
+
+    juce::String hash{ AnalysisStore::hashFile(request.file) };
+    if (hash.isEmpty())
+    {
+        std::cout << "TrackAnalyzer: can't read " << request.file.getFullPathName() << std::endl;
+        return result;
+    }
+
+    // a file analysed before, under any name, is only decoded for the analyzers it lacks
+    std::vector<const Analyzer*> toRun;
+    for (const Analyzer& analyzer : analyzers)
+    {
+        juce::MemoryBlock data;
+        if (analysisStore.get(hash, analyzer.name, analyzer.version, data))
+        {
+            result.data[analyzer.name] = std::move(data);
+        }
+        else
+        {
+            toRun.push_back(&analyzer);
+        }
+    }
+
+    if (!toRun.empty())
+    {
+        std::map<juce::String, juce::MemoryBlock> data;
+        if (!decodeFile(request.file, toRun, job, data))
+        {
+            return result;
+        }
+
+        for (const Analyzer* analyzer : toRun)
+        {
+            juce::MemoryBlock& block{ data[analyzer->name] };
+            analysisStore.put(hash, analyzer->name, analyzer->version, block);
+            result.data[analyzer->name] = std::move(block);
+        }
+    }
+
+    result.analysed = readBuiltInResults(result);
+    return result;
+}
+
+bool TrackAnalyzer::decodeFile(const juce::File& file, const std::vector<const Analyzer*>& toRun, juce::ThreadPoolJob& job,
+                               std::map<juce::String, juce::MemoryBlock>& data)
+{
+    std::unique_ptr<juce::AudioFormatReader> reader{ formatManager.createReaderFor(file) };
+    if (reader == nullptr || reader->sampleRate <= 0.0 || reader->numChannels == 0)
+    {
+        std::cout << "TrackAnalyzer: can't read " << file.getFullPathName() << std::endl;
+        return false;
+    }
+
+    int numChannels{ (int) reader->numChannels };
+    std::vector<std::unique_ptr<AnalysisTask>> tasks;
+    for (const Analyzer* analyzer : toRun)
+    {
+        tasks.push_back(analyzer->createTask(reader->sampleRate, numChannels, reader->lengthInSamples));
+    }
+
+    juce::AudioBuffer<float> buffer{ numChannels, blockSize };
+    std::vector<float> mono((size_t) blockSize);
+
+    for (juce::int64 position = 0; position < reader->lengthInSamples; position += blockSize)
+    {
+        if (job.shouldExit())
+        {
+            return false;
+        }
+
+        int numSamples{ (int) juce::jmin((juce::int64) blockSize, reader->lengthInSamples - position) };
+        reader->read(&buffer, 0, numSamples, position, true, true);
+
+        juce::FloatVectorOperations::copy(mono.data(), buffer.getReadPointer(0), numSamples);
+        for (int channel = 1; channel < numChannels; ++channel)
+        {
+            juce::FloatVectorOperations::add(mono.data(), buffer.getReadPointer(channel), numSamples);
+        }
+        juce::FloatVectorOperations::multiply(mono.data(), 1.0f / (float) numChannels, numSamples);
+
+        for (auto& task : tasks)
+        {
+            task->process(buffer, mono.data(), numSamples);
+        }
+    }
+
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        data[toRun[i]->name] = tasks[i]->getResult();
+    }
+    return true;
+}
+
+bool TrackAnalyzer::readBuiltInResults(AnalysisResult& result)
+{
+    auto beats = result.data.find(beatsAnalyzer);
+    auto key = result.data.find(keyAnalyzer);
+    auto loudness = result.data.find(loudnessAnalyzer);
+    if (beats == result.data.end() || key == result.data.end() || loudness == result.data.end())
+    {
+        return false;
+    }
+
+    {
+        juce::MemoryInputStream in{ beats->second, false };
+        result.bpm = in.readDouble();
+        int numMarkers{ in.readInt() };
+        for (int i = 0; i < numMarkers && !in.isExhausted(); ++i)
+        {
+            double time{ in.readDouble() };
+            result.beatGrid.push_back({ time, in.readDouble() });
+        }
+    }
+    {
+        juce::MemoryInputStream in{ key->second, false };
+        result.key = in.readInt();
+    }
+    {
+        juce::MemoryInputStream in{ loudness->second, false };
+        result.loudness = in.readDouble();
+        result.truePeak = in.readDouble();
+    }
+    return true;
+}
+
+void TrackAnalyzer::timerCallback()
+{
+    std::vector<AnalysisResult> results;
+    {
+        const juce::ScopedLock lock(resultsLock);
+        results.swap(pendingResults);
+    }
+
+    if (!results.empty() && onResults)
+    {
+        onResults(results);
+    }
+
+    const juce::ScopedLock lock(queueLock);
+    if (activeWorkers == 0 && queue.empty())
+    {
+        const juce::ScopedLock resultLock(resultsLock);
+        if (pendingResults.empty())
+        {
+            stopTimer();
+        }
+    }
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+#include "Song.h"
+#include "ThreadConfig.h"
+#include "AnalysisStore.h"
+
+// one analysis of one track, fed with every block as the track is decoded
+class AnalysisTask
+{
+public:
+
+    virtual ~AnalysisTask() = default;
+
+    // purpose : add the next decoded block
+    // input : samples of every channel, the same mixed to mono, number of samples
+    // output : void
+    virtual void process(const juce::AudioBuffer<float>& buffer, const float* mono, int numSamples) = 0;
+
+    // purpose : get the result once the whole track was fed
+    // input : none
+    // output : result as stored in the analysis store
+    virtual juce::MemoryBlock getResult() = 0;
+};
+
+// what the analysis found out about one track
+struct AnalysisResult
+{
+    TrackId id{ 0 };
+    bool analysed{ false };
+    double bpm{ 0.0 };
+    std::vector<BeatMarker> beatGrid;
+    int key{ -1 };
+    double loudness{ 0.0 };
+    double truePeak{ 0.0 };
+
+    // result of every analyzer by its name, the ones above included
+    std::map<juce::String, juce::MemoryBlock> data;
+};
+
+// TrackAnalyzer decodes tracks on a pool of low priority threads, one less than the number
+// of cores, and feeds every block to the analyzers as it is decoded. Results are looked up
+// in the analysis store first, a track is only decoded if some analyzer has no result for its
+// content at its current version, and then once for all of them.
+// Tempo, key and loudness are built in, other analyzers are registered before the first track
+// is queued. It never touches the decks or the audio thread, every track is read through its
+// own reader. Tracks that are about to be played jump the queue.
+class TrackAnalyzer : private juce::Timer
+{
+public:
+
+    // purpose : make the analysis of one track
+    // input : sample rate, number of channels and length in samples of the track
+    // output : analysis
+    using TaskFactory = std::function<std::unique_ptr<AnalysisTask>(double sampleRate, int numChannels, juce::int64 lengthInSamples)>;
+
+    TrackAnalyzer(juce::AudioFormatManager& formatManager, ThreadConfig& threadConfig, AnalysisStore& analysisStore);
+
+    ~TrackAnalyzer() override;
+
+    // purpose : add an analyzer, its results are stored under its name and version
+    // input : name, version to raise whenever its results change, factory of its analyses
+    // output : void
+    void registerAnalyzer(const juce::String& name, int version, TaskFactory createTask);
+
+    // purpose : get the version of the whole analysis, it changes whenever an analyzer is
+    //           added, removed or changes its version
+    // input : none
+    // output : version, never 0
+    int getAnalysisVersion();
+
+    // purpose : check if a track went through the current analysis
+    // input : track
+    // output : true if analysed
+    bool isAnalysed(const Song& song);
+
+    // purpose : queue a track for analysis, a queued track is only moved up if urgent
+    // input : id and file of the track, and whether it is needed now
+    // output : void
+    void analyze(TrackId id, const juce::File& file, bool urgent);
+
+    // called on the message thread with the next finished tracks
+    std::function<void(std::vector<AnalysisResult>& results)> onResults;
+
+private:
+
+    class Worker;
+
+    struct Request
+    {
+        TrackId id{ 0 };
+        juce::File file;
+    };
+
+    struct Analyzer
+    {
+        juce::String name;
+        int version{ 0 };
+        TaskFactory createTask;
+    };
+
+    juce::AudioFormatManager& formatManager;
+    ThreadConfig& threadConfig;
+    AnalysisStore& analysisStore;
+
+    // registered analyzers, only changed before the workers start
+    std::vector<Analyzer> analyzers;
+
+    int numWorkers;
+    juce::ThreadPool pool;
+
+    // waiting tracks, taken by the workers from the front
+    juce::CriticalSection queueLock;
+    std::deque<Request> queue;
+    std::unordered_set<TrackId> queuedIds;
+    int activeWorkers{ 0 };
+
+    // filled by the workers, drained by the timer
+    juce::CriticalSection resultsLock;
+    std::vector<AnalysisResult> pendingResults;
+
+    // purpose : take the next track for a worker
+    // input : request to fill
+    // output : false if the queue is empty and the worker should finish
+    bool takeRequest(Request& request);
+
+    // purpose : get the results of a track from the store, and decode it once for the
+    //           analyzers without one
+    // input : request, job to check for cancellation
+    // output : result
+    AnalysisResult analyzeFile(const Request& request, juce::ThreadPoolJob& job);
+
+    // purpose : decode a track and run analyzers over it
+    // input : file, analyzers to run, job to check for cancellation, results to fill
+    // output : false if the track can't be read or the job was cancelled
+    bool decodeFile(const juce::File& file, const std::vector<const Analyzer*>& toRun, juce::ThreadPoolJob& job,
+                    std::map<juce::String, juce::MemoryBlock>& data);
+
+    // purpose : read the results of the built in analyzers
+    // input : result to fill from its data
+    // output : false if one is missing
+    static bool readBuiltInResults(AnalysisResult& result);
+
+    // purpose : hand the finished tracks to the message thread
+    // input : none
+    // output : void
+    void timerCallback() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TrackAnalyzer)
+};
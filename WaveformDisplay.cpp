@@ -1,12 +1,33 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "WaveformDisplay.h"
+#include "DiskThumbnailCache.h"
+#include "FrameProfiler.h"
+#include <cmath>
+
+// shortest part of a track the zoom goes down to, in seconds
+static constexpr double minVisibleSeconds = 2.0;
+
+// closest beats are drawn, in pixels
+static constexpr double minBeatSpacing = 4.0;
+
+// time a paint of a deck's waveform may take, in milliseconds, also when it draws the image
+// again: two decks then fill under half of a 60 Hz frame of 16.7 ms, the rest is for the
+// other components and the message thread's work. The frame profiler counts the paints over it
+static constexpr double paintBudgetMs = 4.0;
+
+// colors of the bands of the waveform, kicks and bass, voices and synths, hats and cymbals
+static const Colour lowBandColour{ 0xff3060ff };
+static const Colour midBandColour{ 0xffff9020 };
+static const Colour highBandColour{ 0xffffffff };
 
 //==============================================================================
 WaveformDisplay::WaveformDisplay(AudioFormatManager & 	formatManagerToUse,
-                                 AudioThumbnailCache & 	cacheToUse) :
-                                 audioThumb(1000, formatManagerToUse, cacheToUse), 
+                                 AudioThumbnailCache & 	cacheToUse,
+                                 WaveformLoader & loaderToUse) :
+                                 audioThumb(DiskThumbnailCache::samplesPerThumbnailSample, formatManagerToUse, cacheToUse), 
                                  fileLoaded(false), 
-                                 position(0)
+                                 position(0),
+                                 loader(loaderToUse)
                           
 {
     // In your constructor, you should add any child components, and
@@ -18,6 +39,7 @@ WaveformDisplay::WaveformDisplay(AudioFormatManager & 	formatManagerToUse,
 
 WaveformDisplay::~WaveformDisplay()
 {
+    loader.cancel(this);
 }
 
 void WaveformDisplay::paint (Graphics& g)
@@ -29,48 +51,162 @@ void WaveformDisplay::paint (Graphics& g)
        drawing code..
     */
 
-    g.fillAll (getLookAndFeel().findColour (ResizableWindow::backgroundColourId));   // clear the background
+    FrameProfiler::ScopedPaint profile{ "WaveformDisplay", paintBudgetMs };
+    juce::int64 paintStart{ juce::Time::getHighResolutionTicks() };
+    bool redrawn{ false };
 
-    g.setColour (Colours::grey);
-    g.drawRect (getLocalBounds(), 1);   // draw an outline around the component
-
-    g.setColour (Colours::orange);
     if(fileLoaded)
     {
-      audioThumb.drawChannel(g, 
-        getLocalBounds(), 
-        0, 
-        audioThumb.getTotalLength(), 
-        0, 
-        1.0f
-      );
+      // the waveform is drawn into the image once per size, zoom or content change, a repaint
+      // for the playhead only puts the image back and draws the playhead over it
+      float scale{ g.getInternalContext().getPhysicalPixelScaleFactor() };
+      int imageWidth{ juce::roundToInt(getWidth() * scale) };
+      int imageHeight{ juce::roundToInt(getHeight() * scale) };
+      if (!waveformImageValid || waveformImage.getWidth() != imageWidth || waveformImage.getHeight() != imageHeight)
+      {
+        renderWaveform(imageWidth, imageHeight, scale);
+        redrawn = true;
+      }
+      g.drawImage(waveformImage, getLocalBounds().toFloat());
+
       g.setColour(Colours::lightgreen);
-      g.drawRect(position * getWidth(), 0, getWidth() / 20, getHeight());
+      if (isZoomed())
+      {
+        g.fillRect(positionToX(position) - 1.0f, 0.0f, 2.0f, (float) getHeight());
+      }
+      else
+      {
+        g.drawRect(position * getWidth(), 0, getWidth() / 20, getHeight());
+      }
     }
     else 
     {
+      g.fillAll (getLookAndFeel().findColour (ResizableWindow::backgroundColourId));   // clear the background
+
+      g.setColour (Colours::grey);
+      g.drawRect (getLocalBounds(), 1);   // draw an outline around the component
+
+      g.setColour (Colours::orange);
       g.setFont (20.0f);
       g.drawText ("No Tracks on Deck", getLocalBounds(),
                   Justification::centred, true);   // draw some placeholder text
 
     }
+
+    // the time of this paint is shown by the next one
+    if (showPaintTime)
+    {
+      g.setColour(Colours::black.withAlpha(0.6f));
+      g.fillRect(getPaintTimeArea());
+      g.setFont(12.0f);
+      g.setColour(lastPaintTime > paintBudgetMs ? Colours::red : Colours::white);
+      g.drawText("paint " + String(lastPaintTime, 3) + " ms of " + String(paintBudgetMs, 1) + ", avg " + String(averagePaintTime, 3) + " ms"
+                     + (lastPaintRedrawn ? ", redrawn" : ""),
+                 getPaintTimeArea().reduced(4, 0), Justification::centredLeft, false);
+    }
+
+    lastPaintTime = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - paintStart) * 1000.0;
+    averagePaintTime += (lastPaintTime - averagePaintTime) * 0.05;
+    lastPaintRedrawn = redrawn;
 }
 
 void WaveformDisplay::resized()
 {
     // This method is where you should set the bounds of any child
     // components that your component contains..
+    invalidateWaveform();
+}
+
+void WaveformDisplay::setShowPaintTime(bool shouldShow)
+{
+    showPaintTime = shouldShow;
+    repaint();
+}
+
+void WaveformDisplay::invalidateWaveform()
+{
+    waveformImageValid = false;
+    repaint();
+}
+
+void WaveformDisplay::renderWaveform(int imageWidth, int imageHeight, float scale)
+{
+    if (waveformImage.getWidth() != imageWidth || waveformImage.getHeight() != imageHeight)
+    {
+        waveformImage = Image(Image::RGB, juce::jmax(1, imageWidth), juce::jmax(1, imageHeight), false);
+    }
+
+    Graphics g(waveformImage);
+    g.addTransform(AffineTransform::scale(scale));
+
+    g.fillAll (getLookAndFeel().findColour (ResizableWindow::backgroundColourId));   // clear the background
+
+    g.setColour (Colours::grey);
+    g.drawRect (getLocalBounds(), 1);   // draw an outline around the component
+
+    g.setColour (Colours::orange);
+
+    // a local file is drawn in the colors of the bands from its pyramid once the preview is
+    // there, a stream from its overview
+    if (pyramid != nullptr)
+    {
+      paintDetail(g);
+    }
+    else
+    {
+      audioThumb.drawChannel(g, 
+        getLocalBounds(), 
+        visibleStart * getLengthInSeconds(), 
+        (visibleStart + visibleLength) * getLengthInSeconds(), 
+        0, 
+        1.0f
+      );
+    }
+
+    // the beats move with the waveform, so they are part of the image
+    if (isZoomed())
+    {
+      paintBeats(g);
+    }
 
+    waveformImageValid = true;
+}
+
+juce::Rectangle<int> WaveformDisplay::getPaintTimeArea()
+{
+    return { 0, 0, juce::jmin(getWidth(), 240), 16 };
 }
 
 void WaveformDisplay::loadURL(URL audioURL)
 {
     audioThumb.clear();
-    fileLoaded  = audioThumb.setSource(new URLInputSource(audioURL));
+    pyramid.reset();
+    beatGrid.clear();
+    visibleStart = 0.0;
+    visibleLength = 1.0;
+
+    // a local file is only decoded for its pyramid, whose preview shows a long mix before it
+    // is read through, only a stream goes through the thumbnail
+    if (audioURL.isLocalFile())
+    {
+        fileLoaded = audioURL.getLocalFile().existsAsFile();
+        loader.load(this, audioURL.getLocalFile(), [this](std::shared_ptr<const WaveformPyramid> loaded)
+        {
+            pyramid = std::move(loaded);
+            fileLoaded = pyramid != nullptr;
+            invalidateWaveform();
+        });
+    }
+    else
+    {
+        loader.cancel(this);
+        fileLoaded = audioThumb.setSource(new URLInputSource(audioURL));
+    }
+
+    invalidateWaveform();
     if (fileLoaded)
     {
         std::cout << "wfd: loaded! " << std::endl;
-        repaint();
     }
     else {
     std::cout << "wfd: not loaded! " << std::endl;
@@ -80,15 +216,172 @@ void WaveformDisplay::loadURL(URL audioURL)
 void WaveformDisplay::changeListenerCallback (ChangeBroadcaster *source)
 {
     std::cout << "wfd: change received! " << std::endl;
-    repaint();
+    invalidateWaveform();
 }
 
 void WaveformDisplay::setPositionRelative(double pos)
 {
     if (pos != position)
     {
+    juce::Rectangle<int> oldPlayhead{ getPlayheadArea() };
     position = pos;
-    repaint();
+
+    // a zoomed view turns the page when the playhead leaves it
+    if (isZoomed() && (position < visibleStart || position >= visibleStart + visibleLength))
+    {
+        visibleStart = position - visibleLength * 0.1;
+        limitView();
+        invalidateWaveform();
+        return;
+    }
+
+    // only the strips under the old and new playhead are drawn again, and nothing while
+    // the playhead stays on the same pixel
+    juce::Rectangle<int> newPlayhead{ getPlayheadArea() };
+    if (newPlayhead != oldPlayhead)
+    {
+        repaint(oldPlayhead);
+        repaint(newPlayhead);
+        if (showPaintTime)
+        {
+            repaint(getPaintTimeArea());
+        }
+    }
+    }
+}
+
+juce::Rectangle<int> WaveformDisplay::getPlayheadArea()
+{
+    if (isZoomed())
+    {
+        int x{ (int) std::floor(positionToX(position)) };
+        return { x - 2, 0, 4, getHeight() };
+    }
+    return { (int) (position * getWidth()) - 1, 0, getWidth() / 20 + 2, getHeight() };
+}
+
+void WaveformDisplay::setBeatGrid(std::vector<BeatMarker> grid)
+{
+    beatGrid = std::move(grid);
+    invalidateWaveform();
+}
+
+bool WaveformDisplay::isZoomed()
+{
+    return visibleLength < 1.0;
+}
+
+double WaveformDisplay::xToPosition(float x)
+{
+    return visibleStart + x / juce::jmax(1, getWidth()) * visibleLength;
+}
+
+float WaveformDisplay::positionToX(double pos)
+{
+    return (float) ((pos - visibleStart) / visibleLength * getWidth());
+}
+
+double WaveformDisplay::getLengthInSeconds()
+{
+    if (pyramid != nullptr && pyramid->getSampleRate() > 0.0)
+    {
+        return pyramid->getLengthInSamples() / pyramid->getSampleRate();
+    }
+    return audioThumb.getTotalLength();
+}
+
+void WaveformDisplay::limitView()
+{
+    double lengthInSeconds{ getLengthInSeconds() };
+    double minLength{ lengthInSeconds > minVisibleSeconds ? minVisibleSeconds / lengthInSeconds : 1.0 };
+    visibleLength = juce::jlimit(minLength, 1.0, visibleLength);
+    visibleStart = juce::jlimit(0.0, 1.0 - visibleLength, visibleStart);
+}
+
+void WaveformDisplay::paintDetail(Graphics& g)
+{
+    double totalSamples{ (double) pyramid->getLengthInSamples() };
+    double startSample{ visibleStart * totalSamples };
+    double samplesPerPixel{ visibleLength * totalSamples / juce::jmax(1, getWidth()) };
+    int level{ pyramid->getLevelFor(samplesPerPixel) };
+
+    // one column per pixel, from no more than two bins of the level each, across the whole
+    // image: this only runs when the image is drawn again, a repaint for the playhead doesn't
+    // come here
+    // the bands are layered lows first, each one as high as its peak level (RMS times the
+    // square root of two), so the colors cost a rectangle list each instead of a colour per
+    // column
+    float centre{ getHeight() * 0.5f };
+    RectangleList<float> peaks;
+    RectangleList<float> lows;
+    RectangleList<float> mids;
+    RectangleList<float> highs;
+    auto addBand = [centre](RectangleList<float>& band, int x, float rms)
+    {
+        float height{ juce::jmin(1.0f, rms * juce::MathConstants<float>::sqrt2) * centre };
+        if (height >= 0.5f)
+        {
+            band.addWithoutMerging({ (float) x, centre - height, 1.0f, 2.0f * height });
+        }
+    };
+    juce::Rectangle<int> clip{ g.getClipBounds() };
+    for (int x = juce::jmax(0, clip.getX()); x < juce::jmin(getWidth(), clip.getRight()); ++x)
+    {
+        double from{ startSample + x * samplesPerPixel };
+        WaveformPyramid::Bin bin{ pyramid->getRange(level, from, from + samplesPerPixel) };
+        peaks.addWithoutMerging({ (float) x, centre - bin.max * centre, 1.0f, juce::jmax(1.0f, (bin.max - bin.min) * centre) });
+        addBand(lows, x, bin.low);
+        addBand(mids, x, bin.mid);
+        addBand(highs, x, bin.high);
+    }
+
+    g.setColour(Colours::grey.withAlpha(0.5f));
+    g.fillRectList(peaks);
+    g.setColour(lowBandColour);
+    g.fillRectList(lows);
+    g.setColour(midBandColour);
+    g.fillRectList(mids);
+    g.setColour(highBandColour);
+    g.fillRectList(highs);
+}
+
+void WaveformDisplay::paintBeats(Graphics& g)
+{
+    double lengthInSeconds{ getLengthInSeconds() };
+    if (beatGrid.empty() || lengthInSeconds <= 0.0)
+    {
+        return;
+    }
+
+    double from{ visibleStart * lengthInSeconds };
+    double to{ (visibleStart + visibleLength) * lengthInSeconds };
+    double pixelsPerSecond{ getWidth() / (visibleLength * lengthInSeconds) };
+
+    // beats are counted on over the markers, every fourth from the first marker is a downbeat
+    int beatNumber{ 0 };
+    for (size_t i = 0; i < beatGrid.size(); ++i)
+    {
+        const BeatMarker& marker{ beatGrid[i] };
+        double end{ i + 1 < beatGrid.size() ? beatGrid[i + 1].time : lengthInSeconds };
+        if (marker.bpm <= 0.0 || end <= marker.time)
+        {
+            continue;
+        }
+
+        double interval{ 60.0 / marker.bpm };
+        int numBeats{ (int) std::ceil((end - marker.time) / interval - 1.0e-6) };
+        if (interval * pixelsPerSecond >= minBeatSpacing)
+        {
+            int first{ juce::jmax(0, (int) std::ceil((from - marker.time) / interval)) };
+            int last{ juce::jmin(numBeats, (int) std::floor((to - marker.time) / interval) + 1) };
+            for (int beat = first; beat < last; ++beat)
+            {
+                bool downbeat{ (beatNumber + beat) % 4 == 0 };
+                g.setColour(downbeat ? Colours::white.withAlpha(0.8f) : Colours::white.withAlpha(0.3f));
+                g.fillRect(positionToX((marker.time + beat * interval) / lengthInSeconds), 0.0f, 1.0f, (float) getHeight());
+            }
+        }
+        beatNumber += numBeats;
     }
 }
 
@@ -97,7 +390,7 @@ void WaveformDisplay::mouseDown(const juce::MouseEvent& event)
 {
     if (fileLoaded)
     {
-        position = static_cast<double>(event.x) / getWidth();
+        position = juce::jlimit(0.0, 1.0, xToPosition((float) event.x));
         if (onPositionChanged)
         {
             onPositionChanged(position);
@@ -112,7 +405,7 @@ void WaveformDisplay::mouseDrag(const juce::MouseEvent& event)
 {
     if (fileLoaded)
     {
-        position = static_cast<double>(event.x) / getWidth();
+        position = juce::jlimit(0.0, 1.0, xToPosition((float) event.x));
         if (onPositionChanged)
         {
             onPositionChanged(position);
@@ -121,6 +414,28 @@ void WaveformDisplay::mouseDrag(const juce::MouseEvent& event)
     }
 }
 
+// Mouse wheel event handler for zooming and scrolling the waveform
+void WaveformDisplay::mouseWheelMove(const juce::MouseEvent& event, const juce::MouseWheelDetails& wheel)
+{
+    if (!fileLoaded)
+    {
+        return;
+    }
 
+    if (event.mods.isShiftDown() || std::abs(wheel.deltaX) > std::abs(wheel.deltaY))
+    {
+        float delta{ event.mods.isShiftDown() ? wheel.deltaY : wheel.deltaX };
+        visibleStart -= delta * visibleLength;
+    }
+    else
+    {
+        // the point under the mouse stays where it is
+        double anchor{ xToPosition((float) event.x) };
+        visibleLength *= std::pow(2.0, -wheel.deltaY * 4.0);
+        limitView();
+        visibleStart = anchor - (double) event.x / juce::jmax(1, getWidth()) * visibleLength;
+    }
 
-
+    limitView();
+    invalidateWaveform();
+}
@@ -1,6 +1,11 @@
 #pragma once
 
 #include "../JuceLibraryCode/JuceHeader.h"
+#include <memory>
+#include <vector>
+#include "Song.h"
+#include "WaveformLoader.h"
+#include "WaveformPyramid.h"
 
 //==============================================================================
 /*
@@ -10,7 +15,8 @@ class WaveformDisplay    : public Component,
 {
 public:
     WaveformDisplay( AudioFormatManager & 	formatManagerToUse,
-                    AudioThumbnailCache & 	cacheToUse );
+                    AudioThumbnailCache & 	cacheToUse,
+                    WaveformLoader & loaderToUse );
     ~WaveformDisplay();
 
     void paint (Graphics&) override;
@@ -23,9 +29,22 @@ public:
     /** set the relative position of the playhead*/
     void setPositionRelative(double pos);
 
+    // purpose : set the beatgrid drawn over the zoomed waveform
+    // input : grid markers of the loaded track, empty for none
+    // output : void
+    void setBeatGrid(std::vector<BeatMarker> grid);
+
+    // purpose : show how long the last paint took, in the top left corner
+    // input : true to show
+    // output : void
+    void setShowPaintTime(bool shouldShow);
+
     // Adding new members to handle mouse interaction and setting playback position
     void mouseDown(const juce::MouseEvent& event) override;
     void mouseDrag(const juce::MouseEvent& event) override;
+
+    // the wheel zooms around the mouse, with shift or sideways it scrolls
+    void mouseWheelMove(const juce::MouseEvent& event, const juce::MouseWheelDetails& wheel) override;
     std::function<void(double)> onPositionChanged;
 
 private:
@@ -33,5 +52,77 @@ private:
     bool fileLoaded; 
     double position;
 
+    // waveform colored by band, read or built in the background, the only one of a local file
+    WaveformLoader& loader;
+    std::shared_ptr<const WaveformPyramid> pyramid;
+    std::vector<BeatMarker> beatGrid;
+
+    // part of the track shown, relative to its length
+    double visibleStart{ 0.0 };
+    double visibleLength{ 1.0 };
+
+    // waveform and beats of the view, drawn again only when they change
+    Image waveformImage;
+    bool waveformImageValid{ false };
+
+    // paint time overlay, in milliseconds
+    bool showPaintTime{ false };
+    double lastPaintTime{ 0.0 };
+    double averagePaintTime{ 0.0 };
+    bool lastPaintRedrawn{ false };
+
+    // purpose : draw the waveform image again on the next paint
+    // input : none
+    // output : void
+    void invalidateWaveform();
+
+    // purpose : draw the waveform and beats of the view into the image
+    // input : size of the image in physical pixels, and the pixels per point
+    // output : void
+    void renderWaveform(int imageWidth, int imageHeight, float scale);
+
+    // purpose : get the area of the paint time overlay
+    // input : none
+    // output : area
+    juce::Rectangle<int> getPaintTimeArea();
+
+    // purpose : get the length of the loaded track, from the pyramid of a file or the overview
+    //           of a stream
+    // input : none
+    // output : length in seconds, 0 until known
+    double getLengthInSeconds();
+
+    // purpose : check if only a part of the track is shown
+    // input : none
+    // output : true if zoomed
+    bool isZoomed();
+
+    // purpose : convert between x and the relative position in the track
+    // input : x, or position
+    // output : position, or x
+    double xToPosition(float x);
+    float positionToX(double pos);
+
+    // purpose : get the area the playhead is drawn in
+    // input : none
+    // output : area, with a pixel to spare on each side
+    juce::Rectangle<int> getPlayheadArea();
+
+    // purpose : keep the view inside the track
+    // input : none
+    // output : void
+    void limitView();
+
+    // purpose : draw the visible part of the track from the pyramid level nearest to the zoom,
+    //           colored by band
+    // input : graphics
+    // output : void
+    void paintDetail(Graphics& g);
+
+    // purpose : draw the beats of the visible part, downbeats brighter
+    // input : graphics
+    // output : void
+    void paintBeats(Graphics& g);
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WaveformDisplay)
 };
@@ -0,0 +1,378 @@
+#include "WaveformLoader.h"
+#include "BandSplitter.h"
+
+// samples decoded at a time
+static constexpr int blockSize = 65536;
+
+// formats read from anywhere in the file without decoding everything before it
+static const juce::StringArray randomAccessExtensions{ ".wav", ".aif", ".aiff", ".flac" };
+
+// shortest part of a file decoded by one core, in seconds
+static constexpr double minChunkSeconds = 30.0;
+
+// audio before a part the band filters settle on, in seconds
+static constexpr double preRollSeconds = 0.5;
+
+// bins of a preview at most, and the samples read for each
+static constexpr int maxPreviewBins = 4096;
+static constexpr int previewWindow = 2048;
+
+// purpose : mix the channels of a block down to mono
+// input : block, buffer for the mono mix, samples in the block
+// output : void
+static void mixToMono(const juce::AudioBuffer<float>& buffer, float* mono, int numSamples)
+{
+    int numChannels{ buffer.getNumChannels() };
+    juce::FloatVectorOperations::copy(mono, buffer.getReadPointer(0), numSamples);
+    for (int channel = 1; channel < numChannels; ++channel)
+    {
+        juce::FloatVectorOperations::add(mono, buffer.getReadPointer(channel), numSamples);
+    }
+    juce::FloatVectorOperations::multiply(mono, 1.0f / (float) numChannels, numSamples);
+}
+
+// purpose : decode a part of a file into a pyramid
+// input : reader, first and one past the last sample, pyramid, job to check for cancellation
+// output : false if cancelled
+static bool reduceRange(juce::AudioFormatReader& reader, juce::int64 start, juce::int64 end,
+                        WaveformPyramid& pyramid, juce::ThreadPoolJob& job)
+{
+    juce::AudioBuffer<float> buffer{ (int) reader.numChannels, blockSize };
+    std::vector<float> mono((size_t) blockSize);
+    std::vector<float> low((size_t) blockSize);
+    std::vector<float> mid((size_t) blockSize);
+    std::vector<float> high((size_t) blockSize);
+    BandSplitter bandSplitter;
+    bandSplitter.prepare(reader.sampleRate, blockSize);
+
+    // the filters settle on the audio before the part, which isn't added
+    juce::int64 position{ juce::jmax((juce::int64) 0, start - (juce::int64) (reader.sampleRate * preRollSeconds)) };
+    while (position < end)
+    {
+        if (job.shouldExit())
+        {
+            return false;
+        }
+
+        int numSamples{ (int) juce::jmin((juce::int64) blockSize, end - position) };
+        reader.read(&buffer, 0, numSamples, position, true, true);
+        mixToMono(buffer, mono.data(), numSamples);
+        bandSplitter.process(mono.data(), low.data(), mid.data(), high.data(), numSamples);
+
+        int skip{ (int) juce::jlimit((juce::int64) 0, (juce::int64) numSamples, start - position) };
+        if (skip < numSamples)
+        {
+            pyramid.addSamples(mono.data() + skip, low.data() + skip, mid.data() + skip, high.data() + skip, numSamples - skip);
+        }
+        position += numSamples;
+    }
+    return true;
+}
+
+// purpose : make a preview of a file from a short window in every bin, fast enough to show
+//           while the full pyramid is built
+// input : reader, job to check for cancellation
+// output : preview, nullptr if cancelled
+static std::shared_ptr<const WaveformPyramid> buildPreview(juce::AudioFormatReader& reader, juce::ThreadPoolJob& job)
+{
+    juce::int64 length{ reader.lengthInSamples };
+    int level{ 0 };
+    while (length / ((juce::int64) WaveformPyramid::baseSamplesPerBin << level) > maxPreviewBins)
+    {
+        ++level;
+    }
+
+    auto preview = std::make_shared<WaveformPyramid>();
+    preview->reset(reader.sampleRate, length, level);
+    juce::int64 samplesPerBin{ preview->getSamplesPerBin(0) };
+
+    juce::AudioBuffer<float> buffer{ (int) reader.numChannels, previewWindow };
+    std::vector<float> mono((size_t) previewWindow);
+    std::vector<float> low((size_t) previewWindow);
+    std::vector<float> mid((size_t) previewWindow);
+    std::vector<float> high((size_t) previewWindow);
+    BandSplitter bandSplitter;
+
+    std::vector<WaveformPyramid::Bin> bins;
+    for (juce::int64 start = 0; start < length; start += samplesPerBin)
+    {
+        if (job.shouldExit())
+        {
+            return nullptr;
+        }
+
+        // the window is taken from the middle of the bin, the band filters start over on every
+        // window, which is close enough for a preview
+        juce::int64 binLength{ juce::jmin(samplesPerBin, length - start) };
+        int numSamples{ (int) juce::jmin((juce::int64) previewWindow, binLength) };
+        reader.read(&buffer, 0, numSamples, start + (binLength - numSamples) / 2, true, true);
+        mixToMono(buffer, mono.data(), numSamples);
+        bandSplitter.prepare(reader.sampleRate, previewWindow);
+        bandSplitter.process(mono.data(), low.data(), mid.data(), high.data(), numSamples);
+        bins.push_back(WaveformPyramid::makeBin(mono.data(), low.data(), mid.data(), high.data(), numSamples));
+    }
+
+    preview->addBins(bins);
+    preview->finish();
+    return preview;
+}
+
+class WaveformLoader::Job : public juce::ThreadPoolJob
+{
+public:
+    Job(WaveformLoader& _owner, const void* _client, int _generation, const juce::File& _file)
+        : juce::ThreadPoolJob("Waveform"),
+        owner(_owner),
+        client(_client),
+        generation(_generation),
+        file(_file)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        owner.threadConfig.applyToCurrentThread(ThreadConfig::Role::loader);
+
+        publish(owner.buildPyramid(file, *this), true);
+        return jobHasFinished;
+    }
+
+    // purpose : hand a pyramid to the client, on the next timer callback
+    // input : pyramid, false for a preview with the full pyramid still to come
+    // output : void
+    void publish(std::shared_ptr<const WaveformPyramid> pyramid, bool complete)
+    {
+        if (!shouldExit())
+        {
+            const juce::ScopedLock lock(owner.finishedLock);
+            owner.finished.push_back({ client, generation, std::move(pyramid), complete });
+        }
+    }
+
+    const void* getClient() const
+    {
+        return client;
+    }
+
+private:
+    WaveformLoader& owner;
+    const void* client;
+    int generation;
+    juce::File file;
+};
+
+class WaveformLoader::ChunkJob : public juce::ThreadPoolJob
+{
+public:
+    ChunkJob(WaveformLoader& _owner, juce::ThreadPoolJob& _parent, const juce::File& _file, juce::int64 _start, juce::int64 _end)
+        : juce::ThreadPoolJob("Waveform chunk"),
+        owner(_owner),
+        parent(_parent),
+        file(_file),
+        start(_start),
+        end(_end)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        owner.threadConfig.applyToCurrentThread(ThreadConfig::Role::loader);
+
+        // every part has a reader of its own
+        std::unique_ptr<juce::AudioFormatReader> reader{ owner.formatManager.createReaderFor(file) };
+        if (reader != nullptr)
+        {
+            WaveformPyramid part;
+            part.reset(reader->sampleRate, end - start);
+            done = reduceRange(*reader, start, end, part, parent);
+            bins = part.takeBins();
+        }
+        return jobHasFinished;
+    }
+
+    // purpose : get the finest bins of the part
+    // input : none
+    // output : bins, empty if unreadable
+    const std::vector<WaveformPyramid::Bin>& getBins() const
+    {
+        return bins;
+    }
+
+    // purpose : check if the whole part was decoded
+    // input : none
+    // output : false if unreadable or cancelled
+    bool isDone() const
+    {
+        return done;
+    }
+
+private:
+    WaveformLoader& owner;
+
+    // the part stops when the pyramid it belongs to is cancelled
+    juce::ThreadPoolJob& parent;
+
+    juce::File file;
+    juce::int64 start;
+    juce::int64 end;
+
+    std::vector<WaveformPyramid::Bin> bins;
+    bool done{ false };
+};
+
+WaveformLoader::WaveformLoader(juce::AudioFormatManager& _formatManager, ThreadConfig& _threadConfig, AnalysisStore& _analysisStore)
+    : formatManager(_formatManager),
+    threadConfig(_threadConfig),
+    analysisStore(_analysisStore),
+    chunkPool(juce::jmax(1, juce::SystemStats::getNumCpus() - 1), 0, juce::Thread::Priority::low),
+    pool(1, 0, juce::Thread::Priority::low)
+{
+}
+
+WaveformLoader::~WaveformLoader()
+{
+    stopTimer();
+    pool.removeAllJobs(true, 5000);
+    chunkPool.removeAllJobs(true, 5000);
+}
+
+void WaveformLoader::load(const void* client, const juce::File& file, Callback callback)
+{
+    cancel(client);
+
+    int generation{ nextGeneration++ };
+    requests[client] = { generation, std::move(callback) };
+    pool.addJob(new Job(*this, client, generation, file), true);
+    startTimer(50);
+}
+
+void WaveformLoader::cancel(const void* client)
+{
+    requests.erase(client);
+
+    // a job of the client that hasn't started yet is dropped, a running one is told to stop
+    struct ClientJobs : public juce::ThreadPool::JobSelector
+    {
+        const void* client;
+
+        bool isJobSuitable(juce::ThreadPoolJob* job) override
+        {
+            auto* waveformJob = dynamic_cast<Job*>(job);
+            return waveformJob != nullptr && waveformJob->getClient() == client;
+        }
+    };
+    ClientJobs selector;
+    selector.client = client;
+    pool.removeAllJobs(true, 0, &selector);
+}
+
+std::shared_ptr<const WaveformPyramid> WaveformLoader::buildPyramid(const juce::File& file, Job& job)
+{
+    auto pyramid = std::make_shared<WaveformPyramid>();
+
+    juce::String hash{ AnalysisStore::hashFile(file) };
+    juce::MemoryBlock data;
+    if (analysisStore.get(hash, analyzerName, analyzerVersion, data) && pyramid->load(data))
+    {
+        return pyramid;
+    }
+
+    std::unique_ptr<juce::AudioFormatReader> reader{ formatManager.createReaderFor(file) };
+    if (reader == nullptr || reader->sampleRate <= 0.0 || reader->numChannels == 0)
+    {
+        std::cout << "WaveformLoader: can't read " << file.getFullPathName() << std::endl;
+        return nullptr;
+    }
+
+    juce::int64 length{ reader->lengthInSamples };
+    pyramid->reset(reader->sampleRate, length);
+
+    // a file read from anywhere is split into parts decoded on every core, other files are
+    // decoded from start to end
+    int numChunks{ 1 };
+    if (randomAccessExtensions.contains(file.getFileExtension(), true))
+    {
+        juce::int64 minChunkLength{ (juce::int64) (reader->sampleRate * minChunkSeconds) };
+        numChunks = (int) juce::jlimit((juce::int64) 1, (juce::int64) chunkPool.getNumThreads() * 2, length / minChunkLength);
+    }
+
+    if (numChunks == 1)
+    {
+        if (!reduceRange(*reader, 0, length, *pyramid, job))
+        {
+            return nullptr;
+        }
+    }
+    else
+    {
+        // the preview shows the whole track, coarse, while the parts are decoded
+        std::shared_ptr<const WaveformPyramid> preview{ buildPreview(*reader, job) };
+        if (preview == nullptr)
+        {
+            return nullptr;
+        }
+        job.publish(std::move(preview), false);
+
+        // the parts start on a bin, so their bins follow each other
+        juce::int64 numBins{ (length + WaveformPyramid::baseSamplesPerBin - 1) / WaveformPyramid::baseSamplesPerBin };
+        juce::int64 chunkLength{ (numBins + numChunks - 1) / numChunks * WaveformPyramid::baseSamplesPerBin };
+        std::vector<std::unique_ptr<ChunkJob>> chunks;
+        for (juce::int64 start = 0; start < length; start += chunkLength)
+        {
+            chunks.push_back(std::make_unique<ChunkJob>(*this, job, file, start, juce::jmin(length, start + chunkLength)));
+            chunkPool.addJob(chunks.back().get(), false);
+        }
+
+        for (auto& chunk : chunks)
+        {
+            chunkPool.waitForJobToFinish(chunk.get(), -1);
+        }
+        for (auto& chunk : chunks)
+        {
+            if (!chunk->isDone())
+            {
+                return nullptr;
+            }
+            pyramid->addBins(chunk->getBins());
+        }
+    }
+    pyramid->finish();
+
+    analysisStore.put(hash, analyzerName, analyzerVersion, pyramid->save());
+    return pyramid;
+}
+
+void WaveformLoader::timerCallback()
+{
+    std::vector<Finished> results;
+    {
+        const juce::ScopedLock lock(finishedLock);
+        results.swap(finished);
+    }
+
+    for (Finished& result : results)
+    {
+        auto request = requests.find(result.client);
+        if (request == requests.end() || request->second.generation != result.generation)
+        {
+            continue;
+        }
+
+        // a preview leaves the request waiting for the full pyramid
+        if (!result.complete)
+        {
+            Callback callback{ request->second.callback };
+            callback(std::move(result.pyramid));
+            continue;
+        }
+
+        Callback callback{ std::move(request->second.callback) };
+        requests.erase(request);
+        callback(std::move(result.pyramid));
+    }
+
+    if (requests.empty())
+    {
+        stopTimer();
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+#include "AnalysisStore.h"
+#include "ThreadConfig.h"
+#include "WaveformPyramid.h"
+
+// WaveformLoader builds the waveform pyramids of the tracks loaded on the decks on a low
+// priority loader thread, and keeps them in the analysis store so a track is only decoded for
+// its pyramid once. Pyramids are too large to make for the whole library, so only the decks
+// ask for them.
+// Formats read from anywhere (WAV, AIFF, FLAC) are split into parts decoded on every core and
+// merged, with a coarse preview handed out first so a long mix shows before it is decoded.
+// Every client has one request at a time, a new load replaces the one still running.
+class WaveformLoader : private juce::Timer
+{
+public:
+
+    // called on the message thread with the pyramid, nullptr if the file can't be read, a
+    // preview can come before it
+    using Callback = std::function<void(std::shared_ptr<const WaveformPyramid> pyramid)>;
+
+    // name and version of the pyramid in the analysis store
+    static constexpr const char* analyzerName = "pyramid";
+    static constexpr int analyzerVersion = 2;
+
+    WaveformLoader(juce::AudioFormatManager& formatManager, ThreadConfig& threadConfig, AnalysisStore& analysisStore);
+
+    ~WaveformLoader() override;
+
+    // purpose : read or build the pyramid of a file
+    // input : client asking, file, callback
+    // output : void
+    void load(const void* client, const juce::File& file, Callback callback);
+
+    // purpose : drop the request of a client
+    // input : client
+    // output : void
+    void cancel(const void* client);
+
+private:
+
+    class Job;
+    class ChunkJob;
+
+    struct Finished
+    {
+        const void* client{ nullptr };
+        int generation{ 0 };
+        std::shared_ptr<const WaveformPyramid> pyramid;
+        bool complete{ true };
+    };
+
+    juce::AudioFormatManager& formatManager;
+    ThreadConfig& threadConfig;
+    AnalysisStore& analysisStore;
+
+    // decodes the parts of a file, destroyed after the pool of the jobs waiting for them
+    juce::ThreadPool chunkPool;
+    juce::ThreadPool pool;
+
+    // latest request of every client, older results are dropped
+    struct Request
+    {
+        int generation{ 0 };
+        Callback callback;
+    };
+    std::map<const void*, Request> requests;
+    int nextGeneration{ 1 };
+
+    // filled by the jobs, drained by the timer
+    juce::CriticalSection finishedLock;
+    std::vector<Finished> finished;
+
+    // purpose : read or build a pyramid, on the loader thread
+    // input : file, job to check for cancellation and hand out the preview
+    // output : pyramid, nullptr if unreadable or cancelled
+    std::shared_ptr<const WaveformPyramid> buildPyramid(const juce::File& file, Job& job);
+
+    // purpose : hand the finished pyramids to their clients
+    // input : none
+    // output : void
+    void timerCallback() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveformLoader)
+};
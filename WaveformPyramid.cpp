@@ -0,0 +1,273 @@
+#include "WaveformPyramid.h"
+#include <cmath>
+
+// purpose : merge bins into one, the RMSs are weighted by the samples they cover
+// input : bins and their weights
+// output : merged bin
+static WaveformPyramid::Bin mergeBins(const WaveformPyramid::Bin& a, float weightA, const WaveformPyramid::Bin& b, float weightB)
+{
+    auto rms = [weightA, weightB](float x, float y)
+    {
+        return std::sqrt((x * x * weightA + y * y * weightB) / (weightA + weightB));
+    };
+    return { juce::jmin(a.min, b.min), juce::jmax(a.max, b.max), rms(a.rms, b.rms),
+             rms(a.low, b.low), rms(a.mid, b.mid), rms(a.high, b.high) };
+}
+
+WaveformPyramid::WaveformPyramid()
+{
+}
+
+WaveformPyramid::~WaveformPyramid()
+{
+}
+
+void WaveformPyramid::reset(double _sampleRate, juce::int64 _lengthInSamples, int _baseLevel)
+{
+    sampleRate = _sampleRate;
+    lengthInSamples = _lengthInSamples;
+    baseLevel = _baseLevel;
+    levels.clear();
+    base.clear();
+    base.reserve((size_t) (lengthInSamples / getSamplesPerBin(0) + 1));
+    pending = {};
+    pendingSquares = 0.0;
+    pendingLowSquares = 0.0;
+    pendingMidSquares = 0.0;
+    pendingHighSquares = 0.0;
+    pendingCount = 0;
+}
+
+void WaveformPyramid::addSamples(const float* samples, const float* low, const float* mid, const float* high, int numSamples)
+{
+    for (int i = 0; i < numSamples; ++i)
+    {
+        float sample{ samples[i] };
+        if (pendingCount == 0)
+        {
+            pending.min = sample;
+            pending.max = sample;
+        }
+        else
+        {
+            pending.min = juce::jmin(pending.min, sample);
+            pending.max = juce::jmax(pending.max, sample);
+        }
+        pendingSquares += sample * sample;
+        pendingLowSquares += low[i] * low[i];
+        pendingMidSquares += mid[i] * mid[i];
+        pendingHighSquares += high[i] * high[i];
+
+        if (++pendingCount == baseSamplesPerBin)
+        {
+            closeBin();
+        }
+    }
+}
+
+void WaveformPyramid::addBins(const std::vector<Bin>& bins)
+{
+    jassert(pendingCount == 0);
+    base.insert(base.end(), bins.begin(), bins.end());
+}
+
+std::vector<WaveformPyramid::Bin> WaveformPyramid::takeBins()
+{
+    if (pendingCount > 0)
+    {
+        closeBin();
+    }
+    std::vector<Bin> bins;
+    bins.swap(base);
+    return bins;
+}
+
+WaveformPyramid::Bin WaveformPyramid::makeBin(const float* samples, const float* low, const float* mid, const float* high, int numSamples)
+{
+    if (numSamples <= 0)
+    {
+        return {};
+    }
+
+    Bin bin;
+    juce::Range<float> range{ juce::FloatVectorOperations::findMinAndMax(samples, numSamples) };
+    bin.min = range.getStart();
+    bin.max = range.getEnd();
+
+    auto rms = [numSamples](const float* values)
+    {
+        double squares{ 0.0 };
+        for (int i = 0; i < numSamples; ++i)
+        {
+            squares += values[i] * values[i];
+        }
+        return (float) std::sqrt(squares / numSamples);
+    };
+    bin.rms = rms(samples);
+    bin.low = rms(low);
+    bin.mid = rms(mid);
+    bin.high = rms(high);
+    return bin;
+}
+
+void WaveformPyramid::closeBin()
+{
+    pending.rms = (float) std::sqrt(pendingSquares / pendingCount);
+    pending.low = (float) std::sqrt(pendingLowSquares / pendingCount);
+    pending.mid = (float) std::sqrt(pendingMidSquares / pendingCount);
+    pending.high = (float) std::sqrt(pendingHighSquares / pendingCount);
+    base.push_back(pending);
+    pending = {};
+    pendingSquares = 0.0;
+    pendingLowSquares = 0.0;
+    pendingMidSquares = 0.0;
+    pendingHighSquares = 0.0;
+    pendingCount = 0;
+}
+
+void WaveformPyramid::finish()
+{
+    if (pendingCount > 0)
+    {
+        closeBin();
+    }
+
+    levels.clear();
+    levels.push_back(std::move(base));
+    base = {};
+
+    while (levels.back().size() > 1)
+    {
+        const std::vector<Bin>& finer{ levels.back() };
+        std::vector<Bin> coarser((finer.size() + 1) / 2);
+        for (size_t i = 0; i < coarser.size(); ++i)
+        {
+            const Bin& a{ finer[i * 2] };
+            if (i * 2 + 1 < finer.size())
+            {
+                coarser[i] = mergeBins(a, 1.0f, finer[i * 2 + 1], 1.0f);
+            }
+            else
+            {
+                coarser[i] = a;
+            }
+        }
+        levels.push_back(std::move(coarser));
+    }
+}
+
+double WaveformPyramid::getSampleRate() const
+{
+    return sampleRate;
+}
+
+juce::int64 WaveformPyramid::getLengthInSamples() const
+{
+    return lengthInSamples;
+}
+
+int WaveformPyramid::getNumLevels() const
+{
+    return (int) levels.size();
+}
+
+bool WaveformPyramid::isPreview() const
+{
+    return baseLevel > 0;
+}
+
+int WaveformPyramid::getLevelFor(double samplesPerPixel) const
+{
+    int level{ 0 };
+    while (level + 1 < getNumLevels() && getSamplesPerBin(level + 1) <= samplesPerPixel)
+    {
+        ++level;
+    }
+    return level;
+}
+
+const std::vector<WaveformPyramid::Bin>& WaveformPyramid::getLevel(int level) const
+{
+    return levels[(size_t) level];
+}
+
+juce::int64 WaveformPyramid::getSamplesPerBin(int level) const
+{
+    return (juce::int64) baseSamplesPerBin << (baseLevel + level);
+}
+
+WaveformPyramid::Bin WaveformPyramid::getRange(int level, double startSample, double endSample) const
+{
+    const std::vector<Bin>& bins{ levels[(size_t) level] };
+    double samplesPerBin{ (double) getSamplesPerBin(level) };
+
+    juce::int64 first{ juce::jlimit((juce::int64) 0, (juce::int64) bins.size(), (juce::int64) std::floor(startSample / samplesPerBin)) };
+    juce::int64 last{ juce::jlimit(first, (juce::int64) bins.size(), (juce::int64) std::ceil(endSample / samplesPerBin)) };
+    if (last == first)
+    {
+        // zoomed in past the finest bins, a pixel shows the bin it falls in
+        if (first >= (juce::int64) bins.size())
+        {
+            return {};
+        }
+        last = first + 1;
+    }
+
+    Bin range{ bins[(size_t) first] };
+    for (juce::int64 i = first + 1; i < last; ++i)
+    {
+        range = mergeBins(range, (float) (i - first), bins[(size_t) i], 1.0f);
+    }
+    return range;
+}
+
+juce::MemoryBlock WaveformPyramid::save() const
+{
+    // a preview is never kept
+    jassert(!isPreview());
+
+    juce::MemoryOutputStream out;
+    out.writeDouble(sampleRate);
+    out.writeInt64(lengthInSamples);
+
+    const std::vector<Bin>& finest{ levels.empty() ? base : levels.front() };
+    out.writeInt((int) finest.size());
+    for (const Bin& bin : finest)
+    {
+        out.writeByte((char) juce::jlimit(-127, 127, juce::roundToInt(bin.min * 127.0f)));
+        out.writeByte((char) juce::jlimit(-127, 127, juce::roundToInt(bin.max * 127.0f)));
+        out.writeByte((char) juce::jlimit(0, 255, juce::roundToInt(bin.rms * 255.0f)));
+        out.writeByte((char) juce::jlimit(0, 255, juce::roundToInt(bin.low * 255.0f)));
+        out.writeByte((char) juce::jlimit(0, 255, juce::roundToInt(bin.mid * 255.0f)));
+        out.writeByte((char) juce::jlimit(0, 255, juce::roundToInt(bin.high * 255.0f)));
+    }
+    return out.getMemoryBlock();
+}
+
+bool WaveformPyramid::load(const juce::MemoryBlock& data)
+{
+    juce::MemoryInputStream in{ data, false };
+    double rate{ in.readDouble() };
+    juce::int64 length{ in.readInt64() };
+    int numBins{ in.readInt() };
+    if (rate <= 0.0 || length < 0 || numBins < 0 || in.getNumBytesRemaining() < (juce::int64) numBins * 6)
+    {
+        return false;
+    }
+
+    reset(rate, length);
+    base.resize((size_t) numBins);
+    const juce::uint8* bytes{ static_cast<const juce::uint8*>(data.getData()) + in.getPosition() };
+    for (Bin& bin : base)
+    {
+        bin.min = (juce::int8) bytes[0] / 127.0f;
+        bin.max = (juce::int8) bytes[1] / 127.0f;
+        bin.rms = bytes[2] / 255.0f;
+        bin.low = bytes[3] / 255.0f;
+        bin.mid = bytes[4] / 255.0f;
+        bin.high = bytes[5] / 255.0f;
+        bytes += 6;
+    }
+    finish();
+    return true;
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+// WaveformPyramid holds the waveform of a track at several resolutions, so any zoom is drawn
+// from the level nearest to it without reading the audio again.
+// The finest level has one bin for every 64 samples with the minimum, maximum and RMS of the
+// mono mix and the RMS of its low, mid and high bands, every level above merges two bins of
+// the one below, up to a single bin.
+// A preview of a track starts from a coarser level, its finest bins cover more samples.
+class WaveformPyramid
+{
+public:
+
+    // samples per bin of the finest level
+    static constexpr int baseSamplesPerBin = 64;
+
+    struct Bin
+    {
+        float min{ 0.0f };
+        float max{ 0.0f };
+        float rms{ 0.0f };
+
+        // RMS of the bands of BandSplitter
+        float low{ 0.0f };
+        float mid{ 0.0f };
+        float high{ 0.0f };
+    };
+
+    WaveformPyramid();
+
+    ~WaveformPyramid();
+
+    // purpose : start a new pyramid
+    // input : sample rate and length of the track, level of the finest bins, above 0 for a
+    //         preview
+    // output : void
+    void reset(double sampleRate, juce::int64 lengthInSamples, int baseLevel = 0);
+
+    // purpose : add the next samples of the track, in order
+    // input : mono samples and their low, mid and high bands
+    // output : void
+    void addSamples(const float* samples, const float* low, const float* mid, const float* high, int numSamples);
+
+    // purpose : add the next finest bins of the track, in order, made by another pyramid
+    // input : bins
+    // output : void
+    void addBins(const std::vector<Bin>& bins);
+
+    // purpose : take the finest bins out of a pyramid being filled, for merging the pyramids
+    //           of the parts of a track
+    // input : none
+    // output : bins, the last one closed even if it isn't full
+    std::vector<Bin> takeBins();
+
+    // purpose : measure samples as one bin, for a preview
+    // input : mono samples and their low, mid and high bands
+    // output : bin
+    static Bin makeBin(const float* samples, const float* low, const float* mid, const float* high, int numSamples);
+
+    // purpose : build the coarser levels once every sample is in
+    // input : none
+    // output : void
+    void finish();
+
+    // purpose : get the sample rate and length of the track
+    // input : none
+    // output : sample rate, length in samples
+    double getSampleRate() const;
+    juce::int64 getLengthInSamples() const;
+
+    // purpose : get the number of levels
+    // input : none
+    // output : levels, 0 before finish
+    int getNumLevels() const;
+
+    // purpose : check if the pyramid is a preview, coarser than the full one
+    // input : none
+    // output : true for a preview
+    bool isPreview() const;
+
+    // purpose : pick the level to draw a zoom from, the coarsest that still has a bin for
+    //           every pixel
+    // input : samples of the track per pixel
+    // output : level
+    int getLevelFor(double samplesPerPixel) const;
+
+    // purpose : get the bins of a level
+    // input : level
+    // output : bins
+    const std::vector<Bin>& getLevel(int level) const;
+
+    // purpose : get the samples covered by one bin of a level
+    // input : level
+    // output : samples per bin
+    juce::int64 getSamplesPerBin(int level) const;
+
+    // purpose : get the extent of a range of samples from a level
+    // input : level, first and one past the last sample
+    // output : minimum, maximum and RMSs of the bins covering the range
+    Bin getRange(int level, double startSample, double endSample) const;
+
+    // purpose : write the pyramid for the analysis store, the coarser levels are rebuilt on
+    //           reading so only the finest one is written, 8 bit per value, 6 bytes per bin
+    // input : none
+    // output : data
+    juce::MemoryBlock save() const;
+
+    // purpose : read a pyramid written by save
+    // input : data
+    // output : false if the data is not a pyramid
+    bool load(const juce::MemoryBlock& data);
+
+private:
+
+    double sampleRate{ 0.0 };
+    juce::int64 lengthInSamples{ 0 };
+    int baseLevel{ 0 };
+
+    std::vector<std::vector<Bin>> levels;
+
+    // the finest level while it is filled
+    std::vector<Bin> base;
+    Bin pending;
+    double pendingSquares{ 0.0 };
+    double pendingLowSquares{ 0.0 };
+    double pendingMidSquares{ 0.0 };
+    double pendingHighSquares{ 0.0 };
+    int pendingCount{ 0 };
+
+    // purpose : close the bin being filled
+    // input : none
+    // output : void
+    void closeBin();
+};